@@ -0,0 +1,324 @@
+#include "batch_shell.hpp"
+#include "exporter.hpp"
+#include "importer.hpp"
+#include "path_view.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Splits a line on spaces, keeping "quoted arguments" whole. False on an unterminated quote.
+bool tokenize(const std::string& line, std::vector<std::string>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+            ++i;
+        if (i >= line.size())
+            break;
+
+        std::string token;
+        if (line[i] == '"') {
+            const size_t end = line.find('"', i + 1);
+            if (end == std::string::npos)
+                return false;
+            token = line.substr(i + 1, end - i - 1);
+            i = end + 1;
+        } else {
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+                token.push_back(line[i++]);
+        }
+        out.push_back(std::move(token));
+    }
+    return true;
+}
+
+bool is_glob(const std::string& pattern) {
+    return !pattern.empty() && (pattern[0] == '/' || pattern.find_first_of("*?[") != std::string::npos);
+}
+
+// Commands that count towards the batch size
+bool changes_filesystem(const std::string& command) {
+    return command == "mkdir" || command == "create" || command == "write" || command == "import";
+}
+
+class BatchShell {
+public:
+    BatchShell(FileSystem& fs, std::ostream& out) : m_fs(fs), m_out(out) {};
+
+    // Runs one tokenized command; on failure error says why
+    bool run(const std::vector<std::string>& args, std::string& error);
+
+private:
+    FileSystem& m_fs;
+    std::ostream& m_out;
+    std::string m_data{};
+
+    bool mkdir(const std::string& path, bool parents, std::string& error);
+    bool write(const std::string& path, const std::string& host_path, std::string& error);
+    bool cat(const std::string& path, std::string& error);
+    bool ls(const std::string& path, std::string& error);
+    bool find(const std::string& pattern, std::string& error);
+    bool stat(const std::string& path, std::string& error);
+    bool import(const std::string& host_root, const std::string& path, std::string& error);
+    bool export_tree(const std::string& path, const std::string& target, std::string& error);
+};
+
+bool BatchShell::run(const std::vector<std::string>& args, std::string& error) {
+    const std::string& command = args[0];
+    const size_t count = args.size();
+
+    if (command == "mkdir" && count == 3 && args[1] == "-p")
+        return mkdir(args[2], true, error);
+    if (command == "mkdir" && count == 2)
+        return mkdir(args[1], false, error);
+    if (command == "create" && count == 2) {
+        if (!m_fs.create_file(args[1]))
+            error = "cannot create " + args[1];
+        return error.empty();
+    }
+    if (command == "write" && count == 3)
+        return write(args[1], args[2], error);
+    if (command == "cat" && count == 2)
+        return cat(args[1], error);
+    if (command == "ls" && count <= 2)
+        return ls(count == 2 ? args[1] : "/", error);
+    if (command == "find" && count == 2)
+        return find(args[1], error);
+    if (command == "stat" && count == 2)
+        return stat(args[1], error);
+    if (command == "import" && (count == 2 || count == 3))
+        return import(args[1], count == 3 ? args[2] : "/", error);
+    if (command == "export" && count == 3)
+        return export_tree(args[1], args[2], error);
+    if (command == "commit" && count == 1) {
+        // Close the running batch and open the next one
+        if (!m_fs.commit_batch())
+            error = "commit failed";
+        m_fs.begin_batch();
+        return error.empty();
+    }
+
+    error = "unknown command or wrong arguments (mkdir [-p], create, write, cat, ls, find, stat, import, export, commit)";
+    return false;
+}
+
+bool BatchShell::mkdir(const std::string& path, bool parents, std::string& error) {
+    if (!parents) {
+        if (!m_fs.create_directory(path))
+            error = "cannot create directory " + path;
+        return error.empty();
+    }
+
+    std::string prefix;
+    PathCursor cursor(path);
+    std::string_view component;
+    while (cursor.next(component)) {
+        prefix += '/';
+        prefix += component;
+
+        const int inode = m_fs.lookup(prefix);
+        if (inode < 0) {
+            if (!m_fs.create_directory(prefix)) {
+                error = "cannot create directory " + prefix;
+                return false;
+            }
+        } else if (!m_fs.is_directory_inode(inode)) {
+            error = prefix + " exists and is not a directory";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchShell::write(const std::string& path, const std::string& host_path, std::string& error) {
+    std::ifstream host(host_path, std::ios::binary);
+    if (!host) {
+        error = "cannot read host file " + host_path;
+        return false;
+    }
+    m_data.assign(std::istreambuf_iterator<char>(host), std::istreambuf_iterator<char>());
+    // write_file would store a cut-off copy and still succeed
+    if (static_cast<int64_t>(m_data.size()) > m_fs.max_file_size()) {
+        error = host_path + " is larger than the " + std::to_string(m_fs.max_file_size()) + " bytes a file can hold";
+        return false;
+    }
+
+    if (m_fs.lookup(path) < 0 && !m_fs.create_file(path)) {
+        error = "cannot create " + path;
+        return false;
+    }
+    const int fd = m_fs.open_file(path);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    // write_file keeps the blocks of a longer old file, they are given back here
+    if (!m_fs.write_file(fd, m_data) || !m_fs.truncate_file(fd, static_cast<int>(m_data.size())))
+        error = "write failed for " + path;
+    m_fs.close_file(fd);
+    return error.empty();
+}
+
+bool BatchShell::cat(const std::string& path, std::string& error) {
+    const int fd = m_fs.open_file(path);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (m_fs.read_file(fd, m_data))
+        m_out << m_data;
+    else
+        error = "read failed for " + path;
+    m_fs.close_file(fd);
+    return error.empty();
+}
+
+bool BatchShell::ls(const std::string& path, std::string& error) {
+    std::vector<DirectoryEntry> entries;
+    if (!m_fs.list_directory_entries(path, entries)) {
+        error = "cannot list " + path;
+        return false;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const DirectoryEntry& a, const DirectoryEntry& b) {
+        return std::string_view(a.name) < std::string_view(b.name);
+    });
+    for (const DirectoryEntry& entry : entries) {
+        if (m_fs.is_directory_inode(entry.inode_index))
+            m_out << entry.name << "/\n";
+        else
+            m_out << entry.name << "\t" << m_fs.inode_table()[entry.inode_index].size << "\n";
+    }
+    return true;
+}
+
+bool BatchShell::find(const std::string& pattern, std::string& error) {
+    std::vector<std::string> paths;
+    if (is_glob(pattern)) {
+        if (!m_fs.search_glob(pattern, paths)) {
+            error = "invalid pattern " + pattern;
+            return false;
+        }
+    } else {
+        paths = m_fs.search(pattern);
+        std::sort(paths.begin(), paths.end());
+    }
+
+    for (const std::string& path : paths)
+        m_out << path << "\n";
+    return true;
+}
+
+bool BatchShell::stat(const std::string& path, std::string& error) {
+    const int inode_index = m_fs.lookup(path);
+    if (inode_index < 0) {
+        error = "no such file or directory " + path;
+        return false;
+    }
+
+    const Inode& inode = m_fs.inode_table()[inode_index];
+    m_out << path << "\tinode " << inode_index;
+    if (inode.type == InodeType::DIRECTORY) {
+        std::vector<DirectoryEntry> entries;
+        m_fs.list_directory_entries(path, entries);
+        m_out << "\tdirectory\t" << entries.size() << " entries\n";
+    } else {
+        m_out << "\tfile\t" << inode.size << " bytes\n";
+    }
+    return true;
+}
+
+bool BatchShell::import(const std::string& host_root, const std::string& path, std::string& error) {
+    ImportResult result;
+    const bool ok = import_tree(m_fs, host_root, path, ImportOptions{}, result);
+    m_out << "imported " << result.files << " files and " << result.directories << " directories, " << result.bytes << " bytes in "
+          << result.seconds << " s";
+    if (result.seconds > 0)
+        m_out << " (" << result.bytes / result.seconds / 1e6 << " MB/s)";
+    m_out << ", " << result.skipped << " skipped\n";
+    if (!ok)
+        error = "import from " + host_root + " failed";
+    return ok;
+}
+
+bool BatchShell::export_tree(const std::string& path, const std::string& target, std::string& error) {
+    ExportResult result;
+    bool ok;
+    if (target == "-") {
+        // The archive is the output; no summary line after it
+        ok = export_tar(m_fs, path, m_out, result);
+        if (!ok)
+            error = "export of " + path + " failed";
+        return ok;
+    }
+
+    const bool tar = target.size() > 4 && target.compare(target.size() - 4, 4, ".tar") == 0;
+    if (tar) {
+        std::ofstream archive(target, std::ios::binary | std::ios::trunc);
+        if (!archive) {
+            error = "cannot write " + target;
+            return false;
+        }
+        ok = export_tar(m_fs, path, archive, result);
+    } else {
+        ok = export_to_directory(m_fs, path, target, result);
+    }
+
+    m_out << "exported " << result.files << " files and " << result.directories << " directories, " << result.bytes << " bytes in "
+          << result.seconds << " s";
+    if (result.seconds > 0)
+        m_out << " (" << result.bytes / result.seconds / 1e6 << " MB/s)";
+    m_out << ", " << result.failed << " failed\n";
+    if (!ok)
+        error = "export of " + path + " failed";
+    return ok;
+}
+
+}
+
+int run_batch(FileSystem& fs, std::istream& in, std::ostream& out, std::ostream& err, const BatchOptions& options) {
+    BatchShell shell(fs, out);
+    std::vector<std::string> args;
+    std::string line;
+    std::string error;
+    int line_number = 0;
+    int failures = 0;
+    int pending = 0;
+
+    fs.begin_batch();
+    while (std::getline(in, line)) {
+        ++line_number;
+        if (!tokenize(line, args)) {
+            err << "line " << line_number << ": unterminated quote\n";
+            ++failures;
+        } else if (!args.empty() && args[0][0] != '#') {
+            error.clear();
+            if (!shell.run(args, error)) {
+                err << "line " << line_number << ": " << args[0] << ": " << error << "\n";
+                ++failures;
+            } else if (changes_filesystem(args[0]) && ++pending >= options.batch_size) {
+                if (!fs.commit_batch()) {
+                    err << "line " << line_number << ": failed to commit metadata\n";
+                    ++failures;
+                }
+                fs.begin_batch();
+                pending = 0;
+            }
+        }
+
+        if (failures > 0 && options.stop_on_error)
+            break;
+    }
+
+    if (!fs.commit_batch()) {
+        err << "failed to commit metadata\n";
+        ++failures;
+    }
+    out.flush();
+    return failures;
+}
@@ -0,0 +1,34 @@
+#ifndef BATCH_SHELL_H
+#define BATCH_SHELL_H
+
+#include "filesystem.hpp"
+
+#include <iostream>
+
+// Non-interactive front end (TermExplorer --batch). One command per line:
+//
+//   mkdir [-p] PATH        create a directory; -p also creates missing parents and accepts existing ones
+//   create PATH            create an empty file
+//   write PATH HOST_FILE   copy a host file in, creating PATH first if needed
+//   cat PATH               print a file
+//   ls [PATH]              list a directory, "/" by default
+//   find PATTERN           glob if PATTERN starts with '/' or has * ? [, otherwise names containing PATTERN
+//   stat PATH              inode, type and size
+//   import HOST_DIR [PATH] copy a host directory tree in, under PATH ("/" by default), see importer.hpp
+//   export PATH TARGET     copy the tree under PATH out: TARGET "-" writes a tar archive to the output,
+//                          a name ending in .tar writes one to that file, anything else is a host directory
+//   commit                 write out the metadata of everything so far
+//
+// Arguments are separated by spaces; wrap one in double quotes to keep its spaces. Blank lines and lines
+// starting with # are skipped.
+struct BatchOptions {
+    // Changes run inside FileSystem batches of this many commands, so the inode table, bitmap and name
+    // records are written once per batch rather than once per command
+    int batch_size{4096};
+    bool stop_on_error{false};
+};
+
+// Runs every command in `in`, printing output to `out` and failures to `err`. Returns how many failed.
+int run_batch(FileSystem& fs, std::istream& in, std::ostream& out, std::ostream& err, const BatchOptions& options);
+
+#endif
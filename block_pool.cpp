@@ -0,0 +1,71 @@
+#include "block_pool.hpp"
+
+#include <cstring>
+#include <new>
+
+BlockPool::Buffer::Buffer(Buffer&& other) noexcept : m_pool(other.m_pool), m_data(other.m_data), m_size(other.m_size) {
+    other.m_pool = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+BlockPool::Buffer& BlockPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        if (m_pool) {
+            m_pool->release(m_data);
+        }
+        m_pool = other.m_pool;
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_pool = nullptr;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+BlockPool::Buffer::~Buffer() {
+    if (m_pool) {
+        m_pool->release(m_data);
+    }
+}
+
+BlockPool::~BlockPool() {
+    // Buffers still out at this point would dangle; the owner (Disk) outlives every user
+    for (char* data : m_free) {
+        ::operator delete(data, std::align_val_t(ALIGNMENT));
+    }
+}
+
+BlockPool::Buffer BlockPool::acquire() {
+    Buffer buffer = acquire_uninitialized();
+    std::memset(buffer.data(), 0, m_block_size);
+    return buffer;
+}
+
+BlockPool::Buffer BlockPool::acquire_uninitialized() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty()) {
+            char* data = m_free.back();
+            m_free.pop_back();
+            return Buffer(this, data, m_block_size);
+        }
+        ++m_allocated;
+        // Reserved up front so release() never has to grow the free list
+        m_free.reserve(m_allocated);
+    }
+
+    char* data = static_cast<char*>(::operator new(m_block_size, std::align_val_t(ALIGNMENT)));
+    return Buffer(this, data, m_block_size);
+}
+
+size_t BlockPool::allocated() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocated;
+}
+
+void BlockPool::release(char* data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(data);
+}
@@ -0,0 +1,65 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Reusable block-sized buffers for disk I/O. A Buffer hands its memory back to the pool when it
+// goes out of scope, so once the pool has grown to the deepest nesting of buffers a call needs,
+// reads, writes and lookups stop allocating. Safe to share between threads.
+class BlockPool {
+public:
+    // Cache line aligned, which also covers any type stored in a block
+    static constexpr size_t ALIGNMENT = 64;
+
+    class Buffer {
+    public:
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        ~Buffer();
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        char* data() const { return m_data; };
+        size_t size() const { return m_size; };
+        char* begin() const { return m_data; };
+        char* end() const { return m_data + m_size; };
+        char& operator[](size_t i) const { return m_data[i]; };
+
+    private:
+        friend class BlockPool;
+        Buffer(BlockPool* pool, char* data, size_t size) : m_pool(pool), m_data(data), m_size(size) {};
+
+        BlockPool* m_pool{};
+        char* m_data{};
+        size_t m_size{};
+    };
+
+    explicit BlockPool(size_t block_size) : m_block_size(block_size) {};
+    ~BlockPool();
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // Every byte zero, like the std::vector<char>(block_size, 0) it stands in for
+    Buffer acquire();
+    // Contents left over from the last user, for a block that is about to be read in whole
+    Buffer acquire_uninitialized();
+
+    size_t block_size() const { return m_block_size; };
+    // Buffers allocated so far; stops growing once the pool is warm
+    size_t allocated() const;
+
+private:
+    const size_t m_block_size;
+
+    mutable std::mutex m_mutex;
+    std::vector<char*> m_free{};
+    size_t m_allocated{};
+
+    void release(char* data);
+};
+
+#endif
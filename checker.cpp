@@ -0,0 +1,630 @@
+#include "checker.hpp"
+#include "cpu_features.hpp"
+#include "disk.hpp"
+#include "filesystem.hpp"
+#include "log.hpp"
+#include "name_index.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(CPU_AVX2_DISPATCH) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t MAX_DETAILS = 100;
+
+// Shared by the walkers; bit b lives in word b / 64 like in the bitmap read as 64-bit words
+class AtomicBitset {
+public:
+    explicit AtomicBitset(size_t bits) : m_words((bits + 63) / 64) {}
+
+    // True if the bit was set already
+    bool test_and_set(size_t bit) {
+        const uint64_t mask = uint64_t{1} << (bit % 64);
+        return (m_words[bit / 64].fetch_or(mask, std::memory_order_relaxed) & mask) != 0;
+    }
+
+    bool test(size_t bit) const {
+        return (m_words[bit / 64].load(std::memory_order_relaxed) >> (bit % 64)) & 1;
+    }
+
+    std::vector<uint64_t> words() const {
+        std::vector<uint64_t> out(m_words.size());
+        for (size_t i = 0; i < m_words.size(); ++i) {
+            out[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+private:
+    std::vector<std::atomic<uint64_t>> m_words;
+};
+
+// A block is consistent when exactly one of its free and reachable bits is set, so a clean word has
+// free ^ reachable == ~0. Returns the first word from `from` on that is not clean, `count` if none.
+#if defined(CPU_AVX2_DISPATCH)
+CPU_TARGET_AVX2 size_t next_mismatch_avx2(const uint64_t* free, const uint64_t* reachable, size_t from, size_t count) {
+    const __m256i ones = _mm256_set1_epi8(static_cast<char>(0xFF));
+    size_t w = from;
+    for (; w + 4 <= count; w += 4) {
+        const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(free + w)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reachable + w)));
+        if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, ones))) != 0xFFFFFFFFu) {
+            break;
+        }
+    }
+    for (; w < count; ++w) {
+        if ((free[w] ^ reachable[w]) != ~uint64_t{0}) {
+            return w;
+        }
+    }
+    return count;
+}
+#endif
+
+#if defined(__SSE2__)
+size_t next_mismatch_sse2(const uint64_t* free, const uint64_t* reachable, size_t from, size_t count) {
+    const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+    size_t w = from;
+    for (; w + 2 <= count; w += 2) {
+        const __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(free + w)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(reachable + w)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, ones)) != 0xFFFF) {
+            break;
+        }
+    }
+    for (; w < count; ++w) {
+        if ((free[w] ^ reachable[w]) != ~uint64_t{0}) {
+            return w;
+        }
+    }
+    return count;
+}
+#endif
+
+size_t next_mismatch(const uint64_t* free, const uint64_t* reachable, size_t from, size_t count) {
+#if defined(CPU_AVX2_DISPATCH)
+    if (cpu_has_avx2()) {
+        return next_mismatch_avx2(free, reachable, from, count);
+    }
+#endif
+#if defined(__SSE2__)
+    return next_mismatch_sse2(free, reachable, from, count);
+#else
+    for (size_t w = from; w < count; ++w) {
+        if ((free[w] ^ reachable[w]) != ~uint64_t{0}) {
+            return w;
+        }
+    }
+    return count;
+#endif
+}
+
+struct DirectoryFix {
+    int block{};
+    int slot{};
+};
+
+// Index entries from `keep` on are dropped and the size clamped to `size`
+struct IndexFix {
+    int inode{};
+    int keep{};
+    int size{};
+};
+
+// What one walker found; merged into the report once all are done
+struct WalkState {
+    int directories{};
+    int files{};
+    int64_t slack_blocks{};
+    int64_t bad_block_references{};
+    int64_t shared_blocks{};
+    int bad_inodes{};
+    int dangling_entries{};
+    int multiply_linked{};
+    std::vector<DirectoryFix> directory_fixes{};
+    std::vector<IndexFix> index_fixes{};
+    std::vector<char> directory_block{};
+    std::vector<char> index_block{};
+};
+
+class Checker {
+public:
+    Checker(const std::string& image_path, const CheckOptions& options, CheckReport& report)
+        : m_image_path(image_path), m_options(options), m_report(report) {}
+
+    bool load();
+    bool walk();
+    void check_inodes();
+    void compare_bitmap();
+    bool repair();
+
+private:
+    const std::string& m_image_path;
+    const CheckOptions& m_options;
+    CheckReport& m_report;
+
+    Superblock m_superblock{};
+    int m_inode_count{};
+    int m_block_size{};
+    int m_records_per_block{};
+    std::unique_ptr<Disk> m_disk{};
+    std::vector<Inode> m_inodes{};
+    std::vector<uint8_t> m_bitmap{};
+    std::vector<char> m_name_blocks{};  // as on disk, records do not straddle blocks
+
+    std::unique_ptr<AtomicBitset> m_reachable{};
+    std::unique_ptr<AtomicBitset> m_linked{};
+    std::vector<NameRecord> m_expected_names{};  // from the directory entry that linked each inode
+    std::vector<int> m_orphans{};
+    std::vector<DirectoryFix> m_directory_fixes{};
+    std::vector<IndexFix> m_index_fixes{};
+    std::mutex m_details_mutex{};
+
+    void detail(const std::string& line);
+    bool in_data_region(int block) const { return block >= m_superblock.data_region_start && block < m_superblock.total_blocks; };
+    NameRecord* name_record(int inode);
+    void walk_directory(Disk& disk, int directory, WalkState& state, std::vector<int>& subdirectories);
+    void walk_file(Disk& disk, int inode, WalkState& state);
+};
+
+void Checker::detail(const std::string& line) {
+    std::lock_guard<std::mutex> lock(m_details_mutex);
+    if (m_report.details.size() < MAX_DETAILS) {
+        m_report.details.push_back(line);
+    }
+}
+
+NameRecord* Checker::name_record(int inode) {
+    if (m_superblock.name_index_blocks <= 0) {
+        return nullptr;
+    }
+    const size_t offset = static_cast<size_t>(inode / m_records_per_block) * m_block_size + static_cast<size_t>(inode % m_records_per_block) * sizeof(NameRecord);
+    return reinterpret_cast<NameRecord*>(m_name_blocks.data() + offset);
+}
+
+bool Checker::load() {
+    if (!read_image_superblock(m_image_path, m_superblock)) {
+        LOG_ERROR("check: no filesystem in " << m_image_path);
+        return false;
+    }
+    const Superblock& sb = m_superblock;
+    m_block_size = sb.block_size;
+    m_records_per_block = m_block_size / static_cast<int>(sizeof(NameRecord));
+
+    // Nothing else can be trusted if the regions overlap or run off the disk
+    const int inode_table_end = sb.inode_table_start + sb.inode_table_blocks;
+    const int bitmap_end = sb.free_bitmap_start + sb.free_bitmap_blocks;
+    const int name_index_end = sb.name_index_blocks > 0 ? sb.name_index_start + sb.name_index_blocks : bitmap_end;
+    if (sb.inode_table_start < 1 || sb.inode_table_blocks < 1 || sb.free_bitmap_start < inode_table_end ||
+        static_cast<int64_t>(sb.free_bitmap_blocks) * m_block_size * 8 < sb.total_blocks ||
+        (sb.name_index_blocks > 0 && sb.name_index_start < bitmap_end) || sb.data_region_start < name_index_end ||
+        sb.data_region_start >= sb.total_blocks || m_block_size < static_cast<int>(sizeof(DirectoryEntry))) {
+        LOG_ERROR("check: superblock of " << m_image_path << " describes an impossible layout");
+        return false;
+    }
+
+    const std::uintmax_t image_bytes = static_cast<std::uintmax_t>(sb.total_blocks) * static_cast<std::uintmax_t>(m_block_size);
+    std::error_code error;
+    if (std::filesystem::file_size(m_image_path, error) < image_bytes || error) {
+        LOG_ERROR("check: " << m_image_path << " is shorter than its " << sb.total_blocks << " blocks");
+        return false;
+    }
+
+    const int table_capacity = static_cast<int>(static_cast<int64_t>(sb.inode_table_blocks) * m_block_size / static_cast<int>(sizeof(Inode)));
+    m_inode_count = sb.max_inodes > 0 ? sb.max_inodes : m_options.inodes > 0 ? m_options.inodes : table_capacity;
+    if (m_inode_count > table_capacity || (sb.name_index_blocks > 0 && m_inode_count > sb.name_index_blocks * m_records_per_block) ||
+        sb.root_inode_index < 0 || sb.root_inode_index >= m_inode_count) {
+        LOG_ERROR("check: " << m_inode_count << " inodes do not fit the inode table or name index");
+        return false;
+    }
+
+    m_disk = std::make_unique<Disk>(sb.total_blocks, m_block_size);
+    if (!m_disk->open(m_image_path)) {
+        return false;
+    }
+
+    std::vector<char> table(static_cast<size_t>(sb.inode_table_blocks) * m_block_size);
+    m_bitmap.assign(static_cast<size_t>(sb.free_bitmap_blocks) * m_block_size, 0);
+    m_name_blocks.assign(static_cast<size_t>(std::max(0, sb.name_index_blocks)) * m_block_size, 0);
+    if (!m_disk->read_blocks(sb.inode_table_start, sb.inode_table_blocks, table.data()) ||
+        !m_disk->read_blocks(sb.free_bitmap_start, sb.free_bitmap_blocks, m_bitmap.data()) ||
+        (sb.name_index_blocks > 0 && !m_disk->read_blocks(sb.name_index_start, sb.name_index_blocks, m_name_blocks.data()))) {
+        LOG_ERROR("check: cannot read the metadata of " << m_image_path);
+        return false;
+    }
+    m_inodes.resize(m_inode_count);
+    std::memcpy(m_inodes.data(), table.data(), m_inodes.size() * sizeof(Inode));
+    return true;
+}
+
+bool Checker::walk() {
+    const Superblock& sb = m_superblock;
+    m_reachable = std::make_unique<AtomicBitset>(sb.total_blocks);
+    m_linked = std::make_unique<AtomicBitset>(m_inode_count);
+    NameRecord unnamed{};
+    std::memset(unnamed.name, 0, sizeof(unnamed.name));
+    m_expected_names.assign(m_inode_count, unnamed);
+
+    for (int b = 0; b < sb.data_region_start; ++b) {
+        m_reachable->test_and_set(b);
+    }
+
+    const int root = sb.root_inode_index;
+    if (m_inodes[root].type != InodeType::DIRECTORY || !in_data_region(m_inodes[root].index_block)) {
+        LOG_ERROR("check: the root inode " << root << " is not a directory");
+        return false;
+    }
+    m_linked->test_and_set(root);
+    m_reachable->test_and_set(m_inodes[root].index_block);
+
+    std::deque<int> pending{root};
+    int active = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<WalkState> states(std::max(1, m_options.threads));
+    std::atomic<bool> failed{false};
+
+    auto walker = [&](WalkState& state) {
+        // Disk serializes seek + read on its stream, so every walker reads through a Disk of its own
+        Disk disk(sb.total_blocks, m_block_size);
+        if (!disk.open(m_image_path)) {
+            failed = true;
+        }
+        state.directory_block.resize(m_block_size);
+        state.index_block.resize(m_block_size);
+        std::vector<int> subdirectories;
+
+        while (true) {
+            int directory;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return !pending.empty() || active == 0; });
+                if (pending.empty()) {
+                    return;
+                }
+                directory = pending.front();
+                pending.pop_front();
+                ++active;
+            }
+
+            subdirectories.clear();
+            if (disk.is_open()) {
+                walk_directory(disk, directory, state, subdirectories);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.insert(pending.end(), subdirectories.begin(), subdirectories.end());
+                --active;
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (WalkState& state : states) {
+        threads.emplace_back(walker, std::ref(state));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        LOG_ERROR("check: cannot open " << m_image_path << " for the walkers");
+        return false;
+    }
+
+    // The root is counted like any other directory
+    for (const WalkState& state : states) {
+        m_report.directories += state.directories;
+        m_report.files += state.files;
+        m_report.slack_blocks += state.slack_blocks;
+        m_report.bad_block_references += state.bad_block_references;
+        m_report.shared_blocks += state.shared_blocks;
+        m_report.bad_inodes += state.bad_inodes;
+        m_report.dangling_entries += state.dangling_entries;
+        m_report.multiply_linked += state.multiply_linked;
+        m_directory_fixes.insert(m_directory_fixes.end(), state.directory_fixes.begin(), state.directory_fixes.end());
+        m_index_fixes.insert(m_index_fixes.end(), state.index_fixes.begin(), state.index_fixes.end());
+    }
+    m_report.unrepaired = static_cast<int>(m_report.shared_blocks) + m_report.multiply_linked;
+    return true;
+}
+
+void Checker::walk_directory(Disk& disk, int directory, WalkState& state, std::vector<int>& subdirectories) {
+    ++state.directories;
+    const int block = m_inodes[directory].index_block;
+    if (!disk.read_block(block, state.directory_block.data())) {
+        detail("directory inode " + std::to_string(directory) + ": cannot read block " + std::to_string(block));
+        return;
+    }
+
+    const DirectoryEntry* entries = reinterpret_cast<const DirectoryEntry*>(state.directory_block.data());
+    const int max_entries = m_block_size / static_cast<int>(sizeof(DirectoryEntry));
+    for (int slot = 0; slot < max_entries; ++slot) {
+        const DirectoryEntry& entry = entries[slot];
+        if (entry.inode_index == -1) {
+            continue;
+        }
+        const std::string name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        const std::string where = "directory inode " + std::to_string(directory) + " entry \"" + name + "\"";
+        const int inode = entry.inode_index;
+
+        // An entry the filesystem would skip or could not follow: drop it, the inode becomes an orphan
+        const bool in_range = inode >= 0 && inode < m_inode_count;
+        const InodeType type = in_range ? m_inodes[inode].type : InodeType::UNUSED;
+        if (name.empty() || !in_range || (type != InodeType::FILE && type != InodeType::DIRECTORY)) {
+            ++state.dangling_entries;
+            if (in_range && type != InodeType::UNUSED) {
+                ++state.bad_inodes;
+            }
+            state.directory_fixes.push_back({block, slot});
+            detail(where + ": names " + (name.empty() ? "inode " + std::to_string(inode) + " without a name" : in_range ? "a free or broken inode" : "an inode out of range"));
+            continue;
+        }
+        if (!in_data_region(m_inodes[inode].index_block)) {
+            ++state.dangling_entries;
+            ++state.bad_inodes;
+            ++state.bad_block_references;
+            state.directory_fixes.push_back({block, slot});
+            detail(where + ": inode " + std::to_string(inode) + " has its block outside the data region");
+            continue;
+        }
+        if (m_linked->test_and_set(inode)) {
+            ++state.multiply_linked;
+            detail(where + ": inode " + std::to_string(inode) + " is already linked elsewhere");
+            continue;
+        }
+        // Only the walker that linked the inode writes its slot
+        m_expected_names[inode].parent_inode = directory;
+        std::memcpy(m_expected_names[inode].name, entry.name, sizeof(entry.name));
+
+        const bool shared = m_reachable->test_and_set(m_inodes[inode].index_block);
+        if (shared) {
+            ++state.shared_blocks;
+            detail(where + ": block " + std::to_string(m_inodes[inode].index_block) + " is also used by something else");
+        }
+        if (type == InodeType::DIRECTORY) {
+            // Its entries would be claimed twice
+            if (!shared) {
+                subdirectories.push_back(inode);
+            }
+        } else {
+            walk_file(disk, inode, state);
+        }
+    }
+}
+
+void Checker::walk_file(Disk& disk, int inode, WalkState& state) {
+    ++state.files;
+    const Inode& file = m_inodes[inode];
+    const std::string where = "file inode " + std::to_string(inode);
+    if (!disk.read_block(file.index_block, state.index_block.data())) {
+        detail(where + ": cannot read index block " + std::to_string(file.index_block));
+        return;
+    }
+
+    const int* entries = reinterpret_cast<const int*>(state.index_block.data());
+    const int max_entries = m_block_size / static_cast<int>(sizeof(int));
+    const int64_t max_size = static_cast<int64_t>(max_entries) * m_block_size;
+    const int needed = file.size < 0 || file.size > max_size ? max_entries : static_cast<int>((static_cast<int64_t>(file.size) + m_block_size - 1) / m_block_size);
+
+    // keep: entries from here on go; held: entries present before the first -1
+    int keep = max_entries;
+    int held = 0;
+    int64_t slack = 0;
+    for (int i = 0; i < max_entries && entries[i] != -1; ++i, ++held) {
+        const int block = entries[i];
+        if (!in_data_region(block)) {
+            state.bad_block_references += 1;
+            detail(where + ": entry " + std::to_string(i) + " points at block " + std::to_string(block));
+            keep = std::min(keep, i);
+            break;
+        }
+        if (i >= needed) {
+            ++slack;
+            keep = std::min(keep, needed);
+            // Repair gives them back, so they only count as reachable when left in place
+            if (m_options.repair) {
+                continue;
+            }
+        }
+        if (m_reachable->test_and_set(block)) {
+            ++state.shared_blocks;
+            detail(where + ": block " + std::to_string(block) + " is also used by something else");
+        }
+    }
+
+    if (slack > 0) {
+        state.slack_blocks += slack;
+        detail(where + ": holds " + std::to_string(slack) + " blocks past its size of " + std::to_string(file.size));
+    }
+
+    int size = file.size;
+    if (size < 0 || size > max_size || static_cast<int64_t>(size) > static_cast<int64_t>(std::min(held, keep)) * m_block_size) {
+        ++state.bad_inodes;
+        size = static_cast<int>(std::clamp<int64_t>(size, 0, static_cast<int64_t>(std::min(held, keep)) * m_block_size));
+        detail(where + ": size " + std::to_string(file.size) + " is not covered by its " + std::to_string(std::min(held, keep)) + " blocks");
+    }
+    if (keep < held || size != file.size) {
+        state.index_fixes.push_back({inode, keep, size});
+    }
+}
+
+void Checker::check_inodes() {
+    const int root = m_superblock.root_inode_index;
+    for (int i = 0; i < m_inode_count; ++i) {
+        const Inode& inode = m_inodes[i];
+        if (!m_linked->test(i)) {
+            if (inode.type != InodeType::UNUSED) {
+                ++m_report.orphan_inodes;
+                m_orphans.push_back(i);
+                detail("inode " + std::to_string(i) + " is in use but in no directory");
+            }
+            continue;
+        }
+        if (i == root) {
+            continue;
+        }
+
+        // The name index is what searches and paths are built from
+        NameRecord* record = name_record(i);
+        const NameRecord& expected = m_expected_names[i];
+        if (record && (record->parent_inode != expected.parent_inode || strncmp(record->name, expected.name, sizeof(expected.name)) != 0)) {
+            ++m_report.stale_name_records;
+            detail("inode " + std::to_string(i) + ": name index says \"" + std::string(record->name, strnlen(record->name, sizeof(record->name))) +
+                   "\" in inode " + std::to_string(record->parent_inode));
+        }
+    }
+}
+
+void Checker::compare_bitmap() {
+    const size_t total = static_cast<size_t>(m_superblock.total_blocks);
+    const std::vector<uint64_t> reachable = m_reachable->words();
+    std::vector<uint64_t> free(reachable.size(), 0);
+    std::memcpy(free.data(), m_bitmap.data(), std::min(m_bitmap.size(), free.size() * sizeof(uint64_t)));
+
+    auto account = [&](size_t w, uint64_t mask) {
+        const uint64_t used = ~free[w] & mask;
+        const uint64_t reach = reachable[w] & mask;
+        const uint64_t leaked = used & ~reach;
+        const uint64_t unmarked = reach & ~used;
+        m_report.leaked_blocks += __builtin_popcountll(leaked);
+        m_report.unmarked_blocks += __builtin_popcountll(unmarked);
+        for (uint64_t bits = unmarked; bits != 0 && m_report.details.size() < MAX_DETAILS; bits &= bits - 1) {
+            detail("block " + std::to_string(w * 64 + static_cast<size_t>(__builtin_ctzll(bits))) + " is in use but marked free");
+        }
+        for (uint64_t bits = leaked; bits != 0 && m_report.details.size() < MAX_DETAILS; bits &= bits - 1) {
+            detail("block " + std::to_string(w * 64 + static_cast<size_t>(__builtin_ctzll(bits))) + " is marked used but unreachable");
+        }
+    };
+
+    // Whole words first, clean runs skipped a vector at a time; then the bits of the last partial word
+    const size_t full_words = total / 64;
+    for (size_t w = next_mismatch(free.data(), reachable.data(), 0, full_words); w < full_words;
+         w = next_mismatch(free.data(), reachable.data(), w + 1, full_words)) {
+        account(w, ~uint64_t{0});
+    }
+    const uint64_t tail_mask = total % 64 ? (uint64_t{1} << (total % 64)) - 1 : 0;
+    if (tail_mask) {
+        account(full_words, tail_mask);
+    }
+
+    for (size_t w = 0; w < full_words; ++w) {
+        m_report.used_blocks += __builtin_popcountll(~free[w]);
+        m_report.reachable_blocks += __builtin_popcountll(reachable[w]);
+    }
+    if (tail_mask) {
+        m_report.used_blocks += __builtin_popcountll(~free[full_words] & tail_mask);
+        m_report.reachable_blocks += __builtin_popcountll(reachable[full_words] & tail_mask);
+    }
+}
+
+bool Checker::repair() {
+    const Superblock& sb = m_superblock;
+    std::vector<char> buffer(m_block_size);
+
+    for (const DirectoryFix& fix : m_directory_fixes) {
+        if (!m_disk->read_block(fix.block, buffer.data())) {
+            return false;
+        }
+        DirectoryEntry& entry = reinterpret_cast<DirectoryEntry*>(buffer.data())[fix.slot];
+        entry.inode_index = -1;
+        std::memset(entry.name, 0, sizeof(entry.name));
+        if (!m_disk->write_block(fix.block, buffer.data())) {
+            return false;
+        }
+    }
+
+    const int max_entries = m_block_size / static_cast<int>(sizeof(int));
+    for (const IndexFix& fix : m_index_fixes) {
+        Inode& inode = m_inodes[fix.inode];
+        if (fix.keep < max_entries) {
+            if (!m_disk->read_block(inode.index_block, buffer.data())) {
+                return false;
+            }
+            int* entries = reinterpret_cast<int*>(buffer.data());
+            std::fill(entries + fix.keep, entries + max_entries, -1);
+            if (!m_disk->write_block(inode.index_block, buffer.data())) {
+                return false;
+            }
+        }
+        inode.size = fix.size;
+    }
+
+    NameRecord unnamed{};
+    std::memset(unnamed.name, 0, sizeof(unnamed.name));
+    for (int orphan : m_orphans) {
+        m_inodes[orphan] = Inode{};
+        if (NameRecord* record = name_record(orphan)) {
+            *record = unnamed;
+        }
+    }
+    for (int i = 0; i < m_inode_count; ++i) {
+        NameRecord* record = name_record(i);
+        if (record && i != sb.root_inode_index && m_linked->test(i)) {
+            *record = m_expected_names[i];
+        }
+    }
+
+    // Exactly the reachable blocks are used; bits past the last block are left as they were
+    const size_t total = static_cast<size_t>(sb.total_blocks);
+    const std::vector<uint64_t> reachable = m_reachable->words();
+    std::vector<uint64_t> free(reachable.size(), 0);
+    const size_t bitmap_bytes = std::min(m_bitmap.size(), free.size() * sizeof(uint64_t));
+    std::memcpy(free.data(), m_bitmap.data(), bitmap_bytes);
+    for (size_t w = 0; w < free.size(); ++w) {
+        const uint64_t mask = (w + 1) * 64 <= total ? ~uint64_t{0} : (uint64_t{1} << (total % 64)) - 1;
+        free[w] = (free[w] & ~mask) | (~reachable[w] & mask);
+    }
+    std::memcpy(m_bitmap.data(), free.data(), bitmap_bytes);
+
+    std::vector<char> table(static_cast<size_t>(sb.inode_table_blocks) * m_block_size, 0);
+    std::memcpy(table.data(), m_inodes.data(), m_inodes.size() * sizeof(Inode));
+    if (!m_disk->write_blocks(sb.inode_table_start, sb.inode_table_blocks, table.data()) ||
+        !m_disk->write_blocks(sb.free_bitmap_start, sb.free_bitmap_blocks, m_bitmap.data()) ||
+        (sb.name_index_blocks > 0 && !m_disk->write_blocks(sb.name_index_start, sb.name_index_blocks, m_name_blocks.data()))) {
+        return false;
+    }
+    m_report.repaired = true;
+    return true;
+}
+
+}
+
+bool CheckReport::clean() const {
+    return leaked_blocks == 0 && unmarked_blocks == 0 && slack_blocks == 0 && bad_block_references == 0 && shared_blocks == 0 &&
+           orphan_inodes == 0 && bad_inodes == 0 && dangling_entries == 0 && multiply_linked == 0 && stale_name_records == 0;
+}
+
+bool check_image(const std::string& image_path, const CheckOptions& options, CheckReport& report) {
+    report = {};
+    const auto start = std::chrono::steady_clock::now();
+
+    Checker checker(image_path, options, report);
+    if (!checker.load() || !checker.walk()) {
+        return false;
+    }
+    checker.check_inodes();
+    checker.compare_bitmap();
+
+    if (options.repair && !report.clean() && !checker.repair()) {
+        LOG_ERROR("check: writing the repairs to " << image_path << " failed");
+        return false;
+    }
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CheckOptions {
+    // Directories are walked by this many threads, each reading through its own Disk
+    int threads{4};
+    bool repair{false};
+    // For images formatted before the superblock recorded it; 0 takes as many as the inode table holds
+    int inodes{0};
+};
+
+struct CheckReport {
+    int directories{};
+    int files{};
+    int64_t used_blocks{};          // marked used in the bitmap
+    int64_t reachable_blocks{};     // metadata plus every block the tree refers to
+
+    int64_t leaked_blocks{};        // marked used, but nothing refers to them
+    int64_t unmarked_blocks{};      // referred to, but marked free, so they would be handed out again
+    int64_t slack_blocks{};         // held by an index block past the end of its file, e.g. after write_file shrank it
+    int64_t bad_block_references{}; // outside the data region
+    int64_t shared_blocks{};        // referred to more than once
+    int orphan_inodes{};            // in use, but in no directory
+    int bad_inodes{};               // unknown type, or a size the index block does not cover
+    int dangling_entries{};         // directory entries naming a free, out of range or broken inode, or without a name
+    int multiply_linked{};          // inodes named by more than one directory entry
+    int stale_name_records{};       // name index records that disagree with the directory entry
+
+    bool repaired{};
+    int unrepaired{};               // shared blocks and extra links are only reported, there is no telling which owner is right
+    std::vector<std::string> details{}; // the first problems found, one line each
+    double seconds{};
+
+    bool clean() const;
+};
+
+// Checks an unmounted image. The superblock, inode table, bitmap and name index are read once; the
+// directory tree is then walked from the root by options.threads workers, which collect every block
+// it refers to in a shared bitset. That set is compared with the bitmap a word at a time.
+//
+// With options.repair, dangling entries are cleared, orphan and broken inodes freed, slack blocks and
+// bad references cut from their index blocks, name records rewritten from the tree, and the bitmap
+// rewritten to mark exactly the reachable blocks. Returns false if the image could not be checked at all.
+bool check_image(const std::string& image_path, const CheckOptions& options, CheckReport& report);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// On x86 with GCC or Clang, AVX2 kernels are compiled next to the baseline ones with CPU_TARGET_AVX2
+// and picked with cpu_has_avx2(), so a default build (no -mavx2) still uses them where the CPU has it.
+// Builds with -mavx2 skip the check.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_AVX2_DISPATCH 1
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+
+inline bool cpu_has_avx2() {
+#if defined(__AVX2__)
+    return true;
+#else
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#endif
+}
+#endif
+
+#endif
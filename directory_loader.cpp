@@ -0,0 +1,99 @@
+#include "directory_loader.hpp"
+
+#include <algorithm>
+
+bool load_directory_listing(FileSystem& fs, const std::string& path, DirectoryListing& out) {
+    out.path = path;
+    out.entries.clear();
+
+    std::vector<DirectoryEntry> entries;
+    out.ok = fs.list_directory_entries(path, entries);
+    if (!out.ok) {
+        return false;
+    }
+
+    out.entries.reserve(entries.size());
+    for (const auto& e : entries) {
+        out.entries.push_back({std::string(e.name, strnlen(e.name, sizeof(e.name))), e.inode_index, fs.is_directory_inode(e.inode_index)});
+    }
+    return true;
+}
+
+DirectoryLoader::DirectoryLoader(FileSystem& fs, std::mutex& fs_mutex, Callback on_loaded)
+    : m_fs(fs), m_fs_mutex(fs_mutex), m_on_loaded(std::move(on_loaded)) {
+    m_thread = std::thread([this]() { run(); });
+}
+
+DirectoryLoader::~DirectoryLoader() {
+    stop();
+}
+
+void DirectoryLoader::request(const std::string& path, uint64_t ticket) {
+    enqueue(path, ticket, true);
+}
+
+void DirectoryLoader::prefetch(const std::string& path, uint64_t ticket) {
+    enqueue(path, ticket, false);
+}
+
+void DirectoryLoader::enqueue(const std::string& path, uint64_t ticket, bool urgent) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+
+        // A directory is queued at most once; a newer ticket or an expansion just updates the existing job
+        auto it = std::find_if(m_queue.begin(), m_queue.end(), [&](const Job& job) { return job.path == path; });
+        if (it != m_queue.end()) {
+            if (!urgent) {
+                it->ticket = ticket;
+                return;
+            }
+            m_queue.erase(it);
+        }
+
+        if (urgent) {
+            m_queue.push_front({path, ticket});
+        } else {
+            m_queue.push_back({path, ticket});
+        }
+    }
+    m_wake.notify_one();
+}
+
+void DirectoryLoader::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_queue.clear();
+    }
+    m_wake.notify_one();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void DirectoryLoader::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        DirectoryListing listing;
+        listing.ticket = job.ticket;
+        {
+            std::lock_guard<std::mutex> fs_lock(m_fs_mutex);
+            load_directory_listing(m_fs, job.path, listing);
+        }
+        m_on_loaded(std::move(listing));
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef DIRECTORY_LOADER_H
+#define DIRECTORY_LOADER_H
+
+#include "filesystem.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LoadedEntry {
+    std::string name;
+    int inode_index{-1};
+    bool is_directory{};
+};
+
+struct DirectoryListing {
+    std::string path;
+    uint64_t ticket{}; // echoed back from the request so stale listings can be told apart
+    bool ok{false};
+    std::vector<LoadedEntry> entries;
+};
+
+// Lists one directory. The caller must hold whatever lock guards fs.
+bool load_directory_listing(FileSystem& fs, const std::string& path, DirectoryListing& out);
+
+// Lists directories on a background thread. Expansion requests jump the queue,
+// prefetches wait behind them. on_loaded is called on the loader thread.
+class DirectoryLoader {
+public:
+    using Callback = std::function<void(DirectoryListing)>;
+
+    DirectoryLoader(FileSystem& fs, std::mutex& fs_mutex, Callback on_loaded);
+    ~DirectoryLoader();
+
+    DirectoryLoader(const DirectoryLoader&) = delete;
+    DirectoryLoader& operator=(const DirectoryLoader&) = delete;
+
+    void request(const std::string& path, uint64_t ticket);
+    void prefetch(const std::string& path, uint64_t ticket);
+
+    void stop();
+
+private:
+    struct Job {
+        std::string path;
+        uint64_t ticket{};
+    };
+
+    FileSystem& m_fs;
+    std::mutex& m_fs_mutex;
+    Callback m_on_loaded;
+
+    std::mutex m_mutex{};
+    std::condition_variable m_wake{};
+    std::deque<Job> m_queue{};
+    bool m_stopping{false};
+    std::thread m_thread{};
+
+    void enqueue(const std::string& path, uint64_t ticket, bool urgent);
+    void run();
+};
+
+#endif
@@ -1,9 +1,9 @@
 #include "disk.hpp"
+#include "log.hpp"
 
 #include <filesystem>
-#include <iostream>
 
-Disk::Disk(int number_of_blocks, int block_size) : m_number_of_blocks{number_of_blocks}, m_block_size{block_size} {};
+Disk::Disk(int number_of_blocks, int block_size) : m_number_of_blocks{number_of_blocks}, m_block_size{block_size}, m_block_pool(block_size) {};
 
 bool Disk::open(const std::string& path)
 {
@@ -18,13 +18,13 @@ bool Disk::open(const std::string& path)
     m_file.open(path, mode);
     if (!m_file.is_open())
     {
-        std::cerr << "Failed to open disk at path " << path << "\n";
+        LOG_ERROR("Failed to open disk at path " << path);
         return false;
     }
 
     if (!ensure_size())
     {
-        std::cerr << "Could not allocate size for disk\n";
+        LOG_ERROR("Could not allocate size for disk");
         m_file.close();
         return false;
     }
@@ -34,79 +34,102 @@ bool Disk::open(const std::string& path)
 
 bool Disk::ensure_size()
 {
-    const std::uintmax_t desired_size = static_cast<std::uintmax_t>(m_number_of_blocks * m_block_size);
+    const std::uintmax_t desired_size = static_cast<std::uintmax_t>(m_number_of_blocks) * static_cast<std::uintmax_t>(m_block_size);
 
     std::uintmax_t current_size {};
 
     if (std::filesystem::exists(m_path)) {
         current_size = std::filesystem::file_size(m_path);
-        std::cout << "Current disk size: " << current_size << "\n";
+        LOG_DEBUG("Current disk size: " << current_size);
     }
 
-    if (current_size == desired_size) {
+    if (current_size >= desired_size) {
         return true;
     }
 
-    // if (current_size > desired_size) {
-    //     std::cerr << "Disk size is larger than desired size\n";
-    //     return false;
-    // }
-
-    m_file.seekp(0, std::ios::end);
-    std::vector<char> zeros(m_block_size, 0);
-
-    while (current_size < desired_size) {
-        std::uintmax_t remaining = desired_size - current_size;
-        std::streamsize chunk = static_cast<std::streamsize>(std::min<std::uintmax_t>(remaining, zeros.size()));
-        m_file.write(zeros.data(), chunk);
-        if (!m_file) {
-            std::cerr << "Failed to extend disk size\n";
-            return false;
-        }
-        current_size += static_cast<std::uintmax_t>(chunk);
+    // Growing the file leaves a hole that reads back as zeros, so even a multi-GB image takes no time
+    // and no space until its blocks are written
+    std::error_code error;
+    std::filesystem::resize_file(m_path, desired_size, error);
+    if (error) {
+        LOG_ERROR("Failed to extend disk size: " << error.message());
+        return false;
     }
-
-    m_file.flush();
-    std::cout << "Disk size after intitialization: " << std::filesystem::file_size(m_path) << "\n";
+    LOG_INFO("Disk size after initialization: " << std::filesystem::file_size(m_path));
 
     return true;
 }
 
 bool Disk::read_block(int block_number, void* buffer) {
+    OpTimer timer(m_stats, Op::DISK_READ);
+    std::lock_guard<std::mutex> lock(m_mutex);
     if (!m_file.is_open())
     {
-        std::cerr << "Disk is not open\n";
+        LOG_ERROR("Disk is not open");
         return false;
     }
     if (block_number >= m_number_of_blocks) {
-        std::cerr << "Block number out of range for reading\n";
+        LOG_ERROR("Block number out of range for reading");
         return false;
     }
     std::streamoff offset = static_cast<std::streamoff>(block_number) * static_cast<std::streamoff>(m_block_size);
     m_file.seekg(offset, std::ios::beg);
     if (!m_file) {
-        std::cerr << "Moving read pointer failed\n";
+        LOG_ERROR("Moving read pointer failed");
         return false;
     }
 
     m_file.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(m_block_size));
 
     if (!m_file) {
-        std::cerr << "Read failed\n";
+        LOG_ERROR("Read failed");
+        return false;
+    }
+    m_blocks_read.fetch_add(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+bool Disk::read_blocks(int first_block, int block_count, void* buffer) {
+    OpTimer timer(m_stats, Op::DISK_READ);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) {
+        LOG_ERROR("Disk is not open");
+        return false;
+    }
+
+    if (first_block < 0 || block_count < 0 || first_block + block_count > m_number_of_blocks) {
+        LOG_ERROR("Block range out of range for reading");
+        return false;
+    }
+
+    std::streamoff offset = static_cast<std::streamoff>(first_block) * static_cast<std::streamoff>(m_block_size);
+    m_file.seekg(offset, std::ios::beg);
+    if (!m_file) {
+        LOG_ERROR("Moving read pointer failed");
+        return false;
+    }
+
+    m_file.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(block_count) * m_block_size);
+    if (!m_file) {
+        LOG_ERROR("Read failed");
         return false;
     }
+    m_blocks_read.fetch_add(block_count, std::memory_order_relaxed);
 
     return true;
 }
 
 bool Disk::write_block(int block_number, const void* buffer) {
+    OpTimer timer(m_stats, Op::DISK_WRITE);
+    std::lock_guard<std::mutex> lock(m_mutex);
     if (!m_file.is_open()) {
-        std::cerr << "Disk is not open\n";
+        LOG_ERROR("Disk is not open");
         return false;
     }
 
     if (block_number >= m_number_of_blocks) {
-        std::cerr << "Block number out of range for writing\n";
+        LOG_ERROR("Block number out of range for writing");
         return false;
     }
     
@@ -114,16 +137,47 @@ bool Disk::write_block(int block_number, const void* buffer) {
 
     m_file.seekp(offset, std::ios::beg);
     if (!m_file) {
-        std::cerr << "Moving disk write pointer failed\n";
+        LOG_ERROR("Moving disk write pointer failed");
         return false;
     }
 
     m_file.write(reinterpret_cast<const char*>(buffer), static_cast<std::streamsize>(m_block_size));
 
     if (!m_file) {
-        std::cerr << "Write failed\n";
+        LOG_ERROR("Write failed");
+        return false;
+    }
+    m_blocks_written.fetch_add(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+bool Disk::write_blocks(int first_block, int block_count, const void* buffer) {
+    OpTimer timer(m_stats, Op::DISK_WRITE);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) {
+        LOG_ERROR("Disk is not open");
+        return false;
+    }
+
+    if (first_block < 0 || block_count < 0 || first_block + block_count > m_number_of_blocks) {
+        LOG_ERROR("Block range out of range for writing");
+        return false;
+    }
+
+    std::streamoff offset = static_cast<std::streamoff>(first_block) * static_cast<std::streamoff>(m_block_size);
+    m_file.seekp(offset, std::ios::beg);
+    if (!m_file) {
+        LOG_ERROR("Moving disk write pointer failed");
+        return false;
+    }
+
+    m_file.write(reinterpret_cast<const char*>(buffer), static_cast<std::streamsize>(block_count) * m_block_size);
+    if (!m_file) {
+        LOG_ERROR("Write failed");
         return false;
     }
+    m_blocks_written.fetch_add(block_count, std::memory_order_relaxed);
 
     return true;
 }
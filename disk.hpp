@@ -1,8 +1,14 @@
 #ifndef DISK_H
 #define DISK_H
 
+#include "block_pool.hpp"
+#include "op_stats.hpp"
+
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <fstream>
+#include <mutex>
 
 class Disk 
 {
@@ -18,21 +24,47 @@ public:
 
     bool read_block(int block_number, void* buffer);
 
+    // block_count consecutive blocks from first_block on, in one seek and one read
+    bool read_blocks(int first_block, int block_count, void* buffer);
+
     bool write_block(int block_number, const void* buffer);
 
+    // block_count consecutive blocks from first_block on, in one seek and one write
+    bool write_blocks(int first_block, int block_count, const void* buffer);
+
     int block_size() const { return m_block_size; };
 
     int number_of_blocks() const { return m_number_of_blocks; };
 
+    // Block-sized scratch buffers for everyone doing I/O on this disk
+    BlockPool& block_pool() { return m_block_pool; };
+
     void flush();
 
+    // Successful block transfers since the disk was created, safe to read from any thread
+    uint64_t blocks_read() const { return m_blocks_read.load(std::memory_order_relaxed); };
+
+    uint64_t blocks_written() const { return m_blocks_written.load(std::memory_order_relaxed); };
+
+    // Latency histograms of read_block and write_block, including the wait for the stream
+    StatsSnapshot stats() const { return m_stats.snapshot(); };
+
 private:
     std::fstream m_file{};
     std::string m_path{};
+
+    // Seek + read/write on the shared stream must not interleave across threads
+    std::mutex m_mutex{};
+
+    std::atomic<uint64_t> m_blocks_read{0};
+    std::atomic<uint64_t> m_blocks_written{0};
+    OpStats m_stats{};
     
     const int m_number_of_blocks{};
     const int m_block_size{};
 
+    BlockPool m_block_pool;
+
     bool ensure_size();
 };
 #endif
@@ -0,0 +1,365 @@
+#include "exporter.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t CHUNK_BYTES = 1 << 20;
+constexpr int CHUNK_COUNT = 4;
+constexpr size_t TAR_BLOCK = 512;
+
+struct ExportEntry {
+    std::string path;     // in the image
+    std::string name;     // relative to the export root
+    int index_block{};
+    uint64_t size{};
+};
+
+struct Chunk {
+    size_t file{};
+    bool first{};
+    bool last{};
+    bool failed{};
+    std::string data{};
+};
+
+using ChunkCallback = std::function<void(const ExportEntry& entry, const Chunk& chunk)>;
+
+// A name that would leave the export root once joined onto it ("..") or not name anything of its own
+bool safe_entry_name(std::string_view name) {
+    return !name.empty() && name != "." && name != ".." && name.find('/') == std::string_view::npos;
+}
+
+// Depth first; names of everything below root, relative to it. Entries with unsafe names are
+// skipped along with everything under them and counted in rejected.
+bool collect(FileSystem& fs, const std::string& path, const std::string& name, std::vector<ExportEntry>& directories,
+             std::vector<ExportEntry>& files, int& rejected) {
+    std::vector<DirectoryEntry> entries;
+    if (!fs.list_directory_entries(path, entries)) {
+        return false;
+    }
+
+    for (const DirectoryEntry& entry : entries) {
+        const std::string_view entry_name(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        if (!safe_entry_name(entry_name)) {
+            LOG_ERROR("export: skipping unsafe name \"" << entry_name << "\" in " << path);
+            ++rejected;
+            continue;
+        }
+        const std::string child_path = (path == "/" ? "" : path) + "/" + std::string(entry_name);
+        const std::string child_name = name.empty() ? std::string(entry_name) : name + "/" + std::string(entry_name);
+        const Inode& inode = fs.inode_table()[entry.inode_index];
+        if (inode.type == InodeType::DIRECTORY) {
+            directories.push_back({child_path, child_name, inode.index_block, 0});
+            if (!collect(fs, child_path, child_name, directories, files, rejected)) {
+                return false;
+            }
+        } else if (inode.type == InodeType::FILE) {
+            files.push_back({child_path, child_name, inode.index_block, static_cast<uint64_t>(std::max(0, inode.size))});
+        }
+    }
+    return true;
+}
+
+bool collect_tree(FileSystem& fs, const std::string& path, std::vector<ExportEntry>& directories, std::vector<ExportEntry>& files,
+                  int& rejected) {
+    const int inode = fs.lookup(path);
+    if (inode < 0 || !fs.is_directory_inode(inode)) {
+        LOG_ERROR("export: " << path << " is not a directory");
+        return false;
+    }
+
+    std::string root = path.empty() ? "/" : path;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    if (!collect(fs, root, "", directories, files, rejected)) {
+        LOG_ERROR("export: failed to list " << root);
+        return false;
+    }
+
+    // Index blocks are allocated just ahead of their data, so this is close to on-disk order
+    std::sort(files.begin(), files.end(), [](const ExportEntry& a, const ExportEntry& b) { return a.index_block < b.index_block; });
+    return true;
+}
+
+// Reads every file on a separate thread and hands it to on_chunk in order, at most CHUNK_BYTES at a time.
+// Every file gets at least one chunk with first set and exactly one with last set; failed marks a file
+// that could not be read from that chunk on.
+void stream_files(FileSystem& fs, const std::vector<ExportEntry>& files, const ChunkCallback& on_chunk) {
+    std::array<Chunk, CHUNK_COUNT> chunks{};
+    std::deque<Chunk*> free_chunks;
+    std::deque<Chunk*> full_chunks;
+    for (Chunk& chunk : chunks) {
+        chunk.data.reserve(CHUNK_BYTES);
+        free_chunks.push_back(&chunk);
+    }
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done = false;
+
+    auto take_free = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !free_chunks.empty(); });
+        Chunk* chunk = free_chunks.front();
+        free_chunks.pop_front();
+        return chunk;
+    };
+    auto hand_over = [&](Chunk* chunk) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            full_chunks.push_back(chunk);
+        }
+        changed.notify_all();
+    };
+
+    std::thread reader([&]() {
+        for (size_t i = 0; i < files.size(); ++i) {
+            const int fd = fs.open_file(files[i].path);
+            uint64_t offset = 0;
+            bool first = true;
+            while (true) {
+                Chunk* chunk = take_free();
+                chunk->file = i;
+                chunk->first = first;
+                chunk->failed = fd < 0 || !fs.read_file_range(fd, static_cast<int>(offset), static_cast<int>(CHUNK_BYTES), chunk->data);
+                if (chunk->failed) {
+                    chunk->data.clear();
+                }
+                offset += chunk->data.size();
+                chunk->last = chunk->failed || chunk->data.empty() || offset >= files[i].size;
+                first = false;
+
+                const bool last = chunk->last;
+                hand_over(chunk);
+                if (last) {
+                    break;
+                }
+            }
+            if (fd >= 0) {
+                fs.close_file(fd);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        changed.notify_all();
+    });
+
+    while (true) {
+        Chunk* chunk = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return !full_chunks.empty() || done; });
+            if (full_chunks.empty()) {
+                break;
+            }
+            chunk = full_chunks.front();
+            full_chunks.pop_front();
+        }
+
+        on_chunk(files[chunk->file], *chunk);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_chunks.push_back(chunk);
+        }
+        changed.notify_all();
+    }
+    reader.join();
+}
+
+void put_octal(char* field, size_t width, uint64_t value) {
+    // width - 1 digits and a terminating NUL
+    std::snprintf(field, width, "%0*llo", static_cast<int>(width - 1), static_cast<unsigned long long>(value));
+}
+
+void write_tar_header(std::ostream& out, const std::string& name, char type, uint64_t size, uint64_t mtime) {
+    std::array<char, TAR_BLOCK> header{};
+
+    // Names that fit neither field, nor the prefix/name split, go in a GNU long name record first
+    size_t split = std::string::npos;
+    if (name.size() > 100) {
+        split = name.rfind('/', 155);
+        if (split != std::string::npos && name.size() - split - 1 > 100) {
+            split = std::string::npos;
+        }
+        if (split == std::string::npos) {
+            write_tar_header(out, "././@LongLink", 'L', name.size() + 1, 0);
+            out.write(name.c_str(), static_cast<std::streamsize>(name.size() + 1));
+            const size_t padding = (TAR_BLOCK - (name.size() + 1) % TAR_BLOCK) % TAR_BLOCK;
+            const std::array<char, TAR_BLOCK> zeros{};
+            out.write(zeros.data(), static_cast<std::streamsize>(padding));
+        }
+    }
+
+    if (name.size() <= 100) {
+        std::memcpy(&header[0], name.data(), name.size());
+    } else if (split != std::string::npos) {
+        std::memcpy(&header[345], name.data(), split);
+        std::memcpy(&header[0], name.data() + split + 1, name.size() - split - 1);
+    } else {
+        std::memcpy(&header[0], name.data(), 100);
+    }
+
+    put_octal(&header[100], 8, type == '5' ? 0755 : 0644);
+    put_octal(&header[108], 8, 0);
+    put_octal(&header[116], 8, 0);
+    put_octal(&header[124], 12, size);
+    put_octal(&header[136], 12, mtime);
+    header[156] = type;
+    std::memcpy(&header[257], "ustar", 6);
+    std::memcpy(&header[263], "00", 2);
+
+    // The checksum is taken with its own field read as spaces
+    std::memset(&header[148], ' ', 8);
+    unsigned checksum = 0;
+    for (char c : header) {
+        checksum += static_cast<unsigned char>(c);
+    }
+    std::snprintf(&header[148], 8, "%06o", checksum);
+    header[155] = ' ';
+
+    out.write(header.data(), TAR_BLOCK);
+}
+
+}
+
+bool export_tar(FileSystem& fs, const std::string& path, std::ostream& out, ExportResult& result) {
+    result = {};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ExportEntry> directories;
+    std::vector<ExportEntry> files;
+    if (!collect_tree(fs, path, directories, files, result.failed)) {
+        return false;
+    }
+
+    const uint64_t mtime = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    for (const ExportEntry& directory : directories) {
+        write_tar_header(out, directory.name + "/", '5', 0, mtime);
+        ++result.directories;
+    }
+
+    const std::array<char, TAR_BLOCK> zeros{};
+    uint64_t written = 0; // of the current file
+    bool header_written = false;
+    stream_files(fs, files, [&](const ExportEntry& entry, const Chunk& chunk) {
+        if (chunk.first) {
+            written = 0;
+            header_written = false;
+            // Nothing could be read: leave the file out rather than promise bytes we do not have
+            if (chunk.failed) {
+                LOG_ERROR("export: cannot read " << entry.path);
+                ++result.failed;
+                return;
+            }
+            write_tar_header(out, entry.name, '0', entry.size, mtime);
+            header_written = true;
+        }
+        if (!header_written) {
+            return;
+        }
+
+        const size_t take = static_cast<size_t>(std::min<uint64_t>(chunk.data.size(), entry.size - written));
+        out.write(chunk.data.data(), static_cast<std::streamsize>(take));
+        written += take;
+        result.bytes += take;
+
+        if (chunk.last) {
+            // The header already promised entry.size bytes
+            if (written < entry.size) {
+                LOG_ERROR("export: " << entry.path << " is short, zero-filled");
+                ++result.failed;
+                for (uint64_t left = entry.size - written; left > 0;) {
+                    const size_t n = static_cast<size_t>(std::min<uint64_t>(left, TAR_BLOCK));
+                    out.write(zeros.data(), static_cast<std::streamsize>(n));
+                    left -= n;
+                }
+            } else {
+                ++result.files;
+            }
+            out.write(zeros.data(), static_cast<std::streamsize>((TAR_BLOCK - entry.size % TAR_BLOCK) % TAR_BLOCK));
+        }
+    });
+
+    // End of archive
+    out.write(zeros.data(), TAR_BLOCK);
+    out.write(zeros.data(), TAR_BLOCK);
+    out.flush();
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!out) {
+        LOG_ERROR("export: writing the archive failed");
+        return false;
+    }
+    return result.failed == 0;
+}
+
+bool export_to_directory(FileSystem& fs, const std::string& path, const std::string& host_dir, ExportResult& result) {
+    result = {};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ExportEntry> directories;
+    std::vector<ExportEntry> files;
+    if (!collect_tree(fs, path, directories, files, result.failed)) {
+        return false;
+    }
+
+    const std::filesystem::path root(host_dir);
+    std::error_code error;
+    std::filesystem::create_directories(root, error);
+    for (const ExportEntry& directory : directories) {
+        if (std::filesystem::create_directories(root / directory.name, error) || !error) {
+            ++result.directories;
+        } else {
+            LOG_ERROR("export: cannot create " << (root / directory.name).string() << ": " << error.message());
+        }
+    }
+
+    std::ofstream file;
+    bool write_failed = false;
+    stream_files(fs, files, [&](const ExportEntry& entry, const Chunk& chunk) {
+        if (chunk.first) {
+            write_failed = false;
+            file.open(root / entry.name, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                LOG_ERROR("export: cannot write " << (root / entry.name).string());
+                write_failed = true;
+            }
+        }
+
+        if (!write_failed) {
+            file.write(chunk.data.data(), static_cast<std::streamsize>(chunk.data.size()));
+            result.bytes += chunk.data.size();
+        }
+
+        if (chunk.last) {
+            file.close();
+            if (chunk.failed || write_failed || file.fail()) {
+                LOG_ERROR("export: failed to copy " << entry.path);
+                ++result.failed;
+            } else {
+                ++result.files;
+            }
+            file.clear();
+        }
+    });
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result.failed == 0;
+}
@@ -0,0 +1,27 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include "filesystem.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+struct ExportResult {
+    int directories{};
+    int files{};
+    int failed{};       // files that could not be read, and entries skipped for a name like ".."; in a tar
+                        // unreadable files are left out or zero-filled
+    uint64_t bytes{};
+    double seconds{};
+};
+
+// Streams the tree under path out of the image, either as a ustar archive into out or as files under
+// host_dir (created if missing). Names are relative to path. Directories come first, then the files in
+// the order their index blocks sit on disk, so reads mostly move forward. A reader thread fills a few
+// fixed chunks while the calling thread writes the previous ones, so memory use does not grow with the
+// size of the files.
+bool export_tar(FileSystem& fs, const std::string& path, std::ostream& out, ExportResult& result);
+bool export_to_directory(FileSystem& fs, const std::string& path, const std::string& host_dir, ExportResult& result);
+
+#endif
@@ -0,0 +1,199 @@
+#include "file_tree.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ull;
+constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+// Path hashes are built one component at a time ("/" + name), so a child's hash extends its parent's
+uint64_t hash_component(uint64_t hash, std::string_view name) {
+    hash = (hash ^ static_cast<unsigned char>('/')) * FNV_PRIME;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Calls fn for each non-empty component of path, front to back
+template <typename Fn>
+void for_each_component(std::string_view path, Fn fn) {
+    size_t start = 0;
+    while (start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string_view::npos)
+            end = path.size();
+        if (end > start)
+            fn(path.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+}
+
+uint32_t NamePool::intern(std::string_view name) {
+    auto found = m_ids.find(name);
+    if (found != m_ids.end()) {
+        return found->second;
+    }
+
+    // Chunks never reallocate: a name that doesn't fit starts a new one
+    if (m_chunks.empty() || m_chunks.back().size() + name.size() > m_chunks.back().capacity()) {
+        m_chunks.emplace_back();
+        m_chunks.back().reserve(std::max(CHUNK_SIZE, name.size()));
+    }
+
+    std::string& chunk = m_chunks.back();
+    const size_t offset = chunk.size();
+    chunk.append(name.data(), name.size());
+
+    std::string_view stored(chunk.data() + offset, name.size());
+    const uint32_t id = static_cast<uint32_t>(m_names.size());
+    m_names.push_back(stored);
+    m_ids.emplace(stored, id);
+    return id;
+}
+
+FileTree::FileTree() {
+    FileNode root;
+    root.in_use = true;
+    root.is_directory = true;
+    root.name = m_names.intern("/");
+    root.path_hash = FNV_OFFSET;
+    m_nodes.push_back(root);
+    m_by_path.emplace(root.path_hash, 0);
+}
+
+std::string FileTree::path_of(NodeId id) const {
+    if (id == root()) {
+        return "/";
+    }
+
+    size_t length = 0;
+    for (NodeId n = id; n != root() && n != NO_NODE; n = m_nodes[n].parent) {
+        length += 1 + name(n).size();
+    }
+
+    // Filled back to front so the walk up the parents is done once
+    std::string path(length, '/');
+    size_t end = length;
+    for (NodeId n = id; n != root() && n != NO_NODE; n = m_nodes[n].parent) {
+        std::string_view part = name(n);
+        end -= part.size();
+        std::copy(part.begin(), part.end(), path.begin() + end);
+        end -= 1;
+    }
+    return path;
+}
+
+bool FileTree::path_equals(NodeId id, std::string_view path) const {
+    // Compare components from the leaf upwards against the path from its end
+    size_t end = path.size();
+    NodeId n = id;
+    while (true) {
+        while (end > 0 && path[end - 1] == '/')
+            --end;
+        if (end == 0)
+            return n == root();
+        if (n == root() || n == NO_NODE)
+            return false;
+
+        size_t start = path.rfind('/', end - 1);
+        start = start == std::string_view::npos ? 0 : start + 1;
+        if (path.substr(start, end - start) != name(n))
+            return false;
+
+        end = start;
+        n = m_nodes[n].parent;
+    }
+}
+
+NodeId FileTree::find_by_path(std::string_view path) const {
+    uint64_t hash = FNV_OFFSET;
+    for_each_component(path, [&](std::string_view part) { hash = hash_component(hash, part); });
+
+    auto [first, last] = m_by_path.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        if (path_equals(it->second, path)) {
+            return it->second;
+        }
+    }
+    return NO_NODE;
+}
+
+NodeId FileTree::find_by_inode(int inode_index) const {
+    if (inode_index < 0 || inode_index >= static_cast<int>(m_by_inode.size())) {
+        return NO_NODE;
+    }
+    return m_by_inode[inode_index];
+}
+
+NodeId FileTree::add_child(NodeId parent, std::string_view child_name, int inode_index, bool is_directory) {
+    NodeId id;
+    if (!m_free.empty()) {
+        id = m_free.back();
+        m_free.pop_back();
+    } else {
+        id = static_cast<NodeId>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    FileNode& child = m_nodes[id];
+    child = FileNode{};
+    child.in_use = true;
+    child.parent = parent;
+    child.name = m_names.intern(child_name);
+    child.path_hash = hash_component(m_nodes[parent].path_hash, child_name);
+    child.inode_index = inode_index;
+    child.is_directory = is_directory;
+
+    FileNode& p = m_nodes[parent];
+    if (p.last_child == NO_NODE) {
+        p.first_child = id;
+    } else {
+        m_nodes[p.last_child].next_sibling = id;
+    }
+    p.last_child = id;
+
+    m_by_path.emplace(child.path_hash, id);
+
+    if (inode_index >= 0) {
+        if (inode_index >= static_cast<int>(m_by_inode.size()))
+            m_by_inode.resize(inode_index + 1, NO_NODE);
+        m_by_inode[inode_index] = id;
+    }
+    return id;
+}
+
+void FileTree::release(NodeId id) {
+    for (NodeId child = m_nodes[id].first_child; child != NO_NODE;) {
+        NodeId next = m_nodes[child].next_sibling;
+        release(child);
+        child = next;
+    }
+
+    FileNode& n = m_nodes[id];
+    auto [first, last] = m_by_path.equal_range(n.path_hash);
+    for (auto it = first; it != last; ++it) {
+        if (it->second == id) {
+            m_by_path.erase(it);
+            break;
+        }
+    }
+    if (n.inode_index >= 0 && n.inode_index < static_cast<int>(m_by_inode.size()) && m_by_inode[n.inode_index] == id)
+        m_by_inode[n.inode_index] = NO_NODE;
+
+    n = FileNode{};
+    m_free.push_back(id);
+}
+
+void FileTree::clear_children(NodeId id) {
+    for (NodeId child = m_nodes[id].first_child; child != NO_NODE;) {
+        NodeId next = m_nodes[child].next_sibling;
+        release(child);
+        child = next;
+    }
+    m_nodes[id].first_child = NO_NODE;
+    m_nodes[id].last_child = NO_NODE;
+}
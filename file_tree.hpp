@@ -0,0 +1,87 @@
+#ifndef FILE_TREE_H
+#define FILE_TREE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using NodeId = int;
+constexpr NodeId NO_NODE = -1;
+
+struct FileNode {
+    NodeId parent{NO_NODE};
+    NodeId first_child{NO_NODE};
+    NodeId last_child{NO_NODE};
+    NodeId next_sibling{NO_NODE};
+
+    uint32_t name{};         // id in the tree's name pool
+    uint64_t path_hash{};    // hash of the full path, key into the path map
+    int inode_index{-1};
+
+    bool in_use{false};
+    bool is_directory{};
+    bool is_expanded{};
+
+    // Children are fetched by the background loader; load_ticket tells the
+    // current request apart from listings that were superseded
+    bool children_loaded{false};
+    bool loading{false};
+    uint64_t load_ticket{0};
+};
+
+// Interned entry names. Storage is chunked so views handed out stay valid as the pool grows.
+class NamePool {
+public:
+    uint32_t intern(std::string_view name);
+    std::string_view get(uint32_t id) const { return m_names[id]; };
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::deque<std::string> m_chunks{};
+    std::vector<std::string_view> m_names{};
+    std::unordered_map<std::string_view, uint32_t> m_ids{};
+};
+
+// TUI model of the directory tree: nodes live in one pooled vector and refer to each other by index.
+// Paths are not stored, they are rebuilt from parent links when needed.
+class FileTree {
+public:
+    FileTree();
+
+    NodeId root() const { return 0; };
+
+    FileNode& node(NodeId id) { return m_nodes[id]; };
+    const FileNode& node(NodeId id) const { return m_nodes[id]; };
+
+    std::string_view name(NodeId id) const { return m_names.get(m_nodes[id].name); };
+    std::string path_of(NodeId id) const;
+
+    NodeId find_by_path(std::string_view path) const;
+    NodeId find_by_inode(int inode_index) const;
+
+    // Appends a child after the existing ones. May grow the pool, so FileNode references taken before are invalidated.
+    NodeId add_child(NodeId parent, std::string_view name, int inode_index, bool is_directory);
+
+    // Releases every descendant of id back to the pool
+    void clear_children(NodeId id);
+
+    size_t node_count() const { return m_nodes.size() - m_free.size(); };
+
+private:
+    std::vector<FileNode> m_nodes{};
+    std::vector<NodeId> m_free{};
+    NamePool m_names{};
+
+    // Several paths may share a hash; each keeps its own entry, so releasing one leaves the others findable
+    std::unordered_multimap<uint64_t, NodeId> m_by_path{};
+    std::vector<NodeId> m_by_inode{};
+
+    bool path_equals(NodeId id, std::string_view path) const;
+    void release(NodeId id);
+};
+
+#endif
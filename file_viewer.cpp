@@ -0,0 +1,260 @@
+#include "file_viewer.hpp"
+#include "log.hpp"
+#include "substring_search.hpp"
+
+#include <algorithm>
+
+FileViewer::~FileViewer() {
+    close();
+}
+
+bool FileViewer::open(const std::string& path) {
+    close();
+
+    std::lock_guard<std::mutex> lock(m_fs_mutex);
+    m_fd = m_fs.open_file(path);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_size = m_fs.file_size(m_fd);
+    m_block_size = m_fs.superblock().block_size;
+    if (m_size < 0 || m_block_size <= 0) {
+        m_fs.close_file(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_path = path;
+    m_top = 0;
+    m_backward = false;
+    return true;
+}
+
+void FileViewer::close() {
+    if (m_fd >= 0) {
+        std::lock_guard<std::mutex> lock(m_fs_mutex);
+        m_fs.close_file(m_fd);
+    }
+    m_fd = -1;
+    m_size = 0;
+    m_path.clear();
+    m_cache.clear();
+    m_last_block = -1;
+}
+
+void FileViewer::set_viewport(int rows) {
+    // A screen of short lines rarely needs more than a few blocks; long lines are capped at MAX_LINE_BYTES
+    const int bytes = std::max(1, rows) * 128;
+    const size_t blocks = m_block_size > 0 ? static_cast<size_t>(bytes / m_block_size + 1) : 1;
+    m_cache_capacity = blocks + 2 * READAHEAD_BLOCKS + 1;
+
+    while (m_cache.size() > m_cache_capacity) {
+        auto oldest = std::min_element(m_cache.begin(), m_cache.end(), [](const CachedBlock& a, const CachedBlock& b) { return a.last_used < b.last_used; });
+        m_cache.erase(oldest);
+    }
+}
+
+bool FileViewer::load_blocks(int first, int count) {
+    const int last_block = (m_size - 1) / m_block_size;
+    first = std::max(0, first);
+    count = std::min({count, last_block - first + 1, static_cast<int>(m_cache_capacity)});
+    if (count <= 0) {
+        return false;
+    }
+
+    // One range read fetches the whole window, the file's index block is read once for all of it
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(m_fs_mutex);
+        if (!m_fs.read_file_range(m_fd, first * m_block_size, count * m_block_size, data)) {
+            LOG_ERROR("FileViewer: failed to read " << m_path);
+            return false;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const int index = first + i;
+        auto slot = std::find_if(m_cache.begin(), m_cache.end(), [&](const CachedBlock& b) { return b.index == index; });
+        if (slot == m_cache.end()) {
+            if (m_cache.size() < m_cache_capacity) {
+                m_cache.emplace_back();
+                slot = m_cache.end() - 1;
+            } else {
+                slot = std::min_element(m_cache.begin(), m_cache.end(), [](const CachedBlock& a, const CachedBlock& b) { return a.last_used < b.last_used; });
+            }
+        }
+
+        const size_t from = static_cast<size_t>(i) * m_block_size;
+        slot->index = index;
+        slot->last_used = ++m_clock;
+        slot->data.assign(data, std::min(from, data.size()), m_block_size);
+    }
+    return true;
+}
+
+const std::string* FileViewer::block(int index) {
+    for (auto& cached : m_cache) {
+        if (cached.index == index) {
+            // byte_at() asks once per byte; only a move to another block counts as a lookup
+            if (index != m_last_block)
+                ++m_cache_hits;
+            m_last_block = index;
+            cached.last_used = ++m_clock;
+            return &cached.data;
+        }
+    }
+    ++m_cache_misses;
+    m_last_block = index;
+
+    // Miss: fetch this block plus the readahead window in the direction the view is moving
+    const int first = m_backward ? index - READAHEAD_BLOCKS : index;
+    if (!load_blocks(first, READAHEAD_BLOCKS + 1)) {
+        return nullptr;
+    }
+
+    for (auto& cached : m_cache) {
+        if (cached.index == index) {
+            return &cached.data;
+        }
+    }
+    return nullptr;
+}
+
+bool FileViewer::byte_at(int offset, char& out) {
+    if (offset < 0 || offset >= m_size) {
+        return false;
+    }
+
+    const std::string* data = block(offset / m_block_size);
+    const size_t within = static_cast<size_t>(offset % m_block_size);
+    if (!data || within >= data->size()) {
+        return false;
+    }
+    out = (*data)[within];
+    return true;
+}
+
+int FileViewer::next_line_start(int offset) {
+    const int limit = std::min(m_size, offset + MAX_LINE_BYTES);
+    char c;
+    for (int i = offset; i < limit; ++i) {
+        if (!byte_at(i, c))
+            return m_size;
+        if (c == '\n')
+            return i + 1;
+    }
+    return limit;
+}
+
+int FileViewer::line_start(int offset) {
+    // Looks back at most one display line; past that, offset itself starts the display line
+    const int limit = std::max(0, offset - MAX_LINE_BYTES);
+    char c;
+    for (int i = offset - 1; i >= limit; --i) {
+        if (!byte_at(i, c) || c == '\n')
+            return i + 1;
+    }
+    return limit == 0 ? 0 : offset;
+}
+
+int FileViewer::previous_line_start(int offset) {
+    if (offset <= 0) {
+        return 0;
+    }
+
+    // offset - 1 ends the previous line (its newline, or the break of a capped line)
+    const int limit = std::max(0, offset - 1 - MAX_LINE_BYTES);
+    char c;
+    for (int i = offset - 2; i >= limit; --i) {
+        if (!byte_at(i, c) || c == '\n')
+            return i + 1;
+    }
+    return limit;
+}
+
+std::vector<std::string> FileViewer::visible_lines(int count) {
+    std::vector<std::string> lines;
+    int offset = m_top;
+    while (static_cast<int>(lines.size()) < count && offset < m_size) {
+        std::string line;
+        const int limit = std::min(m_size, offset + MAX_LINE_BYTES);
+        char c = '\0';
+        while (offset < limit && byte_at(offset, c)) {
+            ++offset;
+            if (c == '\n')
+                break;
+            line.push_back(c);
+        }
+        lines.push_back(std::move(line));
+
+        if (offset < limit && c != '\n')
+            break; // read error, show what we have
+    }
+    return lines;
+}
+
+void FileViewer::scroll(int lines) {
+    m_backward = lines < 0;
+    for (; lines > 0; --lines) {
+        const int next = next_line_start(m_top);
+        if (next >= m_size)
+            break;
+        m_top = next;
+    }
+    for (; lines < 0 && m_top > 0; ++lines) {
+        m_top = previous_line_start(m_top);
+    }
+}
+
+void FileViewer::scroll_to_start() {
+    m_top = 0;
+    m_backward = false;
+}
+
+void FileViewer::scroll_to_end(int rows) {
+    m_top = m_size;
+    scroll(-std::max(1, rows));
+}
+
+void FileViewer::jump_to_offset(int offset) {
+    offset = std::max(0, std::min(offset, m_size - 1));
+    m_backward = offset < m_top;
+    m_top = std::max(0, line_start(offset));
+}
+
+int FileViewer::find_next(const std::string& text) {
+    if (text.empty() || m_size == 0 || m_fd < 0) {
+        return -1;
+    }
+
+    // Searched in windows the size of the block cache, read straight from the file so the cached screen survives.
+    // The last text.size() - 1 bytes of a window are read again at the start of the next one.
+    const int window = static_cast<int>(m_cache_capacity) * m_block_size;
+    const int overlap = static_cast<int>(text.size()) - 1;
+
+    auto search = [&](int from, int to) -> int {
+        std::string data;
+        for (int start = from; start < to; start += window) {
+            {
+                std::lock_guard<std::mutex> lock(m_fs_mutex);
+                if (!m_fs.read_file_range(m_fd, start, window + overlap, data))
+                    return -1;
+            }
+            const size_t found = find_substring(data.data(), data.size(), text.data(), text.size());
+            if (found != SUBSTRING_NOT_FOUND && start + static_cast<int>(found) < to)
+                return start + static_cast<int>(found);
+        }
+        return -1;
+    };
+
+    const int from = next_line_start(m_top);
+    int match = search(from, m_size);
+    if (match < 0) {
+        match = search(0, std::min(from, m_size));
+    }
+    if (match >= 0) {
+        jump_to_offset(match);
+    }
+    return match;
+}
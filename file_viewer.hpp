@@ -0,0 +1,88 @@
+#ifndef FILE_VIEWER_H
+#define FILE_VIEWER_H
+
+#include "filesystem.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Read-only, paged view of one file. Only the blocks around the screen are kept in memory:
+// a small cache sized from the viewport, filled with a readahead window as the view moves.
+class FileViewer {
+public:
+    // Display lines longer than this are broken up, so one huge line cannot pull in the whole file
+    static constexpr int MAX_LINE_BYTES = 4096;
+    // Blocks fetched past a miss in the direction of travel
+    static constexpr int READAHEAD_BLOCKS = 4;
+
+    FileViewer(FileSystem& fs, std::mutex& fs_mutex) : m_fs(fs), m_fs_mutex(fs_mutex) {};
+    ~FileViewer();
+
+    FileViewer(const FileViewer&) = delete;
+    FileViewer& operator=(const FileViewer&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const std::string& path() const { return m_path; };
+    int size() const { return m_size; };
+    int top() const { return m_top; };
+
+    // Resizes the block cache to cover `rows` screen lines plus readahead on either side
+    void set_viewport(int rows);
+
+    // Up to `count` display lines starting at the top of the view
+    std::vector<std::string> visible_lines(int count);
+
+    void scroll(int lines);
+    void scroll_to_start();
+    void scroll_to_end(int rows);
+
+    // Puts the line containing offset at the top of the view
+    void jump_to_offset(int offset);
+
+    // Moves the view to the next line containing text, wrapping around at the end of the file.
+    // Returns the match offset, or -1 if the file does not contain text.
+    int find_next(const std::string& text);
+
+    // Block cache lookups since the viewer was created
+    uint64_t cache_hits() const { return m_cache_hits; };
+    uint64_t cache_misses() const { return m_cache_misses; };
+
+private:
+    struct CachedBlock {
+        int index{-1};
+        uint64_t last_used{};
+        std::string data{};
+    };
+
+    FileSystem& m_fs;
+    std::mutex& m_fs_mutex;
+
+    std::string m_path{};
+    int m_fd{-1};
+    int m_size{};
+    int m_block_size{};
+
+    int m_top{};        // byte offset of the first line on screen
+    bool m_backward{};  // direction of the last move, readahead follows it
+
+    std::vector<CachedBlock> m_cache{};
+    size_t m_cache_capacity{2 * READAHEAD_BLOCKS + 1};
+    uint64_t m_clock{};
+    uint64_t m_cache_hits{};
+    uint64_t m_cache_misses{};
+    int m_last_block{-1};
+
+    const std::string* block(int index);
+    bool load_blocks(int first, int count);
+    bool byte_at(int offset, char& out);
+
+    int next_line_start(int offset);
+    int previous_line_start(int offset);
+    int line_start(int offset);
+};
+
+#endif
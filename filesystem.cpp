@@ -1,24 +1,45 @@
 #include "filesystem.hpp"
-#include <iostream>
+#include "log.hpp"
+#include "path_pattern.hpp"
+#include "path_view.hpp"
+#include "substring_search.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <regex>
+#include <thread>
+
+// Name index blocks are read and written this many at a time at format and mount
+constexpr int NAME_INDEX_RUN_BLOCKS = 256;
+// Name index scans let go of the search lock after this many entries
+constexpr int SEARCH_LOCK_STRIDE = 256;
 
 bool FileSystem::initialize() {
     if (!m_disk.is_open()) {
-        std::cerr <<"Cannot format: disk is not open\n";
+        LOG_ERROR("Cannot format: disk is not open");
         return false;
     }
+    m_next_free_block = 0;
+    m_next_free_inode = 0;
 
     if (!FileSystem::initialize_superblock()) {
-        std::cerr << "Failed to intialize superblock\n";
+        LOG_ERROR("Failed to intialize superblock");
         return false;
     }
 
     if (!FileSystem::initialize_inode_table()) {
-        std::cerr << "Failed to initialize inode table\n";
+        LOG_ERROR("Failed to initialize inode table");
         return false;
     }
 
     if (!FileSystem::initialize_free_bitmap()) {
-        std::cerr << "Failed to initialize free bitmap\n";
+        LOG_ERROR("Failed to initialize free bitmap");
+        return false;
+    }
+
+    if (!FileSystem::initialize_name_index()) {
+        LOG_ERROR("Failed to initialize name index");
         return false;
     }
     return true;
@@ -29,31 +50,46 @@ bool FileSystem::initialize_superblock() {
     const int block_size = m_disk.block_size();
     const int total_blocks = m_disk.number_of_blocks();
 
-    const int inode_table_bytes  = m_max_inodes * static_cast<int>(sizeof(Inode));
-    const int inode_table_blocks = (inode_table_bytes + block_size - 1) / block_size;
+    // Sizes are worked out in 64 bits: an inode table for a few hundred million inodes, or the bitmap
+    // rounding near INT32_MAX blocks, would overflow int. The result is checked against the disk below.
+    const int64_t inode_table_bytes  = static_cast<int64_t>(m_max_inodes) * static_cast<int64_t>(sizeof(Inode));
+    const int64_t inode_table_blocks = (inode_table_bytes + block_size - 1) / block_size;
+
+    const int64_t bits_per_block = static_cast<int64_t>(block_size) * 8;
+    const int64_t bitmap_blocks  = (total_blocks + bits_per_block - 1) / bits_per_block;
 
-    const int bits_per_block = block_size * 8;
-    const int bitmap_blocks  = (total_blocks + bits_per_block - 1) / bits_per_block;
+    const int64_t records_per_block = block_size / static_cast<int64_t>(sizeof(NameRecord));
+    const int64_t name_index_blocks = (m_max_inodes + records_per_block - 1) / records_per_block;
+
+    const int64_t data_region_start = 1 + inode_table_blocks + bitmap_blocks + name_index_blocks;
+    if (m_max_inodes <= 0 || inode_table_bytes > INT32_MAX || data_region_start >= total_blocks) {
+        LOG_ERROR("initialize: " << m_max_inodes << " inodes need " << data_region_start << " metadata blocks, the disk has " << total_blocks);
+        return false;
+    }
 
     m_superblock.id = SUPERBLOCK_MAGIC;
     m_superblock.total_blocks = total_blocks;
     m_superblock.block_size = block_size;
 
     m_superblock.inode_table_start = 1;
-    m_superblock.inode_table_blocks = inode_table_blocks;
+    m_superblock.inode_table_blocks = static_cast<int>(inode_table_blocks);
+
+    m_superblock.free_bitmap_start = m_superblock.inode_table_start + m_superblock.inode_table_blocks;
+    m_superblock.free_bitmap_blocks = static_cast<int>(bitmap_blocks);
 
-    m_superblock.free_bitmap_start = m_superblock.inode_table_start + inode_table_blocks;
-    m_superblock.free_bitmap_blocks = bitmap_blocks;
+    m_superblock.name_index_start = m_superblock.free_bitmap_start + m_superblock.free_bitmap_blocks;
+    m_superblock.name_index_blocks = static_cast<int>(name_index_blocks);
 
-    m_superblock.data_region_start = m_superblock.free_bitmap_start + bitmap_blocks;
+    m_superblock.data_region_start = static_cast<int>(data_region_start);
 
     m_superblock.root_inode_index  = 0;
+    m_superblock.max_inodes = m_max_inodes;
 
-    std::vector<char> buffer(m_disk.block_size(), 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
     std::memcpy(buffer.data(), &m_superblock, sizeof(Superblock) < buffer.size() ? sizeof(Superblock) : buffer.size());
 
     if (!m_disk.write_block(0, buffer.data())) {
-        std::cerr << "Failed to write superblock to disk\n";
+        LOG_ERROR("Failed to write superblock to disk");
         return false;
     } 
 
@@ -61,10 +97,9 @@ bool FileSystem::initialize_superblock() {
 }
 
 bool FileSystem::initialize_inode_table() {
-    const int block_size = {m_disk.block_size()};
     const int total_blocks {m_disk.number_of_blocks()};
 
-    const int inode_table_bytes {m_max_inodes * static_cast<int>(sizeof(Inode))};
+    const size_t inode_table_bytes {static_cast<size_t>(m_max_inodes) * sizeof(Inode)};
     const int inode_table_blocks {m_superblock.inode_table_blocks};
 
     const int root_index_block_start {m_superblock.data_region_start};
@@ -72,17 +107,7 @@ bool FileSystem::initialize_inode_table() {
     m_inode_table.assign(m_max_inodes, Inode{}); 
     FileSystem::initialize_root_directory();
 
-    std::vector<char> buffer(inode_table_blocks * block_size, 0);
-    std::memcpy(buffer.data(), m_inode_table.data(), inode_table_bytes);
-
-    for (int i = 0; i < inode_table_blocks; ++i) {
-        int block_number = m_superblock.inode_table_start + i;
-        if (!m_disk.write_block(block_number, buffer.data() + i * block_size)) {
-            std::cerr << "Failed to write inode table block " << block_number << "\n";
-            return false;
-        }
-    }
-    return true;
+    return write_table_blocks(m_superblock.inode_table_start, inode_table_blocks, m_inode_table.data(), inode_table_bytes, "inode table");
 }
 
 bool FileSystem::initialize_root_directory() {
@@ -93,7 +118,7 @@ bool FileSystem::initialize_root_directory() {
 
     const int block_size = m_disk.block_size();
 
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
     DirectoryEntry* entries = reinterpret_cast<DirectoryEntry*>(buffer.data());
     int max_entries = block_size / static_cast<int>(sizeof(DirectoryEntry));
 
@@ -103,7 +128,7 @@ bool FileSystem::initialize_root_directory() {
     }
 
     if (!m_disk.write_block(root.index_block, buffer.data())) {
-        std::cerr << "Failed to write root directory block\n";
+        LOG_ERROR("Failed to write root directory block");
         return false;
     }
     return true;
@@ -114,7 +139,7 @@ bool FileSystem::initialize_free_bitmap() {
     const int total_blocks {m_disk.number_of_blocks()};
 
     const int bitmap_blocks {m_superblock.free_bitmap_blocks};
-    m_free_bitmap.assign(bitmap_blocks * block_size, 0xFF);
+    m_free_bitmap.assign(static_cast<size_t>(bitmap_blocks) * block_size, 0xFF);
 
     // Mark Superblock as used
     FileSystem::mark_block_used(0);
@@ -128,18 +153,39 @@ bool FileSystem::initialize_free_bitmap() {
     for (int b = 0; b < bitmap_blocks; ++b)
         FileSystem::mark_block_used(m_superblock.free_bitmap_start + b);
 
+    // Mark Name Index Blocks as used
+    for (int b = 0; b < m_superblock.name_index_blocks; ++b)
+        FileSystem::mark_block_used(m_superblock.name_index_start + b);
+
     // Mark Root Directory Index Block as used
     FileSystem::mark_block_used(m_inode_table[0].index_block);
     
     //Write Free Bitmap to disk
-    for (int i = 0; i < bitmap_blocks; ++i) {
-        int block_number = m_superblock.free_bitmap_start + i;
-        if (!m_disk.write_block(block_number, reinterpret_cast<const char*>(m_free_bitmap.data()) + i * block_size)) {
-            std::cerr << "Failed to write free-space bitmap block " << block_number << "\n";
+    return write_table_blocks(m_superblock.free_bitmap_start, bitmap_blocks, m_free_bitmap.data(), m_free_bitmap.size(), "free-space bitmap");
+}
+
+bool FileSystem::initialize_name_index() {
+    m_name_index.reset(m_max_inodes);
+
+    // Records do not straddle blocks, so each block is staged; a run of them goes out in one write
+    const int block_size = m_disk.block_size();
+    const int records_per_block = block_size / static_cast<int>(sizeof(NameRecord));
+    const std::vector<NameRecord>& records = m_name_index.records();
+    std::vector<char> staging(static_cast<size_t>(std::min(m_superblock.name_index_blocks, NAME_INDEX_RUN_BLOCKS)) * block_size);
+
+    for (int first_block = 0; first_block < m_superblock.name_index_blocks; first_block += NAME_INDEX_RUN_BLOCKS) {
+        const int run = std::min(NAME_INDEX_RUN_BLOCKS, m_superblock.name_index_blocks - first_block);
+        std::fill(staging.begin(), staging.end(), 0);
+        for (int b = 0; b < run; ++b) {
+            const int first = (first_block + b) * records_per_block;
+            const int count = std::max(0, std::min(records_per_block, m_max_inodes - first));
+            std::memcpy(staging.data() + static_cast<size_t>(b) * block_size, records.data() + first, count * sizeof(NameRecord));
+        }
+        if (!m_disk.write_blocks(m_superblock.name_index_start + first_block, run, staging.data())) {
+            LOG_ERROR("Failed to write name index blocks from " << m_superblock.name_index_start + first_block);
             return false;
         }
     }
-
     return true;
 }
 
@@ -157,16 +203,45 @@ bool FileSystem::mark_block_used(int block_number) {
     return true;
 }
 
+bool FileSystem::mark_block_free(int block_number) {
+    const int total_blocks = m_disk.number_of_blocks();
+
+    if (block_number < 0 || block_number >= total_blocks) {
+        return false;
+    }
+
+    int byte_index = block_number / 8;
+    int bit_index  = block_number % 8;
+
+    m_free_bitmap[byte_index] |= static_cast<uint8_t>(1u << bit_index);
+    m_next_free_block = std::min(m_next_free_block, block_number);
+    return true;
+}
+
+bool read_image_superblock(const std::string& image_path, Superblock& out) {
+    // The superblock sits at the very start whatever the block size
+    std::ifstream image(image_path, std::ios::binary);
+    Superblock superblock{};
+    if (!image || !image.read(reinterpret_cast<char*>(&superblock), sizeof(Superblock))) {
+        return false;
+    }
+    if (superblock.id != SUPERBLOCK_MAGIC || superblock.block_size <= 0 || superblock.total_blocks <= 0) {
+        return false;
+    }
+    out = superblock;
+    return true;
+}
+
 bool FileSystem::read_superblock_from_disk() {
     if (!m_disk.is_open()) {
-        std::cerr << "Cannot read superblock: disk not open\n";
+        LOG_ERROR("Cannot read superblock: disk not open");
         return false;
     }
 
-    std::vector<char> buffer(m_disk.block_size(), 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
 
     if (!m_disk.read_block(0, buffer.data())) {
-        std::cerr << "Failed to read block 0\n";
+        LOG_ERROR("Failed to read block 0");
         return false;
     }
 
@@ -178,131 +253,289 @@ bool FileSystem::read_superblock_from_disk() {
 bool FileSystem::read_inode_table_from_disk() {
     const int block_size = {m_disk.block_size()};
 
-    const int inode_table_bytes {m_max_inodes * static_cast<int>(sizeof(Inode))};
-    const int inode_table_blocks {(inode_table_bytes + block_size - 1) / block_size};
+    const int64_t inode_table_bytes {static_cast<int64_t>(m_max_inodes) * static_cast<int64_t>(sizeof(Inode))};
+    const int inode_table_blocks {static_cast<int>((inode_table_bytes + block_size - 1) / block_size)};
 
     const int inode_table_start  = m_superblock.inode_table_start;
     const int inode_table_end    = inode_table_start + inode_table_blocks;
 
-    std::vector<char> buffer(inode_table_blocks * block_size, 0);
-
-    for (int i = 0; i < inode_table_blocks; ++i) {
-        int block_number = inode_table_start + i;
-        if (!m_disk.read_block(block_number, buffer.data() + i * block_size)) {
-            std::cerr << "mount: failed to read inode table block " << block_number << "\n";
-            return false;
-        }
-    }
-
     m_inode_table.assign(m_max_inodes, Inode{});
-    std::memcpy(m_inode_table.data(), buffer.data(), inode_table_bytes);
-    return true;
+    return read_table_blocks(inode_table_start, inode_table_blocks, m_inode_table.data(), inode_table_bytes, "inode table");
 }
 
 bool FileSystem::read_free_bitmap_from_disk() {
     const int block_size   = m_disk.block_size();
     const int bitmap_blocks= m_superblock.free_bitmap_blocks;
 
-    m_free_bitmap.assign(bitmap_blocks * block_size, 0);
+    m_free_bitmap.assign(static_cast<size_t>(bitmap_blocks) * block_size, 0);
+    return read_table_blocks(m_superblock.free_bitmap_start, bitmap_blocks, m_free_bitmap.data(), m_free_bitmap.size(), "free-space bitmap");
+}
+
+bool FileSystem::read_name_index_from_disk() {
+    m_name_index.reset(m_max_inodes);
 
-    for (int i = 0; i < bitmap_blocks; ++i) {
-        int block_number = m_superblock.free_bitmap_start + i;
-        if (!m_disk.read_block(block_number, reinterpret_cast<char*>(m_free_bitmap.data()) + i * block_size)) {
-            std::cerr << "Failed to read free-space bitmap block " << block_number << "\n";
+    // Image predates the name index: rebuild it from the directory tree, it stays in memory only
+    if (m_superblock.name_index_blocks <= 0) {
+        rebuild_name_index(m_superblock.root_inode_index);
+        return true;
+    }
+
+    const int block_size = m_disk.block_size();
+    const int records_per_block = block_size / static_cast<int>(sizeof(NameRecord));
+    std::vector<NameRecord>& records = m_name_index.records();
+    std::vector<char> staging(static_cast<size_t>(std::min(m_superblock.name_index_blocks, NAME_INDEX_RUN_BLOCKS)) * block_size);
+
+    for (int first_block = 0; first_block < m_superblock.name_index_blocks; first_block += NAME_INDEX_RUN_BLOCKS) {
+        const int run = std::min(NAME_INDEX_RUN_BLOCKS, m_superblock.name_index_blocks - first_block);
+        if (!m_disk.read_blocks(m_superblock.name_index_start + first_block, run, staging.data())) {
+            LOG_ERROR("mount: failed to read name index blocks from " << m_superblock.name_index_start + first_block);
             return false;
         }
+        for (int b = 0; b < run; ++b) {
+            const int first = (first_block + b) * records_per_block;
+            const int count = std::max(0, std::min(records_per_block, m_max_inodes - first));
+            std::memcpy(records.data() + first, staging.data() + static_cast<size_t>(b) * block_size, count * sizeof(NameRecord));
+        }
     }
+
+    m_name_index.rebuild_postings();
     return true;
 }
 
 bool FileSystem::write_inode_table_to_disk() {
-    const int block_size = m_disk.block_size();
+    if (m_batch_depth > 0) {
+        m_inode_table_dirty = true;
+        return true;
+    }
+
     const int inode_table_bytes = m_max_inodes * static_cast<int>(sizeof(Inode));
     const int inode_table_blocks = m_superblock.inode_table_blocks;
 
-    std::vector<char> buffer(inode_table_blocks * block_size, 0);
-    std::memcpy(buffer.data(), m_inode_table.data(), inode_table_bytes);
+    return write_table_blocks(m_superblock.inode_table_start, inode_table_blocks, m_inode_table.data(), inode_table_bytes, "inode table");
+}
+
+
+bool FileSystem::write_table_blocks(int first_block, int block_count, const void* data, size_t bytes, const char* what) {
+    const size_t block_size = static_cast<size_t>(m_disk.block_size());
+    const char* source = static_cast<const char*>(data);
+
+    // Whole blocks go straight from the table in one write; only the partial last block and any
+    // blocks past the data are staged, one pooled block at a time
+    const int whole_blocks = static_cast<int>(std::min<size_t>(block_count, bytes / block_size));
+    if (whole_blocks > 0 && !m_disk.write_blocks(first_block, whole_blocks, source)) {
+        LOG_ERROR("Failed to write " << what << " blocks " << first_block << "-" << first_block + whole_blocks - 1);
+        return false;
+    }
+
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire_uninitialized();
+    for (int i = whole_blocks; i < block_count; ++i) {
+        const size_t offset = static_cast<size_t>(i) * block_size;
+        const size_t take = offset < bytes ? std::min(block_size, bytes - offset) : 0;
+        std::memcpy(buffer.data(), source + offset, take);
+        std::memset(buffer.data() + take, 0, block_size - take);
 
-    for (int i = 0; i < inode_table_blocks; ++i) {
-        int block_number = m_superblock.inode_table_start + i;
-        if (!m_disk.write_block(block_number, buffer.data() + i * block_size)) {
-            std::cerr << "Failed to write inode table block " << block_number << "\n";
+        if (!m_disk.write_block(first_block + i, buffer.data())) {
+            LOG_ERROR("Failed to write " << what << " block " << first_block + i);
             return false;
         }
     }
     return true;
 }
 
+bool FileSystem::read_table_blocks(int first_block, int block_count, void* data, size_t bytes, const char* what) {
+    const size_t block_size = static_cast<size_t>(m_disk.block_size());
+    char* target = static_cast<char*>(data);
+
+    const int whole_blocks = static_cast<int>(std::min<size_t>(block_count, bytes / block_size));
+    if (whole_blocks > 0 && !m_disk.read_blocks(first_block, whole_blocks, target)) {
+        LOG_ERROR("mount: failed to read " << what << " blocks " << first_block << "-" << first_block + whole_blocks - 1);
+        return false;
+    }
+
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire_uninitialized();
+    for (int i = whole_blocks; i < block_count; ++i) {
+        const size_t offset = static_cast<size_t>(i) * block_size;
+        if (offset >= bytes) {
+            break;
+        }
+        if (!m_disk.read_block(first_block + i, buffer.data())) {
+            LOG_ERROR("mount: failed to read " << what << " block " << first_block + i);
+            return false;
+        }
+        std::memcpy(target + offset, buffer.data(), std::min(block_size, bytes - offset));
+    }
+    return true;
+}
 
 int FileSystem::allocate_block() {
+    OpTimer timer(m_stats, Op::ALLOCATE_BLOCK);
     const int total_blocks = m_disk.number_of_blocks();
+    const int bitmap_bytes = std::min(static_cast<int>(m_free_bitmap.size()), (total_blocks + 7) / 8);
 
-    for (int block = 0; block < total_blocks; ++block) {
-        int byte_index = block / 8;
-        int bit_index  = block % 8;
+    for (int byte_index = m_next_free_block / 8; byte_index < bitmap_bytes; ++byte_index) {
+        // A zero byte is eight used blocks
+        if (m_free_bitmap[byte_index] == 0) {
+            continue;
+        }
 
-        if (byte_index >= static_cast<int>(m_free_bitmap.size()))
-            break;
+        for (int bit_index = 0; bit_index < 8; ++bit_index) {
+            const int block = byte_index * 8 + bit_index;
+            uint8_t mask = static_cast<uint8_t>(1u << bit_index);
+            if (block >= total_blocks) {
+                break;
+            }
+            if (m_free_bitmap[byte_index] & mask) {
+                m_free_bitmap[byte_index] &= ~mask;
+                m_next_free_block = block + 1;
+
+                if (!write_free_bitmap_to_disk()) {
+                    LOG_ERROR("Failed to persist free bitmap after allocating block");
+                    return -1;
+                }
+                return block;
+            }
+        }
+    }
+    m_next_free_block = total_blocks;
+    LOG_ERROR("No free blocks available");
+    return -1;
+}
 
-        uint8_t mask = static_cast<uint8_t>(1u << bit_index);
-        if (m_free_bitmap[byte_index] & mask) {
-            m_free_bitmap[byte_index] &= ~mask;
+int FileSystem::allocate_extent(int block_count) {
+    OpTimer timer(m_stats, Op::ALLOCATE_BLOCK);
+    const int total_blocks = std::min(m_disk.number_of_blocks(), static_cast<int>(m_free_bitmap.size()) * 8);
+
+    int first_free = -1;
+    int run_start = -1;
+    int run = 0;
+    for (int block = m_next_free_block; block < total_blocks && block_count > 0; ++block) {
+        // Eight used blocks at once while not inside a run
+        if (run == 0 && block % 8 == 0 && m_free_bitmap[block / 8] == 0) {
+            block += 7;
+            continue;
+        }
 
-            if (!write_free_bitmap_to_disk()) {
-                std::cerr << "Failed to persist free bitmap after allocating block\n";
-                return -1;
-            }
-            return block;
+        if (!(m_free_bitmap[block / 8] & (1u << (block % 8)))) {
+            run = 0;
+            continue;
+        }
+        if (first_free < 0) {
+            first_free = block;
+        }
+        if (run++ == 0) {
+            run_start = block;
+        }
+        if (run < block_count) {
+            continue;
+        }
+
+        for (int b = run_start; b < run_start + block_count; ++b) {
+            m_free_bitmap[b / 8] &= static_cast<uint8_t>(~(1u << (b % 8)));
+        }
+        // Free blocks before the run stay below the hint
+        if (first_free == run_start) {
+            m_next_free_block = run_start + block_count;
         }
+
+        if (!write_free_bitmap_to_disk()) {
+            LOG_ERROR("Failed to persist free bitmap after allocating extent");
+            return -1;
+        }
+        return run_start;
     }
-    std::cerr << "No free blocks available\n";
+    LOG_DEBUG("No run of " << block_count << " free blocks");
     return -1;
 }
 
 int FileSystem::allocate_inode() {
-    for (int i = 0; i < m_max_inodes; ++i) {
+    // Inodes are never freed, so nothing below the last one handed out can be unused
+    for (int i = m_next_free_inode; i < m_max_inodes; ++i) {
         if (m_inode_table[i].type == InodeType::UNUSED) {
+            m_next_free_inode = i + 1;
             return i;
         }
     }
-    std::cerr << "No free inodes available\n";
+    LOG_ERROR("No free inodes available");
     return -1;
 }
 
 bool FileSystem::write_free_bitmap_to_disk() {
+    if (m_batch_depth > 0) {
+        m_free_bitmap_dirty = true;
+        return true;
+    }
+
+    return write_table_blocks(m_superblock.free_bitmap_start, m_superblock.free_bitmap_blocks, m_free_bitmap.data(), m_free_bitmap.size(), "free-space bitmap");
+}
+
+bool FileSystem::write_name_record_to_disk(int inode_index) {
+    if (m_superblock.name_index_blocks <= 0) {
+        return true;
+    }
+
     const int block_size = m_disk.block_size();
-    const int bitmap_blocks = m_superblock.free_bitmap_blocks;
+    const int records_per_block = block_size / static_cast<int>(sizeof(NameRecord));
+    if (m_batch_depth > 0) {
+        m_dirty_name_blocks.insert(inode_index / records_per_block);
+        return true;
+    }
 
-    for (int i = 0; i < bitmap_blocks; ++i) {
-        int block_number = m_superblock.free_bitmap_start + i;
-        if (!m_disk.write_block(block_number, reinterpret_cast<const char*>(m_free_bitmap.data()) + i * block_size)) {
-            std::cerr << "Failed to write free-space bitmap block " << block_number << "\n";
-            return false;
-        }
+    // Only the block holding this record is rewritten
+    const int first = (inode_index / records_per_block) * records_per_block;
+    const int count = std::min(records_per_block, m_max_inodes - first);
+
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
+    std::memcpy(buffer.data(), m_name_index.records().data() + first, count * sizeof(NameRecord));
+
+    int block_number = m_superblock.name_index_start + inode_index / records_per_block;
+    if (!m_disk.write_block(block_number, buffer.data())) {
+        LOG_ERROR("Failed to write name index block " << block_number);
+        return false;
     }
     return true;
 }
 
+bool FileSystem::index_name(int inode_index, int parent_inode, std::string_view name) {
+    m_name_index.insert(inode_index, parent_inode, name);
+    return write_name_record_to_disk(inode_index);
+}
 
-bool FileSystem::add_directory_entry(int directory_inode_index, int inode_index, const std::string& name) {
+void FileSystem::track_usage(int inode_index, int64_t bytes, int files) {
+    // Before the first build there is nothing to keep current; the build will count this change
+    if (m_usage_index.ready()) {
+        m_usage_index.add(inode_index, m_name_index, bytes, files);
+    }
+}
+
+void FileSystem::build_usage_index() {
+    m_usage_index.reset(m_max_inodes);
+    for (int i = 0; i < m_max_inodes; ++i) {
+        if (m_inode_table[i].type == InodeType::FILE && m_name_index.contains(i)) {
+            m_usage_index.add(i, m_name_index, m_inode_table[i].size, 1);
+        }
+    }
+    m_usage_index.mark_ready();
+}
+
+bool FileSystem::add_directory_entry(int directory_inode_index, int inode_index, std::string_view name) {
     // Out of bounds check
     if (directory_inode_index < 0 || directory_inode_index >= m_max_inodes) {
-        std::cerr << "add_dir_entry: invalid dir inode index\n";
+        LOG_ERROR("add_dir_entry: invalid dir inode index");
         return false;
     }
     // Check if Inode index belongs to directory
     Inode& directory_inode = m_inode_table[directory_inode_index];
     if (directory_inode.type != InodeType::DIRECTORY) {
-        std::cerr << "add_dir_entry: inode is not a directory\n";
+        LOG_ERROR("add_dir_entry: inode is not a directory");
         return false;
     }
 
     const int block_size = m_disk.block_size();
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
     
     // Gets block of directory
     if (!m_disk.read_block(directory_inode.index_block, buffer.data())) {
-        std::cerr << "add_dir_entry: failed to read directory block\n";
+        LOG_ERROR("add_dir_entry: failed to read directory block");
         return false;
     }
 
@@ -319,7 +552,7 @@ bool FileSystem::add_directory_entry(int directory_inode_index, int inode_index,
     }
 
     if (free_slot == -1) {
-        std::cerr << "Directory is full (single-block directory)\n";
+        LOG_ERROR("Directory is full (single-block directory)");
         return false;
     }
     
@@ -327,10 +560,10 @@ bool FileSystem::add_directory_entry(int directory_inode_index, int inode_index,
     DirectoryEntry& e = entries[free_slot];
     e.inode_index = inode_index;
     std::memset(e.name, 0, sizeof(e.name));
-    std::strncpy(e.name, name.c_str(), sizeof(e.name) - 1);
+    std::memcpy(e.name, name.data(), std::min(name.size(), sizeof(e.name) - 1));
 
     if (!m_disk.write_block(directory_inode.index_block, buffer.data())) {
-        std::cerr << "add_dir_entry: failed to write directory block\n";
+        LOG_ERROR("add_dir_entry: failed to write directory block");
         return false;
     }
 
@@ -338,7 +571,7 @@ bool FileSystem::add_directory_entry(int directory_inode_index, int inode_index,
     return true;
 }
 
-int FileSystem::find_directory_entry(int directory_inode_index, const std::string& name) {
+int FileSystem::find_directory_entry(int directory_inode_index, std::string_view name) {
     if (directory_inode_index < 0 || directory_inode_index>= m_max_inodes) {
         return -1;
     }
@@ -349,10 +582,10 @@ int FileSystem::find_directory_entry(int directory_inode_index, const std::strin
     }
 
     const int block_size = m_disk.block_size();
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
 
     if (!m_disk.read_block(dir_inode.index_block, buffer.data())) {
-        std::cerr << "find_dir_entry: failed to read directory block\n";
+        LOG_ERROR("find_dir_entry: failed to read directory block");
         return -1;
     }
 
@@ -361,7 +594,8 @@ int FileSystem::find_directory_entry(int directory_inode_index, const std::strin
 
     for (int i = 0; i < max_entries; ++i) {
         if (entries[i].inode_index != -1) {
-            if (std::strncmp(entries[i].name, name.c_str(), sizeof(entries[i].name)) == 0) {
+            const size_t length = strnlen(entries[i].name, sizeof(entries[i].name));
+            if (length == name.size() && std::memcmp(entries[i].name, name.data(), length) == 0) {
                 return entries[i].inode_index;
             }
         }
@@ -370,99 +604,246 @@ int FileSystem::find_directory_entry(int directory_inode_index, const std::strin
     return -1; // not found
 }
 
-std::vector<std::string> FileSystem::split_path(const std::string& path) {
-    std::vector<std::string> parts;
-    std::string current;
-
-    for (char c : path) {
-        if (c == '/') {
-            if (!current.empty()) {
-                parts.push_back(current);
-                current.clear();
-            }
-        } else {
-            current.push_back(c);
-        }
-    }
-    if (!current.empty()) {
-        parts.push_back(current);
-    }
-    return parts;
+int FileSystem::resolve_path(std::string_view path) {
+    OpTimer timer(m_stats, Op::RESOLVE_PATH);
+    return walk_path(path);
 }
 
-int FileSystem::resolve_path(const std::string& path) {
-    auto parts = split_path(path);
-
+int FileSystem::walk_path(std::string_view path) {
     // "/" or "" is root
     int current_inode = m_superblock.root_inode_index;
-    if (parts.empty()) {
-        std::cout << "CURRNET INODE IS ROOT\n";
-        return current_inode;
-    }
-
-    for (size_t i = 0; i < parts.size(); ++i) {
-        const std::string& name = parts[i];
 
+    PathCursor cursor(path);
+    std::string_view name;
+    while (cursor.next(name)) {
         int next_inode = find_directory_entry(current_inode, name);
         if (next_inode < 0) {
             return -1; // not found
         }
 
         // For intermediate components, must be directory
-        if (i + 1 < parts.size()) {
-            if (m_inode_table[next_inode].type != InodeType::DIRECTORY) {
-                return -1; // cannot traverse through a file
-            }
+        if (!cursor.done() && m_inode_table[next_inode].type != InodeType::DIRECTORY) {
+            return -1; // cannot traverse through a file
         }
         current_inode = next_inode;
     }
     return current_inode;
 }
 
-int FileSystem::resolve_parent_directory(const std::string& path, std::string& leaf) {
-    auto parts = split_path(path);
-    if (parts.empty()) {
+int FileSystem::resolve_parent_directory(std::string_view path, std::string_view& leaf) {
+    std::string_view parent;
+    split_leaf(path, parent, leaf);
+    if (leaf.empty()) {
         // no component -> no parent (invalid for mkdir/create_file)
         return -1;
     }
+    if (leaf == "." || leaf == "..") {
+        return -1; // would shadow the path syntax and escape the root on export
+    }
 
-    leaf = parts.back();
-    parts.pop_back(); // remaining are the parent path components
+    int parent_inode = walk_path(parent);
+    if (parent_inode < 0 || m_inode_table[parent_inode].type != InodeType::DIRECTORY) {
+        return -1; // parent missing or not a directory
+    }
+    return parent_inode;
+}
 
-    int current_inode = m_superblock.root_inode_index;
+void FileSystem::begin_batch() {
+    ++m_batch_depth;
+}
 
-    if (parts.empty()) {
-        // parent is root, leaf is just the name
-        return current_inode;
+bool FileSystem::commit_batch() {
+    if (m_batch_depth <= 0) {
+        LOG_ERROR("commit_batch: no batch in progress");
+        return false;
+    }
+    if (--m_batch_depth > 0) {
+        return true;
     }
 
-    for (const auto& name : parts) {
-        int next_inode = find_directory_entry(current_inode, name);
-        if (next_inode < 0) {
-            return -1; // parent component not found
+    bool ok = true;
+    if (m_inode_table_dirty) {
+        ok = write_inode_table_to_disk() && ok;
+        m_inode_table_dirty = false;
+    }
+    if (m_free_bitmap_dirty) {
+        ok = write_free_bitmap_to_disk() && ok;
+        m_free_bitmap_dirty = false;
+    }
+
+    const int records_per_block = m_disk.block_size() / static_cast<int>(sizeof(NameRecord));
+    std::vector<int> name_blocks(m_dirty_name_blocks.begin(), m_dirty_name_blocks.end());
+    std::sort(name_blocks.begin(), name_blocks.end());
+    for (int block : name_blocks) {
+        ok = write_name_record_to_disk(block * records_per_block) && ok;
+    }
+    m_dirty_name_blocks.clear();
+
+    if (!ok) {
+        LOG_ERROR("commit_batch: failed to write metadata");
+    }
+    return ok;
+}
+
+int FileSystem::create_files_contiguous(const std::vector<ImportFile>& files) {
+    const auto start = std::chrono::steady_clock::now();
+    const int block_size = m_disk.block_size();
+    const int max_entries = block_size / static_cast<int>(sizeof(int));
+
+    // Where each file lands, relative to the start of the extent; parent -1 for files that are skipped
+    struct Placement {
+        int parent{-1};
+        std::string_view leaf{};
+        int first{};
+        int data_blocks{};
+    };
+    std::vector<Placement> placements(files.size());
+    int total_blocks = 0;
+    int planned = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const ImportFile& file = files[i];
+        Placement& placement = placements[i];
+        if (static_cast<int64_t>(file.data.size()) > max_file_size()) {
+            LOG_ERROR("create_files_contiguous: " << file.path << " is larger than " << max_file_size() << " bytes");
+            continue;
         }
-        if (m_inode_table[next_inode].type != InodeType::DIRECTORY) {
-            return -1; // not a directory in the path
+        placement.parent = resolve_parent_directory(file.path, placement.leaf);
+        if (placement.parent < 0 || find_directory_entry(placement.parent, placement.leaf) != -1) {
+            LOG_ERROR("create_files_contiguous: cannot create " << file.path);
+            placement.parent = -1;
+            continue;
         }
-        current_inode = next_inode;
+        placement.first = total_blocks;
+        placement.data_blocks = static_cast<int>((file.data.size() + block_size - 1) / block_size);
+        total_blocks += 1 + placement.data_blocks;
+        ++planned;
+    }
+    if (total_blocks == 0) {
+        return 0;
+    }
+
+    const int extent = allocate_extent(total_blocks);
+    if (extent < 0) {
+        // Too fragmented for one run, place the files one block at a time
+        int created = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (placements[i].parent < 0 || !create_file(files[i].path)) {
+                continue;
+            }
+            const int fd = open_file(files[i].path);
+            if (fd >= 0 && write_file(fd, files[i].data)) {
+                ++created;
+            }
+            close_file(fd);
+        }
+        return created;
     }
 
-    return current_inode;
-}
+    std::vector<char> staging(static_cast<size_t>(total_blocks) * block_size);
+    for (size_t i = 0; i < files.size(); ++i) {
+        const Placement& placement = placements[i];
+        if (placement.parent < 0) {
+            continue;
+        }
 
+        int* entries = reinterpret_cast<int*>(staging.data() + static_cast<size_t>(placement.first) * block_size);
+        for (int e = 0; e < max_entries; ++e) {
+            entries[e] = e < placement.data_blocks ? extent + placement.first + 1 + e : -1;
+        }
+        std::memcpy(staging.data() + static_cast<size_t>(placement.first + 1) * block_size, files[i].data.data(), files[i].data.size());
+    }
+
+    auto release = [&](const Placement& placement) {
+        for (int b = 0; b <= placement.data_blocks; ++b) {
+            mark_block_free(extent + placement.first + b);
+        }
+    };
+
+    if (!m_disk.write_blocks(extent, total_blocks, staging.data())) {
+        LOG_ERROR("create_files_contiguous: failed to write extent at block " << extent);
+        for (const Placement& placement : placements) {
+            if (placement.parent >= 0) {
+                release(placement);
+            }
+        }
+        write_free_bitmap_to_disk();
+        return 0;
+    }
+
+    // Each file is timed and traced as one create, charged an even share of planning and writing the
+    // extent plus its own linking; a replay creates and writes it like the fallback above would
+    const std::chrono::nanoseconds shared = (std::chrono::steady_clock::now() - start) / planned;
+    auto account = [&](const ImportFile& file, std::chrono::steady_clock::time_point link_start) {
+        const std::chrono::nanoseconds elapsed = shared + (std::chrono::steady_clock::now() - link_start);
+        m_stats.record(Op::CREATE_FILE, elapsed);
+        if (m_trace) {
+            const uint64_t duration_ns = static_cast<uint64_t>(elapsed.count());
+            const uint64_t now_ns = m_trace->now_ns();
+            m_trace->record({TraceOp::IMPORT_FILE, now_ns - std::min(now_ns, duration_ns), duration_ns, -1, 0,
+                             static_cast<int64_t>(file.data.size()), file.path});
+        }
+    };
+
+    // Data is on disk before anything points at it
+    int created = 0;
+    bool released = false;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const Placement& placement = placements[i];
+        if (placement.parent < 0) {
+            continue;
+        }
+
+        const auto link_start = std::chrono::steady_clock::now();
+        const int inode_index = allocate_inode();
+        // Checked again: the same name may appear twice in one call
+        if (inode_index < 0 || find_directory_entry(placement.parent, placement.leaf) != -1 ||
+            !add_directory_entry(placement.parent, inode_index, placement.leaf)) {
+            LOG_ERROR("create_files_contiguous: cannot link " << files[i].path);
+            if (inode_index >= 0) {
+                m_next_free_inode = std::min(m_next_free_inode, inode_index);
+            }
+            release(placement);
+            released = true;
+            account(files[i], link_start);
+            continue;
+        }
 
+        Inode& inode = m_inode_table[inode_index];
+        inode.type = InodeType::FILE;
+        inode.index_block = extent + placement.first;
+        inode.size = static_cast<int>(files[i].data.size());
 
-bool FileSystem::create_directory(const std::string& path) {
-    std::string leaf;
+        if (!index_name(inode_index, placement.parent, placement.leaf)) {
+            LOG_ERROR("create_files_contiguous: failed to persist name index");
+        }
+        track_usage(inode_index, inode.size, 1);
+        account(files[i], link_start);
+        ++created;
+    }
+
+    if (!write_inode_table_to_disk() || (released && !write_free_bitmap_to_disk())) {
+        LOG_ERROR("create_files_contiguous: failed to persist metadata");
+        return -1;
+    }
+    return created;
+}
+
+int FileSystem::lookup(std::string_view path) {
+    return walk_path(path);
+}
+
+bool FileSystem::create_directory(std::string_view path) {
+    TraceScope trace(m_trace, TraceOp::CREATE_DIRECTORY, path);
+    std::string_view leaf;
     int parent_inode = resolve_parent_directory(path, leaf);
     if (parent_inode < 0) {
-        std::cerr << "mkdir: parent directory does not exist for path " << path << "\n";
+        LOG_ERROR("mkdir: parent directory does not exist for path " << path);
         return false;
     }
 
     // Prevent duplicates
     if (find_directory_entry(parent_inode, leaf) != -1) {
-        std::cerr << "mkdir: entry already exists: " << leaf << "\n";
+        LOG_ERROR("mkdir: entry already exists: " << leaf);
         return false;
     }
 
@@ -473,7 +854,7 @@ bool FileSystem::create_directory(const std::string& path) {
 
     int block = allocate_block();
     if (block < 0) {
-        std::cerr << "mkdir: failed to allocate data block\n";
+        LOG_ERROR("mkdir: failed to allocate data block");
         return false;
     }
 
@@ -485,7 +866,7 @@ bool FileSystem::create_directory(const std::string& path) {
 
     // Initialize its directory block
     const int block_size = m_disk.block_size();
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
     DirectoryEntry* entries = reinterpret_cast<DirectoryEntry*>(buffer.data());
     int max_entries = block_size / static_cast<int>(sizeof(DirectoryEntry));
     for (int i = 0; i < max_entries; ++i) {
@@ -494,34 +875,41 @@ bool FileSystem::create_directory(const std::string& path) {
     }
 
     if (!m_disk.write_block(block, buffer.data())) {
-        std::cerr << "mkdir: failed to write directory block\n";
+        LOG_ERROR("mkdir: failed to write directory block");
         return false;
     }
 
     if (!write_inode_table_to_disk()) {
-        std::cerr << "mkdir: failed to persist inode table\n";
+        LOG_ERROR("mkdir: failed to persist inode table");
         return false;
     }
 
     if (!add_directory_entry(parent_inode, inode_index, leaf)) {
-        std::cerr << "mkdir: failed to add dir entry to parent\n";
+        LOG_ERROR("mkdir: failed to add dir entry to parent");
+        return false;
+    }
+
+    if (!index_name(inode_index, parent_inode, leaf)) {
+        LOG_ERROR("mkdir: failed to persist name index");
         return false;
     }
 
     return true;
 }
 
-bool FileSystem::create_file(const std::string& path) {
-    std::string leaf;
+bool FileSystem::create_file(std::string_view path) {
+    TraceScope trace(m_trace, TraceOp::CREATE_FILE, path);
+    OpTimer timer(m_stats, Op::CREATE_FILE);
+    std::string_view leaf;
     int parent_inode = resolve_parent_directory(path, leaf);
     if (parent_inode < 0) {
-        std::cerr << "create_file: parent directory does not exist for path " << path << "\n";
+        LOG_ERROR("create_file: parent directory does not exist for path " << path);
         return false;
     }
 
     // File/dir already exists?
     if (find_directory_entry(parent_inode, leaf) != -1) {
-        std::cerr << "create_file: entry already exists: " << leaf << "\n";
+        LOG_ERROR("create_file: entry already exists: " << leaf);
         return false;
     }
 
@@ -532,7 +920,7 @@ bool FileSystem::create_file(const std::string& path) {
 
     int index_block = allocate_block();
     if (index_block < 0) {
-        std::cerr << "create_file: failed to allocate index block\n";
+        LOG_ERROR("create_file: failed to allocate index block");
         return false;
     }
 
@@ -543,57 +931,66 @@ bool FileSystem::create_file(const std::string& path) {
 
     // Initialize index block: all entries = -1
     const int block_size = m_disk.block_size();
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
     int* entries = reinterpret_cast<int*>(buffer.data());
     int max_entries = block_size / static_cast<int>(sizeof(int));
     for (int i = 0; i < max_entries; ++i) {
         entries[i] = -1;
     }
     if (!m_disk.write_block(index_block, buffer.data())) {
-        std::cerr << "create_file: failed to write index block\n";
+        LOG_ERROR("create_file: failed to write index block");
         return false;
     }
 
     if (!write_inode_table_to_disk()) {
-        std::cerr << "create_file: failed to persist inode table\n";
+        LOG_ERROR("create_file: failed to persist inode table");
         return false;
     }
 
     if (!add_directory_entry(parent_inode, inode_index, leaf)) {
-        std::cerr << "create_file: failed to add dir entry to parent\n";
+        LOG_ERROR("create_file: failed to add dir entry to parent");
         return false;
     }
 
+    if (!index_name(inode_index, parent_inode, leaf)) {
+        LOG_ERROR("create_file: failed to persist name index");
+        return false;
+    }
+    track_usage(inode_index, 0, 1);
+
     return true;
 }
 
 bool FileSystem::write_file(int file_index, const std::string& data) {
+    TraceScope trace(m_trace, TraceOp::WRITE_FILE, {}, file_index, 0, static_cast<int64_t>(data.size()));
+    OpTimer timer(m_stats, Op::WRITE_FILE);
     if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size())) {
-        std:: cerr <<"out of bounds file index\n";
+        LOG_ERROR("out of bounds file index");
+        return false;
     }
 
     OpenFileEntry& entry {m_open_files[file_index]};
     if (!entry.in_use) {
-        std::cerr << "file not open\n";
+        LOG_ERROR("file not open");
         return false;
     }
 
     Inode& inode = m_inode_table[entry.inode_index];
     if (inode.type != InodeType::FILE) {
-        std::cerr << "write_file: not a regular file:\n";
+        LOG_ERROR("write_file: not a regular file:");
         return false;
     }
 
     if (inode.index_block < 0) {
-        std::cerr << "write_file: inode has no index block\n";
+        LOG_ERROR("write_file: inode has no index block");
         return false;
     }
 
     const int block_size = m_disk.block_size();
 
-    std::vector<char> idx_buf(block_size, 0);
+    BlockPool::Buffer idx_buf = m_disk.block_pool().acquire();
     if (!m_disk.read_block(inode.index_block, idx_buf.data())) {
-        std::cerr << "write_file: failed to read index block\n";
+        LOG_ERROR("write_file: failed to read index block");
         return false;
     }
 
@@ -603,7 +1000,7 @@ bool FileSystem::write_file(int file_index, const std::string& data) {
     int data_len = static_cast<int>(data.size());
     int max_bytes = static_cast<int>(max_entries) * block_size;
     if (data_len > max_bytes) {
-        std::cerr << "write_file: data too large, truncating to " << max_bytes << " bytes\n";
+        LOG_ERROR("write_file: data too large, truncating to " << max_bytes << " bytes");
         data_len = max_bytes;
     }
 
@@ -614,7 +1011,7 @@ bool FileSystem::write_file(int file_index, const std::string& data) {
         if (entries[i] == -1) {
             int new_block = allocate_block();
             if (new_block < 0) {
-                std::cerr << "write_file: out of blocks\n";
+                LOG_ERROR("write_file: out of blocks");
                 return false;
             }
             entries[i] = new_block;
@@ -622,14 +1019,14 @@ bool FileSystem::write_file(int file_index, const std::string& data) {
 
         int block_number = entries[i];
 
-        std::vector<char> data_buf(block_size, 0);
+        BlockPool::Buffer data_buf = m_disk.block_pool().acquire();
         int64_t remaining = data_len - offset;
         int bytes_this_block = static_cast<int>(std::min<int64_t>(remaining, block_size));
 
         std::memcpy(data_buf.data(), data.data() + offset, bytes_this_block);
 
         if (!m_disk.write_block(block_number, data_buf.data())) {
-            std::cerr << "write_file: disk write failed\n";
+            LOG_ERROR("write_file: disk write failed");
             return false;
         }
         offset += bytes_this_block;
@@ -638,48 +1035,196 @@ bool FileSystem::write_file(int file_index, const std::string& data) {
 
     // Write updated index block back
     if (!m_disk.write_block(inode.index_block, idx_buf.data())) {
-        std::cerr << "write_file: failed to write index block\n";
+        LOG_ERROR("write_file: failed to write index block");
         return false;
     }
 
+    track_usage(entry.inode_index, static_cast<int64_t>(data_len) - inode.size, 0);
     inode.size = static_cast<int>(data_len);
 
     if (!write_inode_table_to_disk()) {
-        std::cerr << "write_file: failed to persist inode table\n";
+        LOG_ERROR("write_file: failed to persist inode table");
+        return false;
+    }
+
+    return true;
+}
+
+bool FileSystem::write_file_range(int file_index, int offset, const std::string& data) {
+    TraceScope trace(m_trace, TraceOp::WRITE_FILE_RANGE, {}, file_index, offset, static_cast<int64_t>(data.size()));
+    OpTimer timer(m_stats, Op::WRITE_FILE);
+    if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size())) {
+        LOG_ERROR("write_file_range: out of bounds file index");
+        return false;
+    }
+
+    OpenFileEntry& entry {m_open_files[file_index]};
+    if (!entry.in_use) {
+        LOG_ERROR("write_file_range: file not open");
+        return false;
+    }
+
+    Inode& inode = m_inode_table[entry.inode_index];
+    if (inode.type != InodeType::FILE || inode.index_block < 0) {
+        LOG_ERROR("write_file_range: not a regular file");
+        return false;
+    }
+
+    // Blocks are linked in order with no holes, so a write may extend the file but not start past its end
+    if (offset < 0 || offset > inode.size) {
+        LOG_ERROR("write_file_range: offset " << offset << " outside file of " << inode.size << " bytes");
+        return false;
+    }
+
+    const int block_size = m_disk.block_size();
+    const int max_entries = block_size / static_cast<int>(sizeof(int));
+    const int64_t end = static_cast<int64_t>(offset) + data.size();
+    if (end > static_cast<int64_t>(max_entries) * block_size) {
+        LOG_ERROR("write_file_range: range ends past the largest file size");
+        return false;
+    }
+
+    BlockPool::Buffer idx_buf = m_disk.block_pool().acquire();
+    if (!m_disk.read_block(inode.index_block, idx_buf.data())) {
+        LOG_ERROR("write_file_range: failed to read index block");
+        return false;
+    }
+    int* entries = reinterpret_cast<int*>(idx_buf.data());
+
+    bool index_changed = false;
+    BlockPool::Buffer data_buf = m_disk.block_pool().acquire();
+    for (int i = offset / block_size; static_cast<int64_t>(i) * block_size < end; ++i) {
+        const int block_start = i * block_size;
+        const int from = std::max(offset, block_start) - block_start;
+        const int to = static_cast<int>(std::min<int64_t>(end, block_start + block_size)) - block_start;
+
+        // A block is read back only when the write leaves live bytes of it untouched
+        const bool keeps_old_bytes = from > 0 || (to < block_size && block_start + to < inode.size);
+        if (entries[i] == -1) {
+            int new_block = allocate_block();
+            if (new_block < 0) {
+                LOG_ERROR("write_file_range: out of blocks");
+                return false;
+            }
+            entries[i] = new_block;
+            index_changed = true;
+            std::fill(data_buf.begin(), data_buf.end(), 0);
+        } else if (keeps_old_bytes) {
+            if (!m_disk.read_block(entries[i], data_buf.data())) {
+                LOG_ERROR("write_file_range: disk read failed");
+                return false;
+            }
+        } else {
+            std::fill(data_buf.begin(), data_buf.end(), 0);
+        }
+
+        std::memcpy(data_buf.data() + from, data.data() + (block_start + from - offset), to - from);
+        if (!m_disk.write_block(entries[i], data_buf.data())) {
+            LOG_ERROR("write_file_range: disk write failed");
+            return false;
+        }
+    }
+
+    if (index_changed && !m_disk.write_block(inode.index_block, idx_buf.data())) {
+        LOG_ERROR("write_file_range: failed to write index block");
         return false;
     }
 
+    if (end > inode.size) {
+        track_usage(entry.inode_index, end - inode.size, 0);
+        inode.size = static_cast<int>(end);
+        if (!write_inode_table_to_disk()) {
+            LOG_ERROR("write_file_range: failed to persist inode table");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileSystem::truncate_file(int file_index, int size) {
+    TraceScope trace(m_trace, TraceOp::TRUNCATE_FILE, {}, file_index, 0, size);
+    if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size()) || !m_open_files[file_index].in_use) {
+        LOG_ERROR("truncate_file: file not open");
+        return false;
+    }
+
+    Inode& inode = m_inode_table[m_open_files[file_index].inode_index];
+    if (inode.type != InodeType::FILE || inode.index_block < 0) {
+        LOG_ERROR("truncate_file: not a regular file");
+        return false;
+    }
+
+    if (size < 0 || size > inode.size) {
+        LOG_ERROR("truncate_file: can only shrink, " << size << " > " << inode.size);
+        return false;
+    }
+
+    const int block_size = m_disk.block_size();
+    BlockPool::Buffer idx_buf = m_disk.block_pool().acquire();
+    if (!m_disk.read_block(inode.index_block, idx_buf.data())) {
+        LOG_ERROR("truncate_file: failed to read index block");
+        return false;
+    }
+    int* entries = reinterpret_cast<int*>(idx_buf.data());
+    const int max_entries = block_size / static_cast<int>(sizeof(int));
+
+    // Blocks wholly past the new end go back to the free bitmap
+    bool freed = false;
+    for (int i = (size + block_size - 1) / block_size; i < max_entries; ++i) {
+        if (entries[i] == -1)
+            break;
+        mark_block_free(entries[i]);
+        entries[i] = -1;
+        freed = true;
+    }
+
+    if (freed) {
+        if (!m_disk.write_block(inode.index_block, idx_buf.data()) || !write_free_bitmap_to_disk()) {
+            LOG_ERROR("truncate_file: failed to release blocks");
+            return false;
+        }
+    }
+
+    track_usage(m_open_files[file_index].inode_index, static_cast<int64_t>(size) - inode.size, 0);
+    inode.size = size;
+    if (!write_inode_table_to_disk()) {
+        LOG_ERROR("truncate_file: failed to persist inode table");
+        return false;
+    }
     return true;
 }
 
 bool FileSystem::read_file(int file_index, std::string& out) {
+    TraceScope trace(m_trace, TraceOp::READ_FILE, {}, file_index);
+    OpTimer timer(m_stats, Op::READ_FILE);
     if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size())) {
-        std:: cerr <<"out of bounds file index\n";
+        LOG_ERROR("out of bounds file index");
+        return false;
     }
 
     OpenFileEntry& entry {m_open_files[file_index]};
     if (!entry.in_use) {
-        std::cerr << "file not open\n";
+        LOG_ERROR("file not open");
         return false;
     }
 
     const Inode& inode = m_inode_table[entry.inode_index];
     if (inode.type != InodeType::FILE) {
-        std::cerr << "read_file: not a regular file\n";
+        LOG_ERROR("read_file: not a regular file");
         return false;
     }
 
     if (inode.index_block < 0) {
-        std::cerr << "read_file: inode has no index block\n";
+        LOG_ERROR("read_file: inode has no index block");
         return false;
     }
 
     const int block_size = m_disk.block_size();
 
     // Load index block
-    std::vector<char> idx_buf(block_size, 0);
+    BlockPool::Buffer idx_buf = m_disk.block_pool().acquire();
     if (!m_disk.read_block(inode.index_block, idx_buf.data())) {
-        std::cerr << "read_file: failed to read index block\n";
+        LOG_ERROR("read_file: failed to read index block");
         return false;
     }
 
@@ -694,9 +1239,9 @@ bool FileSystem::read_file(int file_index, std::string& out) {
         if (block_no == -1)
             break; // no more blocks
 
-        std::vector<char> data_buf(block_size, 0);
+        BlockPool::Buffer data_buf = m_disk.block_pool().acquire();
         if (!m_disk.read_block(block_no, data_buf.data())) {
-            std::cerr << "read_file: disk read failed\n";
+            LOG_ERROR("read_file: disk read failed");
             return false;
         }
 
@@ -707,16 +1252,92 @@ bool FileSystem::read_file(int file_index, std::string& out) {
     return true;
 }
 
-int FileSystem::open_file(const std::string& path) {
+bool FileSystem::read_file_range(int file_index, int offset, int length, std::string& out) {
+    TraceScope trace(m_trace, TraceOp::READ_FILE_RANGE, {}, file_index, offset, length);
+    OpTimer timer(m_stats, Op::READ_FILE);
+    out.clear();
+    if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size())) {
+        LOG_ERROR("read_file_range: out of bounds file index");
+        return false;
+    }
+
+    OpenFileEntry& entry {m_open_files[file_index]};
+    if (!entry.in_use) {
+        LOG_ERROR("read_file_range: file not open");
+        return false;
+    }
+
+    const Inode& inode = m_inode_table[entry.inode_index];
+    if (inode.type != InodeType::FILE || inode.index_block < 0) {
+        LOG_ERROR("read_file_range: not a regular file");
+        return false;
+    }
+
+    if (offset < 0 || length < 0) {
+        LOG_ERROR("read_file_range: negative range");
+        return false;
+    }
+
+    // Clamp to the file; reading at or past the end is not an error, it just yields nothing
+    const int end = static_cast<int>(std::min<int64_t>(inode.size, static_cast<int64_t>(offset) + length));
+    if (offset >= end) {
+        return true;
+    }
+
+    const int block_size = m_disk.block_size();
+
+    BlockPool::Buffer idx_buf = m_disk.block_pool().acquire();
+    if (!m_disk.read_block(inode.index_block, idx_buf.data())) {
+        LOG_ERROR("read_file_range: failed to read index block");
+        return false;
+    }
+    const int* entries = reinterpret_cast<const int*>(idx_buf.data());
+
+    // Only the blocks covering [offset, end) are read, straight into out and one disk read per run of
+    // consecutive block numbers. out starts block aligned; the partial head and tail are trimmed after.
+    const int first = offset / block_size;
+    const int last = (end - 1) / block_size;
+    const int aligned = first * block_size;
+    out.resize(static_cast<size_t>(last - first + 1) * block_size);
+
+    int i = first;
+    while (i <= last && entries[i] != -1) {
+        int run = 1;
+        while (i + run <= last && entries[i + run] == entries[i] + run)
+            ++run;
+
+        if (!m_disk.read_blocks(entries[i], run, out.data() + static_cast<size_t>(i - first) * block_size)) {
+            LOG_ERROR("read_file_range: disk read failed");
+            out.clear();
+            return false;
+        }
+        i += run;
+    }
+
+    out.resize(std::min<size_t>(static_cast<size_t>(i - first) * block_size, end - aligned));
+    out.erase(0, std::min<size_t>(out.size(), offset - aligned));
+    return true;
+}
+
+int FileSystem::file_size(int file_index) {
+    if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size()) || !m_open_files[file_index].in_use) {
+        LOG_ERROR("file_size: file not open");
+        return -1;
+    }
+    return m_inode_table[m_open_files[file_index].inode_index].size;
+}
+
+int FileSystem::open_file(std::string_view path) {
+    TraceScope trace(m_trace, TraceOp::OPEN_FILE, path);
     int inode_index = resolve_path(path);
     if (inode_index < 0) {
-        std::cerr << "open_file: path not found: " << path << "\n";
+        LOG_ERROR("open_file: path not found: " << path);
         return -1;
     } 
 
     Inode& inode = m_inode_table[inode_index];
     if (inode.type != InodeType::FILE) {
-        std::cerr << "open: not a regular file: " << path << "\n";
+        LOG_ERROR("open: not a regular file: " << path);
         return -1;
     }
     int file_index = -1;
@@ -737,17 +1358,19 @@ int FileSystem::open_file(const std::string& path) {
     entry.offset = 0;
     entry.in_use = true;
 
+    trace.set_handle(file_index);
     return file_index;
 }
 
 bool FileSystem::close_file(int file_index) {
+    TraceScope trace(m_trace, TraceOp::CLOSE_FILE, {}, file_index);
     if (file_index < 0 || file_index >= static_cast<int>(m_open_files.size())) {
-        std::cerr << "close: invalid fd\n";
+        LOG_ERROR("close: invalid fd");
         return false;
     }
     OpenFileEntry& entry = m_open_files[file_index];
     if (!entry.in_use) {
-        std::cerr << "close: fd not in use\n";
+        LOG_ERROR("close: fd not in use");
         return false;
     }
 
@@ -757,7 +1380,7 @@ bool FileSystem::close_file(int file_index) {
     return true;
 }
 
-void FileSystem::recursive_search(int directory_inode_index, const std::string& dir_path, const std::string& pattern, std::vector<std::string>& results) {
+void FileSystem::rebuild_name_index(int directory_inode_index) {
     if (directory_inode_index < 0 || directory_inode_index >= m_max_inodes) {
         return;
     } 
@@ -773,10 +1396,10 @@ void FileSystem::recursive_search(int directory_inode_index, const std::string&
     }
 
     const int block_size = m_disk.block_size();
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
 
     if (!m_disk.read_block(dir_block, buffer.data())) {
-        std::cerr << "search: failed to read directory block at " << dir_block << "\n";
+        LOG_ERROR("rebuild_name_index: failed to read directory block at " << dir_block);
         return;
     }
     
@@ -785,82 +1408,558 @@ void FileSystem::recursive_search(int directory_inode_index, const std::string&
     for (int i = 0; i < max_entries; ++i) {
         const DirectoryEntry& e = entries[i];
 
-        if (e.inode_index == -1) {
+        if (e.inode_index == -1 || e.name[0] == '\0') {
             continue; // unused slot
         }
 
-        // Build std::string from fixed-size char array
-        std::string name {e.name};
-        if (name.empty()) {
+        int child_inode_index = e.inode_index;
+        if (child_inode_index < 0 || child_inode_index >= m_max_inodes) {
             continue;
         }
 
-        int child_inode_index = e.inode_index;
-        if (child_inode_index < 0 || child_inode_index >= m_max_inodes) {
+        // Already indexed means the tree loops back on itself, don't follow it
+        if (child_inode_index == m_superblock.root_inode_index || m_name_index.contains(child_inode_index)) {
+            continue;
+        }
+
+        m_name_index.insert(child_inode_index, directory_inode_index, std::string(e.name, strnlen(e.name, sizeof(e.name))));
+
+        if (m_inode_table[child_inode_index].type == InodeType::DIRECTORY) {
+            rebuild_name_index(child_inode_index);
+        }
+    }
+}
+
+void SearchControl::cancel() {
+    m_cancelled.store(true, std::memory_order_relaxed);
+}
+
+void SearchControl::set_budget(std::chrono::milliseconds budget) {
+    m_deadline = std::chrono::steady_clock::now() + budget;
+}
+
+bool SearchControl::stopped() const {
+    if (m_cancelled.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    return m_deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= m_deadline;
+}
+
+std::unique_lock<std::mutex> SearchControl::lock() const {
+    return m_lock ? std::unique_lock<std::mutex>(*m_lock) : std::unique_lock<std::mutex>();
+}
+
+// Between two units of work of a search, lets whoever waits for its lock in
+static void yield_search_lock(std::unique_lock<std::mutex>& lock) {
+    if (lock.owns_lock()) {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+}
+
+std::vector<std::string> FileSystem::search(const std::string& pattern) {
+    std::vector<std::string> results;
+    SearchControl control;
+    search(pattern, [&](const std::string& path) { results.push_back(path); }, control);
+
+    std::sort(results.begin(), results.end());
+    return results;
+}
+
+SearchStatus FileSystem::search(const std::string& pattern, const PathCallback& on_result, const SearchControl& control) {
+    TraceScope trace(m_trace, TraceOp::SEARCH, pattern);
+    OpTimer timer(m_stats, Op::SEARCH);
+    std::unique_lock<std::mutex> lock = control.lock();
+    const std::vector<int> found = m_name_index.find_substring(pattern);
+    std::string path; // reused for every result, callers copy what they keep
+    for (size_t n = 0; n < found.size(); ++n) {
+        const int inode_index = found[n];
+        if (control.stopped()) {
+            return SearchStatus::STOPPED;
+        }
+        if (n > 0 && n % SEARCH_LOCK_STRIDE == 0) {
+            yield_search_lock(lock);
+        }
+
+        // A record can outlive its inode if a crash hit between the two writes
+        if (m_inode_table[inode_index].type == InodeType::UNUSED) {
+            continue;
+        }
+        m_name_index.path_of(inode_index, path);
+        on_result(path);
+    }
+    return SearchStatus::COMPLETE;
+}
+
+std::vector<std::string> FileSystem::all_paths() {
+    std::vector<std::string> paths;
+    for (int i = 0; i < m_name_index.size(); ++i) {
+        if (m_name_index.contains(i) && m_inode_table[i].type != InodeType::UNUSED) {
+            paths.push_back(m_name_index.path_of(i));
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool FileSystem::search_glob(const std::string& pattern, std::vector<std::string>& out) {
+    out.clear();
+    SearchControl control;
+    SearchStatus status = search_glob(pattern, [&](const std::string& path) { out.push_back(path); }, control);
+
+    std::sort(out.begin(), out.end());
+    return status != SearchStatus::INVALID_PATTERN;
+}
+
+SearchStatus FileSystem::search_glob(const std::string& pattern, const PathCallback& on_result, const SearchControl& control) {
+    TraceScope trace(m_trace, TraceOp::SEARCH_GLOB, pattern);
+    OpTimer timer(m_stats, Op::SEARCH);
+    GlobPattern glob;
+    if (!glob.compile(pattern)) {
+        LOG_ERROR("search_glob: invalid pattern: " << pattern);
+        return SearchStatus::INVALID_PATTERN;
+    }
+
+    if (glob.anchored()) {
+        GlobWalk walk{glob, on_result, control};
+        if (!glob_walk(walk, m_superblock.root_inode_index, 0, 0)) {
+            return SearchStatus::STOPPED;
+        }
+        return SearchStatus::COMPLETE;
+    }
+
+    // A bare name pattern can match at any depth; the name index answers it without touching the disk
+    const GlobSegment& segment = glob.segment(0);
+    std::unique_lock<std::mutex> lock = control.lock();
+    std::string path;
+    for (int i = 0; i < m_name_index.size(); ++i) {
+        if (control.stopped()) {
+            return SearchStatus::STOPPED;
+        }
+        if (i > 0 && i % SEARCH_LOCK_STRIDE == 0) {
+            yield_search_lock(lock);
+        }
+        if (!m_name_index.contains(i) || m_inode_table[i].type == InodeType::UNUSED) {
             continue;
         }
+        if (segment.matches(m_name_index.record(i).name)) {
+            m_name_index.path_of(i, path);
+            on_result(path);
+        }
+    }
+    return SearchStatus::COMPLETE;
+}
+
+bool FileSystem::glob_walk(GlobWalk& walk, int directory_inode_index, int segment_index, int depth) {
+    if (walk.control.stopped()) {
+        return false;
+    }
+    if (segment_index >= walk.glob.segment_count() || depth > m_max_inodes) {
+        return true;
+    }
 
-        const Inode& child_inode = m_inode_table[child_inode_index];
+    const GlobSegment& segment = walk.glob.segment(segment_index);
+    const bool last = segment_index + 1 == walk.glob.segment_count();
+    std::string& path = walk.path;
+    const size_t path_length = path.size();
 
-        // Build full path: handle root specially to avoid "//"
-        std::string child_path;
-        if (dir_path == "/") {
-            child_path = "/" + name;
+    // Several "**" can reach the same entry along different splits, report it once
+    auto emit = [&]() {
+        if (walk.seen.insert(path).second) {
+            walk.on_result(path);
+        }
+    };
+
+    // Literal components are looked up directly, sibling subtrees are never read
+    if (segment.kind == GlobSegmentKind::LITERAL) {
+        int child = -1;
+        {
+            std::unique_lock<std::mutex> lock = walk.control.lock();
+            if (is_directory_inode(directory_inode_index)) {
+                child = find_directory_entry(directory_inode_index, segment.text);
+            }
+        }
+        if (child < 0) {
+            return true;
+        }
+
+        path += "/";
+        path += segment.text;
+        bool ok = true;
+        if (last) {
+            emit();
         } else {
-            child_path = dir_path + "/" + name;
+            ok = glob_walk(walk, child, segment_index + 1, depth + 1);
+        }
+        path.resize(path_length);
+        return ok;
+    }
+
+    // "**" first tries matching zero directories, then descends one level and stays on the same segment
+    if (segment.kind == GlobSegmentKind::GLOBSTAR && !last) {
+        if (!glob_walk(walk, directory_inode_index, segment_index + 1, depth)) {
+            return false;
+        }
+    }
+
+    // The directory is read under the lock; matching and descending happen outside it
+    std::vector<DirectoryEntry> entries;
+    std::vector<bool> subdirectories;
+    {
+        std::unique_lock<std::mutex> lock = walk.control.lock();
+        if (!is_directory_inode(directory_inode_index) || !read_directory(directory_inode_index, entries)) {
+            return true;
+        }
+        for (const auto& e : entries) {
+            subdirectories.push_back(is_directory_inode(e.inode_index));
+        }
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const DirectoryEntry& e = entries[i];
+        std::string_view name(e.name, strnlen(e.name, sizeof(e.name)));
+        if (!segment.matches(name)) {
+            continue;
         }
 
-        if (name.find(pattern) != std::string::npos) {
-            results.push_back(child_path);
+        path += "/";
+        path += name;
+        if (last) {
+            emit();
         }
 
-        if (child_inode.type == InodeType::DIRECTORY) {
-            recursive_search(child_inode_index, child_path, pattern, results);
+        bool ok = true;
+        if (subdirectories[i]) {
+            if (segment.kind == GlobSegmentKind::GLOBSTAR) {
+                ok = glob_walk(walk, e.inode_index, segment_index, depth + 1);
+            } else if (!last) {
+                ok = glob_walk(walk, e.inode_index, segment_index + 1, depth + 1);
+            }
+        }
+        path.resize(path_length);
+        if (!ok) {
+            return false;
         }
     }
+    return true;
 }
 
-std::vector<std::string> FileSystem::search(const std::string& pattern) {
-    std::vector<std::string> results;
+bool FileSystem::search_regex(const std::string& pattern, std::vector<std::string>& out) {
+    out.clear();
+    SearchControl control;
+    SearchStatus status = search_regex(pattern, [&](const std::string& path) { out.push_back(path); }, control);
+
+    std::sort(out.begin(), out.end());
+    return status != SearchStatus::INVALID_PATTERN;
+}
+
+SearchStatus FileSystem::search_regex(const std::string& pattern, const PathCallback& on_result, const SearchControl& control) {
+    TraceScope trace(m_trace, TraceOp::SEARCH_REGEX, pattern);
+    OpTimer timer(m_stats, Op::SEARCH);
+    std::regex regex;
+    try {
+        regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+    } catch (const std::regex_error& e) {
+        LOG_ERROR("search_regex: invalid pattern: " << e.what());
+        return SearchStatus::INVALID_PATTERN;
+    }
+
+    // "^/docs/rea..." can only match under /docs, and there only entries whose name starts with "rea":
+    // that directory is looked up once and only its subtree is walked
+    const std::string prefix = regex_literal_prefix(pattern);
+    const size_t slash = prefix.rfind('/');
+    if (slash != std::string::npos) {
+        return walk_prefix(prefix, slash, [&](const std::string& path) {
+            if (std::regex_search(path, regex)) {
+                on_result(path);
+            }
+        }, control);
+    }
+
+    std::unique_lock<std::mutex> lock = control.lock();
+    std::string path;
+    for (int i = 0; i < m_name_index.size(); ++i) {
+        if (control.stopped()) {
+            return SearchStatus::STOPPED;
+        }
+        if (i > 0 && i % SEARCH_LOCK_STRIDE == 0) {
+            yield_search_lock(lock);
+        }
+        if (!m_name_index.contains(i) || m_inode_table[i].type == InodeType::UNUSED) {
+            continue;
+        }
+
+        m_name_index.path_of(i, path);
+        if (std::regex_search(path, regex)) {
+            on_result(path);
+        }
+    }
+    return SearchStatus::COMPLETE;
+}
+
+SearchStatus FileSystem::walk_prefix(const std::string& prefix, size_t slash, const PathCallback& on_path, const SearchControl& control) {
+    const std::string_view leaf = std::string_view(prefix).substr(slash + 1);
+
+    // Directories still to read, with their paths; each is read under the lock, on_path runs outside it
+    struct Pending {
+        int inode_index;
+        std::string path;
+        bool top;   // the prefix's directory, whose entries must also start with leaf
+    };
+    std::vector<Pending> pending;
+    {
+        std::unique_lock<std::mutex> lock = control.lock();
+        const int top = walk_path(std::string_view(prefix).substr(0, slash));
+        if (top < 0 || !is_directory_inode(top)) {
+            return SearchStatus::COMPLETE;
+        }
+        // path_of spells it the way every result is spelled, whatever the pattern did with "//" or "."
+        std::string path = top == m_superblock.root_inode_index ? "" : m_name_index.path_of(top);
+        pending.push_back({top, std::move(path), true});
+    }
+
+    std::vector<DirectoryEntry> entries;
+    std::vector<bool> subdirectories;
+    std::string path;
+    while (!pending.empty()) {
+        if (control.stopped()) {
+            return SearchStatus::STOPPED;
+        }
+        const Pending directory = std::move(pending.back());
+        pending.pop_back();
+
+        entries.clear();
+        subdirectories.clear();
+        {
+            std::unique_lock<std::mutex> lock = control.lock();
+            if (!read_directory(directory.inode_index, entries)) {
+                continue;
+            }
+            for (const auto& e : entries) {
+                subdirectories.push_back(is_directory_inode(e.inode_index));
+            }
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const DirectoryEntry& e = entries[i];
+            std::string_view name(e.name, strnlen(e.name, sizeof(e.name)));
+            if (directory.top && name.compare(0, leaf.size(), leaf) != 0) {
+                continue;
+            }
+
+            path = directory.path;
+            path += "/";
+            path += name;
+            // A prefix spelled differently from the stored path cannot match it
+            if (directory.top && path.compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+            on_path(path);
+            if (subdirectories[i] && pending.size() < static_cast<size_t>(m_max_inodes)) {
+                pending.push_back({e.inode_index, path, false});
+            }
+        }
+    }
+    return SearchStatus::COMPLETE;
+}
+
+bool FileSystem::scan_file_content(int inode_index, const std::string& needle, const SearchControl& control, std::vector<ContentMatch>& out) {
+    const Inode& inode = m_inode_table[inode_index];
+    if (inode.type != InodeType::FILE || inode.index_block < 0) {
+        return false;
+    }
+
+    const int block_size = m_disk.block_size();
+
+    BlockPool::Buffer idx_buf = m_disk.block_pool().acquire();
+    if (!m_disk.read_block(inode.index_block, idx_buf.data())) {
+        LOG_ERROR("search_content: failed to read index block");
+        return false;
+    }
+
+    const int* entries = reinterpret_cast<const int*>(idx_buf.data());
+    int max_entries = block_size / static_cast<int>(sizeof(int));
+
+    // The last needle_length - 1 bytes of each window are carried into the next one,
+    // so a match that straddles two blocks is still seen in one piece
+    const int carry_limit = static_cast<int>(needle.size()) - 1;
+    std::vector<char> window(carry_limit + block_size, 0);
+    int carry = 0;
+    int window_start = 0; // file offset of window[0]
+
+    // Line tracking runs up to cursor, which never enters the carried tail
+    int line = 1;
+    int line_start = 0;
+    int cursor = 0;
+
+    int64_t remaining = inode.size;
+    for (int i = 0; i < max_entries && remaining > 0; ++i) {
+        if (control.stopped()) {
+            return false;
+        }
+
+        int block_no = entries[i];
+        if (block_no == -1)
+            break;
+
+        if (!m_disk.read_block(block_no, window.data() + carry)) {
+            LOG_ERROR("search_content: disk read failed");
+            return false;
+        }
+
+        int bytes_this_block = static_cast<int>(std::min<int64_t>(remaining, block_size));
+        remaining -= bytes_this_block;
+        const int length = carry + bytes_this_block;
+
+        size_t from = 0;
+        while (true) {
+            size_t found = find_substring(window.data() + from, length - from, needle.data(), needle.size());
+            if (found == SUBSTRING_NOT_FOUND) {
+                break;
+            }
+            const int position = static_cast<int>(from + found);
+
+            for (; cursor < position; ++cursor) {
+                if (window[cursor] == '\n') {
+                    ++line;
+                    line_start = window_start + cursor + 1;
+                }
+            }
 
-    int root_inode = m_superblock.root_inode_index;
-    if (root_inode < 0 || root_inode >= m_max_inodes) {
-        std::cerr << "search: invalid root inode index\n";
-        return results;
+            ContentMatch match;
+            match.line = line;
+            match.column = window_start + position - line_start + 1;
+            match.offset = window_start + position;
+            out.push_back(std::move(match));
+
+            from = position + 1;
+        }
+
+        const int next_carry = std::min(carry_limit, length);
+        const int consumed = length - next_carry;
+        for (; cursor < consumed; ++cursor) {
+            if (window[cursor] == '\n') {
+                ++line;
+                line_start = window_start + cursor + 1;
+            }
+        }
+
+        std::memmove(window.data(), window.data() + consumed, next_carry);
+        window_start += consumed;
+        cursor = 0;
+        carry = next_carry;
     }
+    return true;
+}
 
-    recursive_search(root_inode, "/", pattern, results);
+std::vector<ContentMatch> FileSystem::search_content(const std::string& needle) {
+    std::vector<ContentMatch> results;
+    SearchControl control;
+    search_content(needle, [&](const ContentMatch& match) { results.push_back(match); }, control);
+
+    std::stable_sort(results.begin(), results.end(), [](const ContentMatch& a, const ContentMatch& b) {
+        return a.path < b.path;
+    });
     return results;
 }
 
-bool FileSystem::list_directory_entries(const std::string& path, std::vector<DirectoryEntry>& out) {
+SearchStatus FileSystem::search_content(const std::string& needle, const ContentCallback& on_match, const SearchControl& control) {
+    TraceScope trace(m_trace, TraceOp::SEARCH_CONTENT, needle);
+    OpTimer timer(m_stats, Op::SEARCH);
+    if (needle.empty()) {
+        return SearchStatus::COMPLETE;
+    }
+
+    std::vector<int> files;
+    {
+        std::unique_lock<std::mutex> lock = control.lock();
+        for (int i = 0; i < m_max_inodes; ++i) {
+            if (m_inode_table[i].type == InodeType::FILE && m_inode_table[i].size > 0 && m_name_index.contains(i)) {
+                files.push_back(i);
+            }
+        }
+    }
+    if (files.empty()) {
+        return SearchStatus::COMPLETE;
+    }
+
+    // Workers pull files off a shared counter; disk reads serialize inside Disk while the scanning overlaps.
+    // Each file's matches are handed to on_match as soon as that file is done, one worker at a time.
+    // With a search lock set each file is scanned under it, so extra workers would only take turns:
+    // the search then runs on the calling thread alone.
+    const size_t threads_wanted = control.has_lock() ? 1 : std::max(1u, std::thread::hardware_concurrency());
+    const int worker_count = static_cast<int>(std::min(files.size(), threads_wanted));
+    std::atomic<size_t> next{0};
+    std::mutex callback_mutex;
+
+    auto worker = [&]() {
+        std::vector<ContentMatch> matches;
+        std::string path;
+        for (size_t i = next.fetch_add(1); i < files.size() && !control.stopped(); i = next.fetch_add(1)) {
+            matches.clear();
+            {
+                std::unique_lock<std::mutex> fs_lock = control.lock();
+                scan_file_content(files[i], needle, control, matches);
+                if (matches.empty()) {
+                    continue;
+                }
+                m_name_index.path_of(files[i], path);
+            }
+
+            std::lock_guard<std::mutex> lock(callback_mutex);
+            for (auto& match : matches) {
+                match.path = path;
+                on_match(match);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < worker_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    return control.stopped() ? SearchStatus::STOPPED : SearchStatus::COMPLETE;
+}
+
+bool FileSystem::list_directory_entries(std::string_view path, std::vector<DirectoryEntry>& out) {
+    TraceScope trace(m_trace, TraceOp::LIST_DIRECTORY, path);
     out.clear();
 
     int inode_index = resolve_path(path);
     if (inode_index < 0 || inode_index >= m_max_inodes) {
-        std::cerr << "list_directory_entries: path not found: " << path << "\n";
+        LOG_ERROR("list_directory_entries: path not found: " << path);
         return false;
     }
     const Inode& dir_inode = m_inode_table[inode_index];
-    std::cout << "INODE INDEX: " << inode_index;
-    std::cout << "inode type (raw): " << static_cast<int>(dir_inode.type) << "\n";
+    LOG_DEBUG("list_directory_entries: inode " << inode_index << " type " << static_cast<int>(dir_inode.type));
     if (dir_inode.type != InodeType::DIRECTORY) {
-        std::cerr << "list_directory_entries: not a directory: " << path << "\n";
+        LOG_ERROR("list_directory_entries: not a directory: " << path);
         return false;
     }
 
+    return read_directory(inode_index, out);
+}
 
-    int dir_block = dir_inode.index_block;
+bool FileSystem::read_directory(int directory_inode_index, std::vector<DirectoryEntry>& out) {
+    out.clear();
+
+    int dir_block = m_inode_table[directory_inode_index].index_block;
     if (dir_block < 0) {
-        std::cerr << "list_directory_entries: directory has no block\n";
+        LOG_ERROR("read_directory: directory has no block");
         return false;
     }
 
     const int block_size = m_disk.block_size();
-    std::vector<char> buffer(block_size, 0);
+    BlockPool::Buffer buffer = m_disk.block_pool().acquire();
 
     if (!m_disk.read_block(dir_block, buffer.data())) {
-        std::cerr << "list_directory_entries: failed to read directory block\n";
+        LOG_ERROR("read_directory: failed to read directory block");
         return false;
     }
 
@@ -888,30 +1987,80 @@ bool FileSystem::is_directory_inode(int inode_index) {
 
 bool FileSystem::mount() {
     if (!m_disk.is_open()) {
-        std::cerr << "Cannot mount: disk is not open\n";
+        LOG_ERROR("Cannot mount: disk is not open");
         return false;
     }
     
     if (!FileSystem::read_superblock_from_disk()) {
-        std::cerr << "Reading superblock from disk failed\n";
+        LOG_ERROR("Reading superblock from disk failed");
         return false;
     }
 
     if (m_superblock.id != SUPERBLOCK_MAGIC) {
-        std::cerr << "mount: invalid superblock magic, need initialize\n";
+        LOG_WARN("mount: invalid superblock magic, need initialize");
+        return false;
+    }
+
+    // Opened with other dimensions than it was formatted with, see read_image_superblock
+    if (m_superblock.block_size != m_disk.block_size() || m_superblock.total_blocks != m_disk.number_of_blocks() ||
+        (m_superblock.max_inodes != 0 && m_superblock.max_inodes != m_max_inodes)) {
+        LOG_ERROR("mount: image is formatted as " << m_superblock.total_blocks << " blocks of " << m_superblock.block_size << " bytes with "
+                  << m_superblock.max_inodes << " inodes, opened as " << m_disk.number_of_blocks() << " blocks of " << m_disk.block_size()
+                  << " bytes with " << m_max_inodes << " inodes");
         return false;
     }
 
     if (!FileSystem::read_inode_table_from_disk()) {
-        std::cerr <<"Reading inode table from disk failed\n";
+        LOG_ERROR("Reading inode table from disk failed");
         return false;
     }
 
     if (!FileSystem::read_free_bitmap_from_disk()) {
-        std::cerr << "Reading free bitmap from disk failed\n";
+        LOG_ERROR("Reading free bitmap from disk failed");
         return false;
     }
+
+    if (!FileSystem::read_name_index_from_disk()) {
+        LOG_ERROR("Reading name index from disk failed");
+        return false;
+    }
+
+    // Totals are built separately, see build_usage_index()
+    m_usage_index.reset(m_max_inodes);
+    m_next_free_block = 0;
+    m_next_free_inode = 0;
     return true;
 }
 
+StatsSnapshot FileSystem::stats() const {
+    StatsSnapshot snapshot = m_stats.snapshot();
+    StatsSnapshot disk = m_disk.stats();
+    snapshot.ops.insert(snapshot.ops.end(), disk.ops.begin(), disk.ops.end());
+    return snapshot;
+}
 
+bool FileSystem::dump_stats_json(const std::string& host_path) const {
+    std::ofstream out(host_path, std::ios::trunc);
+    if (!out) {
+        LOG_ERROR("dump_stats_json: cannot open " << host_path);
+        return false;
+    }
+    out << stats().to_json();
+    return static_cast<bool>(out);
+}
+
+static std::chrono::microseconds last_latency(const OpStats& stats, Op op) {
+    const std::chrono::nanoseconds last = stats.last(op);
+    if (last.count() < 0) {
+        return std::chrono::microseconds(-1);
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(last);
+}
+
+std::chrono::microseconds FileSystem::last_search_latency() const {
+    return last_latency(m_stats, Op::SEARCH);
+}
+
+std::chrono::microseconds FileSystem::last_read_latency() const {
+    return last_latency(m_stats, Op::READ_FILE);
+}
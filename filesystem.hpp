@@ -1,10 +1,21 @@
 #ifndef FILE_SYSTEM_H
 #define FILE_SYSTEM_H
 #include "disk.hpp"
+#include "name_index.hpp"
+#include "op_stats.hpp"
+#include "path_pattern.hpp"
+#include "trace.hpp"
+#include "usage_index.hpp"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
 #include <vector>
 #include <string>
+#include <string_view>
 
 
 enum class InodeType {
@@ -30,6 +41,49 @@ struct OpenFileEntry {
     int offset{};
 };
 
+struct ContentMatch {
+    std::string path;
+    int line{};   // 1-based
+    int column{}; // 1-based, in bytes
+    int offset{}; // byte offset from the start of the file
+};
+
+// A file for create_files_contiguous
+struct ImportFile {
+    std::string path; // its parent directory must already exist
+    std::string data;
+};
+
+enum class SearchStatus {
+    COMPLETE,
+    STOPPED,        // cancelled or ran past its deadline, results so far were delivered
+    INVALID_PATTERN
+};
+
+// Shared between a running search and whoever wants to stop it. The search polls
+// stopped() between entries, so cancel() may be called from any thread.
+class SearchControl {
+public:
+    void cancel();
+    void set_budget(std::chrono::milliseconds budget);
+    bool stopped() const;
+
+    // The search then holds mutex for one unit of work at a time (a file, a directory, a stretch of the
+    // name index) instead of for the whole search, so other users of the filesystem get in between.
+    // Set it before the search starts; without it nothing is locked.
+    void set_lock(std::mutex* mutex) { m_lock = mutex; };
+    bool has_lock() const { return m_lock != nullptr; };
+    std::unique_lock<std::mutex> lock() const;
+
+private:
+    std::atomic<bool> m_cancelled{false};
+    std::chrono::steady_clock::time_point m_deadline{std::chrono::steady_clock::time_point::max()};
+    std::mutex* m_lock{nullptr};
+};
+
+using PathCallback = std::function<void(const std::string&)>;
+using ContentCallback = std::function<void(const ContentMatch&)>;
+
 struct Superblock {
     int id{};          
     int total_blocks{};   
@@ -43,10 +97,21 @@ struct Superblock {
 
     int data_region_start{};
     int root_inode_index{};
+
+    // Zero on images formatted before the name index existed; it is then rebuilt at mount
+    int name_index_start{};
+    int name_index_blocks{};
+
+    // Zero on images formatted before it was recorded; the inode count is then whatever the caller passes
+    int max_inodes{};
 };
 
 constexpr int SUPERBLOCK_MAGIC = 0x1234ABCD;
 
+// Reads the superblock of the image at image_path without opening a Disk, so that one can be opened with
+// the geometry the image was formatted with. False if the file cannot be read or holds no filesystem.
+bool read_image_superblock(const std::string& image_path, Superblock& out);
+
 class FileSystem {
 public:
     FileSystem(Disk& disk, int max_inodes) : m_disk(disk), m_max_inodes{max_inodes} {};
@@ -55,52 +120,156 @@ public:
     bool initialize();
     bool mount();
 
-    bool create_file(const std::string& name);
+    bool create_file(std::string_view path);
     bool write_file(int file_index, const std::string& data);
+    // Overwrites [offset, offset + data.size()), growing the file if it ends past the current size.
+    // Only the blocks covering the range are written.
+    bool write_file_range(int file_index, int offset, const std::string& data);
+    // Shrinks the file to size and frees the blocks past it
+    bool truncate_file(int file_index, int size);
     bool read_file(int file_index, std::string& out);
-    int open_file(const std::string& path);
+    // Reads [offset, offset + length) clamped to the file, touching only the blocks that cover it
+    bool read_file_range(int file_index, int offset, int length, std::string& out);
+    int file_size(int file_index);
+    int open_file(std::string_view path);
     bool close_file(int file_index);
 
     const Superblock& superblock() const { return m_superblock; };
     int max_inodes() const { return m_max_inodes; };
     const std::vector<Inode>& inode_table() const { return m_inode_table; };
+    const NameIndex& name_index() const { return m_name_index; };
+    const Disk& disk() const { return m_disk; };
+
+    // Counts and latency percentiles of the filesystem's operations and of the disk's block I/O.
+    // Safe to call from any thread.
+    StatsSnapshot stats() const;
+    // Writes stats() as JSON to a file on the host
+    bool dump_stats_json(const std::string& host_path) const;
+
+    // Wall time of the most recent search (any kind) and of the most recent read_file/read_file_range,
+    // -1 before the first one. Safe to read from any thread.
+    std::chrono::microseconds last_search_latency() const;
+    std::chrono::microseconds last_read_latency() const;
+
+    // Records every public file and search call into trace from now on; nullptr stops recording.
+    // Set it while no other thread is using the filesystem.
+    void set_trace(TraceRecorder* trace) { m_trace = trace; };
+
+    // Between begin_batch() and commit_batch() the inode table, free bitmap and name records are only
+    // updated in memory and written once at the commit instead of after every call. Data and directory
+    // blocks are still written as they change, so a crash inside a batch loses only its metadata.
+    // Batches nest; the outermost commit writes.
+    void begin_batch();
+    bool commit_batch();
+    bool in_batch() const { return m_batch_depth > 0; };
+
+    // Inode of the file or directory at path, -1 if there is none
+    int lookup(std::string_view path);
 
-    bool create_directory(const std::string& path);
+    // Largest file an index block can describe
+    int64_t max_file_size() const { return static_cast<int64_t>(m_disk.block_size() / static_cast<int>(sizeof(int))) * m_disk.block_size(); };
+
+    // Bulk load: creates each file and writes its data, laid out back to back in one contiguous extent
+    // (each file's index block, then its data blocks) that reaches the disk in a single write. Files that
+    // cannot be created are skipped and their blocks given back. Without a large enough extent it falls back
+    // to create_file + write_file. Returns how many files were created, -1 if metadata could not be written.
+    int create_files_contiguous(const std::vector<ImportFile>& files);
+
+    bool create_directory(std::string_view path);
     std::vector<std::string> search(const std::string& pattern);
-    bool list_directory_entries(const std::string& path, std::vector<DirectoryEntry>& out);
+    bool search_glob(const std::string& pattern, std::vector<std::string>& out);
+    bool search_regex(const std::string& pattern, std::vector<std::string>& out);
+    std::vector<ContentMatch> search_content(const std::string& needle);
+
+    // Streaming variants: results are reported as they are found, in no particular order
+    SearchStatus search(const std::string& pattern, const PathCallback& on_result, const SearchControl& control);
+    SearchStatus search_glob(const std::string& pattern, const PathCallback& on_result, const SearchControl& control);
+    SearchStatus search_regex(const std::string& pattern, const PathCallback& on_result, const SearchControl& control);
+    SearchStatus search_content(const std::string& needle, const ContentCallback& on_match, const SearchControl& control);
+
+    // Every linked file and directory, e.g. as candidates for fuzzy matching
+    std::vector<std::string> all_paths();
+    bool list_directory_entries(std::string_view path, std::vector<DirectoryEntry>& out);
     bool is_directory_inode(int inode_index);
+
+    // Recursive size and file count per directory. One pass over the inode table builds every total
+    // (slow enough on a big image to run off the UI thread); creates and writes keep them current after.
+    void build_usage_index();
+    bool usage_ready() const { return m_usage_index.ready(); };
+    DirectoryUsage usage(int inode_index) const { return m_usage_index.usage(inode_index); };
+    uint64_t usage_generation() const { return m_usage_index.generation(); };
 private:
     Disk& m_disk;
     Superblock m_superblock{};
     std::vector<Inode> m_inode_table{};
     std::vector<uint8_t> m_free_bitmap{};
     std::vector<OpenFileEntry> m_open_files{};
+    NameIndex m_name_index{};
+    UsageIndex m_usage_index{};
+    OpStats m_stats{};
+    TraceRecorder* m_trace{nullptr};
+
+    // Everything below these is in use, so allocation scans start here instead of at 0
+    int m_next_free_block{0};
+    int m_next_free_inode{0};
+
+    int m_batch_depth{0};
+    bool m_inode_table_dirty{false};
+    bool m_free_bitmap_dirty{false};
+    std::unordered_set<int> m_dirty_name_blocks{};
 
     const int m_max_inodes{};
     bool initialize_superblock();
     bool initialize_inode_table();
     bool initialize_root_directory();
     bool initialize_free_bitmap();
+    bool initialize_name_index();
 
     bool mark_block_used(int block_number);
+    bool mark_block_free(int block_number);
 
     bool read_superblock_from_disk();
     bool read_inode_table_from_disk();
     bool read_free_bitmap_from_disk();
+    bool read_name_index_from_disk();
 
     int allocate_block();               
     int allocate_inode();               
+    // block_count consecutive free blocks, -1 if there is no such run
+    int allocate_extent(int block_count);
     bool write_inode_table_to_disk();    
+    // Spread bytes of data over block_count blocks from first_block on (zero-padded), and back
+    bool write_table_blocks(int first_block, int block_count, const void* data, size_t bytes, const char* what);
+    bool read_table_blocks(int first_block, int block_count, void* data, size_t bytes, const char* what);
     bool write_free_bitmap_to_disk();    
+    bool write_name_record_to_disk(int inode_index);
     
-    bool add_directory_entry(int directory_inode_index, int inode_index, const std::string& name);
-    int find_directory_entry(int directory_inode_index, const std::string& name);
+    bool add_directory_entry(int directory_inode_index, int inode_index, std::string_view name);
+    int find_directory_entry(int directory_inode_index, std::string_view name);
 
-    void recursive_search(int dir_inode_index,const std::string& dir_path, const std::string& pattern, std::vector<std::string>& results);
+    bool index_name(int inode_index, int parent_inode, std::string_view name);
+    void track_usage(int inode_index, int64_t bytes, int files);
+    void rebuild_name_index(int dir_inode_index);
+    bool read_directory(int dir_inode_index, std::vector<DirectoryEntry>& out);
+    struct GlobWalk {
+        const GlobPattern& glob;
+        const PathCallback& on_result;
+        const SearchControl& control;
+        std::string path{};
+        std::unordered_set<std::string> seen{};
+    };
+    bool glob_walk(GlobWalk& walk, int dir_inode_index, int segment_index, int depth);
+    // Hands every path under the directory part of prefix (up to its last '/', at slash) that starts with
+    // prefix to on_path. search_regex runs its regex there when the pattern is anchored to a literal prefix.
+    SearchStatus walk_prefix(const std::string& prefix, size_t slash, const PathCallback& on_path, const SearchControl& control);
+    bool scan_file_content(int inode_index, const std::string& needle, const SearchControl& control, std::vector<ContentMatch>& out);
 
-    int resolve_path(const std::string& path);
-    std::vector<std::string> split_path(const std::string& path);
-    int resolve_parent_directory(const std::string& path, std::string& leaf);
+    // Paths are walked in place (see PathCursor), nothing is allocated per component.
+    // resolve_path is the timed entry point, walk_path the lookup itself.
+    int resolve_path(std::string_view path);
+    int walk_path(std::string_view path);
+    // leaf points into path
+    int resolve_parent_directory(std::string_view path, std::string_view& leaf);
 };
 
 #endif
@@ -0,0 +1,408 @@
+// Filesystem microbenchmarks: formats a temporary image with the given geometry, times the core
+// operations one call at a time and prints percentiles, so numbers can be compared across releases.
+#include "disk.hpp"
+#include "filesystem.hpp"
+#include "op_stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Directory blocks hold this many entries; the synthetic tree gives half to directories, half to files
+constexpr int ENTRIES_PER_DIRECTORY = 8;
+constexpr int TREE_FANOUT = ENTRIES_PER_DIRECTORY / 2;
+
+struct BenchOptions {
+    int block_size{512};
+    int blocks{16384};
+    int inodes{2048};
+    int directories{255};
+    int files{1024};
+    int depth{16};
+    int iterations{200};
+    int disk_ops{4096};
+    std::string image{(std::filesystem::temp_directory_path() / "termexplorer_bench.img").string()};
+    std::string json{};
+};
+
+struct Samples {
+    std::string name;
+    int bytes_per_op{};
+    std::vector<double> nanos{};
+};
+
+struct Result {
+    std::string name;
+    uint64_t ops{};
+    double p50_us{};
+    double p99_us{};
+    double mean_us{};
+    int bytes_per_op{};
+};
+
+// Times one call of fn and adds it to samples, false if fn failed
+template <typename Fn>
+bool timed(Samples& samples, Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = fn();
+    samples.nanos.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    return ok;
+}
+
+Result summarize(const Samples& samples) {
+    Result result{samples.name, samples.nanos.size(), 0, 0, 0, samples.bytes_per_op};
+    if (samples.nanos.empty()) {
+        return result;
+    }
+
+    std::vector<double> sorted = samples.nanos;
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&](int percentile) { return sorted[std::min(sorted.size() - 1, sorted.size() * percentile / 100)]; };
+
+    double total = 0;
+    for (double ns : sorted)
+        total += ns;
+    result.p50_us = at(50) / 1000.0;
+    result.p99_us = at(99) / 1000.0;
+    result.mean_us = total / sorted.size() / 1000.0;
+    return result;
+}
+
+// allocate_block is private, its numbers come from the histogram the filesystem keeps anyway
+Result summarize(const StatsSnapshot& stats, Op op, const std::string& name) {
+    Result result{name};
+    if (const OpSummary* summary = stats.find(op)) {
+        result.ops = summary->count;
+        result.p50_us = summary->p50_ns / 1000.0;
+        result.p99_us = summary->p99_ns / 1000.0;
+        result.mean_us = summary->count ? summary->total_ns / 1000.0 / summary->count : 0;
+    }
+    return result;
+}
+
+void print_usage() {
+    std::cerr << "usage: TermExplorerBench [--block-size N] [--blocks N] [--inodes N] [--directories N] [--files N]\n"
+              << "                         [--depth N] [--iterations N] [--disk-ops N] [--image PATH] [--json PATH]\n";
+}
+
+bool parse_options(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "fs_bench: missing value for " << arg << "\n";
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        if (arg == "--image") {
+            options.image = value;
+        } else if (arg == "--json") {
+            options.json = value;
+        } else {
+            int* target = nullptr;
+            if (arg == "--block-size") target = &options.block_size;
+            else if (arg == "--blocks") target = &options.blocks;
+            else if (arg == "--inodes") target = &options.inodes;
+            else if (arg == "--directories") target = &options.directories;
+            else if (arg == "--files") target = &options.files;
+            else if (arg == "--depth") target = &options.depth;
+            else if (arg == "--iterations") target = &options.iterations;
+            else if (arg == "--disk-ops") target = &options.disk_ops;
+
+            if (!target) {
+                std::cerr << "fs_bench: unknown option " << arg << "\n";
+                return false;
+            }
+            *target = std::atoi(value.c_str());
+        }
+    }
+
+    // Block numbers must fit an index block and a directory block must hold its entries
+    if (options.block_size < 512 || options.block_size % 4 != 0 || options.blocks < 64 || options.depth < 1 ||
+        options.directories < 0 || options.files < 0 || options.iterations < 1 || options.disk_ops < 1) {
+        std::cerr << "fs_bench: invalid option value\n";
+        return false;
+    }
+    if (options.files > TREE_FANOUT * (options.directories + 1)) {
+        std::cerr << "fs_bench: at most " << TREE_FANOUT << " files per directory, raise --directories\n";
+        return false;
+    }
+    // Tree, depth chain with one file per level, one file per I/O size, and the three top-level directories
+    const int needed = options.directories + options.files + 2 * options.depth + 8 + 4;
+    if (options.inodes < needed) {
+        std::cerr << "fs_bench: need at least " << needed << " inodes for this tree\n";
+        return false;
+    }
+    return true;
+}
+
+// Breadth-first: directory i (0 is /tree itself) has TREE_FANOUT subdirectories and TREE_FANOUT files
+std::string tree_directory(const std::vector<std::string>& directories, int i) {
+    return directories[(i - 1) / TREE_FANOUT] + "/dir_" + std::to_string(i);
+}
+
+bool bench_create(FileSystem& fs, const BenchOptions& options, std::vector<Result>& results) {
+    std::vector<std::string> directories{"/tree"};
+    if (!fs.create_directory(directories.front())) {
+        return false;
+    }
+
+    Samples mkdir{"create_directory"};
+    for (int i = 1; i <= options.directories; ++i) {
+        directories.push_back(tree_directory(directories, i));
+        if (!timed(mkdir, [&] { return fs.create_directory(directories.back()); })) {
+            std::cerr << "fs_bench: create_directory " << directories.back() << " failed\n";
+            return false;
+        }
+    }
+
+    Samples create{"create_file"};
+    for (int i = 0; i < options.files; ++i) {
+        const std::string path = directories[i / TREE_FANOUT] + "/file_" + std::to_string(i) + ".txt";
+        if (!timed(create, [&] { return fs.create_file(path); })) {
+            std::cerr << "fs_bench: create_file " << path << " failed\n";
+            return false;
+        }
+    }
+
+    results.push_back(summarize(mkdir));
+    results.push_back(summarize(create));
+    return true;
+}
+
+bool bench_file_io(FileSystem& fs, const BenchOptions& options, std::vector<Result>& results) {
+    if (!fs.create_directory("/io")) {
+        return false;
+    }
+
+    // Up to the largest file one index block can describe
+    const int max_bytes = options.block_size / static_cast<int>(sizeof(int)) * options.block_size;
+    std::vector<int> sizes{64, options.block_size, 4 * options.block_size, 16 * options.block_size, max_bytes};
+    sizes.erase(std::remove_if(sizes.begin(), sizes.end(), [&](int size) { return size > max_bytes; }), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    std::string data;
+    std::string out;
+    for (int size : sizes) {
+        const std::string path = "/io/file_" + std::to_string(size);
+        if (!fs.create_file(path)) {
+            return false;
+        }
+        const int fd = fs.open_file(path);
+        if (fd < 0) {
+            return false;
+        }
+
+        data.assign(size, 'x');
+        // The first write allocates the file's blocks, the timed ones overwrite them in place
+        if (!fs.write_file(fd, data)) {
+            std::cerr << "fs_bench: out of space writing " << size << " bytes, raise --blocks\n";
+            return false;
+        }
+
+        Samples write{"write_file " + std::to_string(size), size};
+        Samples read{"read_file " + std::to_string(size), size};
+        for (int i = 0; i < options.iterations; ++i) {
+            if (!timed(write, [&] { return fs.write_file(fd, data); }) || !timed(read, [&] { return fs.read_file(fd, out); })) {
+                return false;
+            }
+        }
+        fs.close_file(fd);
+
+        results.push_back(summarize(write));
+        results.push_back(summarize(read));
+    }
+    return true;
+}
+
+// open_file + close_file of a file depth components down, most of which is resolving the path
+bool bench_resolve(FileSystem& fs, const BenchOptions& options, std::vector<Result>& results) {
+    std::string directory = "/chain";
+    if (!fs.create_directory(directory)) {
+        return false;
+    }
+
+    std::vector<std::string> files;
+    for (int level = 2; level <= options.depth; ++level) {
+        files.push_back(directory + "/f");
+        if (!fs.create_file(files.back())) {
+            return false;
+        }
+        directory += "/level_" + std::to_string(level);
+        if (!fs.create_directory(directory)) {
+            return false;
+        }
+    }
+    files.push_back(directory + "/f");
+    if (!fs.create_file(files.back())) {
+        return false;
+    }
+
+    // files[i] is i + 2 components deep; time powers of two and the deepest
+    const int deepest = options.depth + 1;
+    std::vector<int> depths;
+    for (int depth = 2; depth < deepest; depth *= 2)
+        depths.push_back(depth);
+    depths.push_back(deepest);
+
+    for (int depth : depths) {
+        const std::string& path = files[depth - 2];
+        Samples open{"resolve depth " + std::to_string(depth)};
+        for (int i = 0; i < options.iterations; ++i) {
+            int fd = -1;
+            if (!timed(open, [&] { fd = fs.open_file(path); return fs.close_file(fd); })) {
+                return false;
+            }
+        }
+        results.push_back(summarize(open));
+    }
+    return true;
+}
+
+bool bench_search(FileSystem& fs, const BenchOptions& options, std::vector<Result>& results) {
+    struct Query {
+        const char* name;
+        std::function<bool()> run;
+    };
+
+    std::vector<std::string> paths;
+    const std::vector<Query> queries{
+        {"search substring", [&] { paths = fs.search("file_1"); return true; }},
+        {"search glob name", [&] { return fs.search_glob("*.txt", paths); }},
+        {"search glob path", [&] { return fs.search_glob("/tree/dir_1/*/*.txt", paths); }},
+        {"search regex", [&] { return fs.search_regex("file_[0-9]*7\\.txt$", paths); }},
+    };
+
+    for (const Query& query : queries) {
+        Samples samples{query.name};
+        for (int i = 0; i < options.iterations; ++i) {
+            if (!timed(samples, query.run)) {
+                return false;
+            }
+        }
+        results.push_back(summarize(samples));
+    }
+    return true;
+}
+
+// Raw block I/O, sequential then at random block numbers. Runs last since it overwrites the filesystem.
+void bench_disk(Disk& disk, const BenchOptions& options, std::vector<Result>& results) {
+    std::vector<char> buffer(options.block_size, 'b');
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> any_block(0, options.blocks - 1);
+
+    Samples sequential_write{"write_block seq", options.block_size};
+    Samples sequential_read{"read_block seq", options.block_size};
+    Samples random_write{"write_block rand", options.block_size};
+    Samples random_read{"read_block rand", options.block_size};
+    for (int i = 0; i < options.disk_ops; ++i) {
+        timed(sequential_write, [&] { return disk.write_block(i % options.blocks, buffer.data()); });
+    }
+    for (int i = 0; i < options.disk_ops; ++i) {
+        timed(sequential_read, [&] { return disk.read_block(i % options.blocks, buffer.data()); });
+    }
+    for (int i = 0; i < options.disk_ops; ++i) {
+        timed(random_write, [&] { return disk.write_block(any_block(rng), buffer.data()); });
+    }
+    for (int i = 0; i < options.disk_ops; ++i) {
+        timed(random_read, [&] { return disk.read_block(any_block(rng), buffer.data()); });
+    }
+
+    results.push_back(summarize(sequential_write));
+    results.push_back(summarize(sequential_read));
+    results.push_back(summarize(random_write));
+    results.push_back(summarize(random_read));
+}
+
+void report(const Result& result) {
+    std::cout << std::left << std::setw(22) << result.name << std::right
+              << std::setw(10) << result.ops
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << result.p50_us
+              << std::setw(12) << result.p99_us
+              << std::setw(12) << result.mean_us;
+    if (result.bytes_per_op > 0 && result.mean_us > 0) {
+        std::cout << std::setw(12) << result.bytes_per_op / result.mean_us; // bytes per us == MB/s
+    }
+    std::cout << "\n";
+}
+
+bool write_json(const std::string& path, const BenchOptions& options, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+
+    out << "{\n  \"geometry\": {\"block_size\": " << options.block_size << ", \"blocks\": " << options.blocks
+        << ", \"inodes\": " << options.inodes << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops << ", \"p50_us\": " << r.p50_us
+            << ", \"p99_us\": " << r.p99_us << ", \"mean_us\": " << r.mean_us << ", \"bytes_per_op\": " << r.bytes_per_op << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    std::remove(options.image.c_str());
+    Disk disk(options.blocks, options.block_size);
+    if (!disk.open(options.image)) {
+        std::cerr << "fs_bench: failed to open " << options.image << "\n";
+        return 1;
+    }
+
+    FileSystem fs(disk, options.inodes);
+    if (!fs.initialize() || !fs.mount()) {
+        std::cerr << "fs_bench: failed to format " << options.image << "\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    const bool ok = bench_create(fs, options, results) && bench_file_io(fs, options, results) &&
+                    bench_resolve(fs, options, results) && bench_search(fs, options, results);
+    if (!ok) {
+        std::cerr << "fs_bench: benchmark failed, see errors above\n";
+        disk.close();
+        std::remove(options.image.c_str());
+        return 1;
+    }
+    results.push_back(summarize(fs.stats(), Op::ALLOCATE_BLOCK, "allocate_block"));
+    bench_disk(disk, options, results);
+
+    std::cout << "image: " << options.blocks << " blocks of " << options.block_size << " bytes, " << options.inodes << " inodes\n";
+    std::cout << std::left << std::setw(22) << "benchmark" << std::right << std::setw(10) << "ops"
+              << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "mean us"
+              << std::setw(12) << "MB/s" << "\n";
+    for (const Result& result : results) {
+        report(result);
+    }
+
+    if (!options.json.empty() && !write_json(options.json, options, results)) {
+        std::cerr << "fs_bench: failed to write " << options.json << "\n";
+    }
+
+    disk.close();
+    std::remove(options.image.c_str());
+    return 0;
+}
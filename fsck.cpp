@@ -0,0 +1,98 @@
+// Checks an unmounted image for blocks the bitmap and the tree disagree about, orphan inodes and
+// broken directory entries, and with --repair fixes what it can (see checker.hpp).
+// Exit status: 0 clean, 1 problems found and repaired, 4 problems left, 8 the image could not be checked.
+#include "checker.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct FsckOptions {
+    std::string image{};
+    CheckOptions check{};
+};
+
+void print_usage() {
+    std::cerr << "usage: TermExplorerFsck IMAGE [--repair] [--threads N] [--inodes N]\n";
+}
+
+bool parse_options(int argc, char** argv, FsckOptions& options) {
+    options.check.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--repair") {
+            options.check.repair = true;
+        } else if ((arg == "--threads" || arg == "--inodes") && i + 1 < argc) {
+            (arg == "--threads" ? options.check.threads : options.check.inodes) = std::atoi(argv[++i]);
+        } else if (!arg.empty() && arg[0] != '-' && options.image.empty()) {
+            options.image = arg;
+        } else {
+            std::cerr << "fsck: unexpected argument " << arg << "\n";
+            return false;
+        }
+    }
+    if (options.check.threads < 1 || options.check.inodes < 0) {
+        std::cerr << "fsck: invalid option value\n";
+        return false;
+    }
+    return !options.image.empty();
+}
+
+void print_count(const char* what, int64_t count) {
+    if (count != 0) {
+        std::cout << "  " << what << ": " << count << "\n";
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    FsckOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 8;
+    }
+
+    CheckReport report;
+    if (!check_image(options.image, options.check, report)) {
+        std::cerr << "fsck: cannot check " << options.image << ", see errors above\n";
+        return 8;
+    }
+
+    std::cout << options.image << ": " << report.directories << " directories, " << report.files << " files, "
+              << report.used_blocks << " blocks marked used, " << report.reachable_blocks << " reachable, checked in "
+              << report.seconds * 1000 << " ms\n";
+    if (report.clean()) {
+        std::cout << "clean\n";
+        return 0;
+    }
+
+    for (const std::string& line : report.details) {
+        std::cout << "  " << line << "\n";
+    }
+    print_count("blocks marked used but unreachable", report.leaked_blocks);
+    print_count("blocks in use but marked free", report.unmarked_blocks);
+    print_count("blocks past the end of their file", report.slack_blocks);
+    print_count("references outside the data region", report.bad_block_references);
+    print_count("blocks used twice", report.shared_blocks);
+    print_count("orphan inodes", report.orphan_inodes);
+    print_count("broken inodes", report.bad_inodes);
+    print_count("dangling directory entries", report.dangling_entries);
+    print_count("inodes linked more than once", report.multiply_linked);
+    print_count("stale name index records", report.stale_name_records);
+
+    if (!report.repaired) {
+        std::cout << "not repaired, run with --repair to fix\n";
+        return 4;
+    }
+    if (report.unrepaired > 0) {
+        std::cout << "repaired, " << report.unrepaired << " problems left that need a decision\n";
+        return 4;
+    }
+    std::cout << "repaired\n";
+    return 1;
+}
@@ -0,0 +1,263 @@
+#include "fuzzy_match.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Same weights as fzf
+constexpr int SCORE_MATCH = 16;
+constexpr int SCORE_GAP_START = -3;
+constexpr int SCORE_GAP_EXTENSION = -1;
+constexpr int BONUS_BOUNDARY = SCORE_MATCH / 2;
+constexpr int BONUS_BOUNDARY_WHITE = BONUS_BOUNDARY + 2;
+constexpr int BONUS_BOUNDARY_DELIMITER = BONUS_BOUNDARY + 1;
+constexpr int BONUS_NON_WORD = SCORE_MATCH / 2;
+constexpr int BONUS_CAMEL_123 = BONUS_BOUNDARY + SCORE_GAP_EXTENSION;
+constexpr int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+
+enum CharClass : uint8_t {
+    CHAR_WHITE,
+    CHAR_NON_WORD,
+    CHAR_DELIMITER,
+    CHAR_LOWER,
+    CHAR_UPPER,
+    CHAR_NUMBER
+};
+
+CharClass classify(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return CHAR_LOWER;
+    if (c >= 'A' && c <= 'Z') return CHAR_UPPER;
+    if (c >= '0' && c <= '9') return CHAR_NUMBER;
+    if (c == ' ' || c == '\t') return CHAR_WHITE;
+    if (c == '/' || c == ',' || c == ':' || c == ';' || c == '|') return CHAR_DELIMITER;
+    // Bytes of multi-byte UTF-8 sequences count as word characters
+    if (c >= 0x80) return CHAR_LOWER;
+    return CHAR_NON_WORD;
+}
+
+struct CharClassTable {
+    CharClass classes[256];
+    CharClassTable() {
+        for (int c = 0; c < 256; ++c) {
+            classes[c] = classify(static_cast<unsigned char>(c));
+        }
+    }
+};
+
+const CharClassTable CHAR_CLASSES;
+
+inline CharClass char_class(unsigned char c) {
+    return CHAR_CLASSES.classes[c];
+}
+
+int bonus_for(CharClass previous, CharClass current) {
+    if (current > CHAR_DELIMITER) {
+        switch (previous) {
+            case CHAR_WHITE:     return BONUS_BOUNDARY_WHITE;
+            case CHAR_DELIMITER: return BONUS_BOUNDARY_DELIMITER;
+            case CHAR_NON_WORD:  return BONUS_BOUNDARY;
+            default: break;
+        }
+    }
+    if ((previous == CHAR_LOWER && current == CHAR_UPPER) || (previous != CHAR_NUMBER && current == CHAR_NUMBER)) {
+        return BONUS_CAMEL_123;
+    }
+    switch (current) {
+        case CHAR_NON_WORD:
+        case CHAR_DELIMITER: return BONUS_NON_WORD;
+        case CHAR_WHITE:     return BONUS_BOUNDARY_WHITE;
+        default:             return 0;
+    }
+}
+
+// One bit per letter/digit, the remaining bits bucket everything else
+uint64_t char_mask(std::string_view lower) {
+    uint64_t mask = 0;
+    for (unsigned char c : lower) {
+        int bit;
+        if (c >= 'a' && c <= 'z') bit = c - 'a';
+        else if (c >= '0' && c <= '9') bit = 26 + (c - '0');
+        else bit = 36 + c % 28;
+        mask |= uint64_t{1} << bit;
+    }
+    return mask;
+}
+
+void lowercase_into(std::string_view text, std::string& out) {
+    out.resize(text.size());
+    // Branch-free so the compiler can vectorize it
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        out[i] = static_cast<char>(c + ((static_cast<unsigned>(c - 'A') < 26u) << 5));
+    }
+}
+
+}
+
+bool fuzzy_score(std::string_view text, std::string_view lower_text, std::string_view query, bool case_sensitive, int& score) {
+    if (query.empty()) {
+        score = 0;
+        return true;
+    }
+
+    std::string_view haystack = case_sensitive ? text : lower_text;
+    const size_t n = haystack.size();
+    const size_t m = query.size();
+
+    // Forward pass: leftmost position where the whole query has been seen as a subsequence
+    size_t q = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (haystack[i] == query[q]) {
+            if (++q == m) {
+                end = i;
+                break;
+            }
+        }
+    }
+    if (q < m) {
+        return false;
+    }
+
+    // Backward pass from there narrows to the shortest window ending at `end`
+    size_t start = end;
+    q = m;
+    for (size_t i = end + 1; i-- > 0;) {
+        if (haystack[i] == query[q - 1]) {
+            if (--q == 0) {
+                start = i;
+                break;
+            }
+        }
+    }
+
+    int total = 0;
+    int consecutive = 0;
+    int first_bonus = 0;
+    bool in_gap = false;
+    q = 0;
+    CharClass previous = start > 0 ? char_class(static_cast<unsigned char>(text[start - 1])) : CHAR_DELIMITER;
+
+    for (size_t i = start; i <= end; ++i) {
+        const CharClass current = char_class(static_cast<unsigned char>(text[i]));
+        if (q < m && haystack[i] == query[q]) {
+            int bonus = bonus_for(previous, current);
+            if (consecutive == 0) {
+                first_bonus = bonus;
+            } else {
+                // A run keeps the boundary bonus of its first character
+                if (bonus >= BONUS_BOUNDARY && bonus > first_bonus) {
+                    first_bonus = bonus;
+                }
+                bonus = std::max({bonus, first_bonus, BONUS_CONSECUTIVE});
+            }
+
+            total += SCORE_MATCH + (q == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus);
+            in_gap = false;
+            ++consecutive;
+            ++q;
+        } else {
+            total += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+        previous = current;
+    }
+
+    score = total;
+    return true;
+}
+
+void FuzzyIndex::assign(std::vector<std::string> paths) {
+    m_text.clear();
+    m_offsets.clear();
+    m_masks.clear();
+    m_offsets.reserve(paths.size() + 1);
+    m_masks.reserve(paths.size());
+
+    m_offsets.push_back(0);
+    for (const auto& path : paths) {
+        m_text += path;
+        m_offsets.push_back(static_cast<uint32_t>(m_text.size()));
+    }
+
+    lowercase_into(m_text, m_lower);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        m_masks.push_back(char_mask(std::string_view(m_lower).substr(m_offsets[i], m_offsets[i + 1] - m_offsets[i])));
+    }
+}
+
+std::vector<FuzzyMatch> FuzzyIndex::top(const std::string& query, size_t limit, std::vector<int>* matched) const {
+    return rank(query, limit, nullptr, matched);
+}
+
+std::vector<FuzzyMatch> FuzzyIndex::narrow(const std::string& query, size_t limit, std::vector<int>& candidates) const {
+    std::vector<int> matched;
+    std::vector<FuzzyMatch> best = rank(query, limit, &candidates, &matched);
+    candidates = std::move(matched);
+    return best;
+}
+
+std::vector<FuzzyMatch> FuzzyIndex::rank(const std::string& query, size_t limit, const std::vector<int>* candidates, std::vector<int>* matched) const {
+    std::vector<FuzzyMatch> matches;
+    if (query.empty() || limit == 0) {
+        return matches;
+    }
+    matches.reserve(candidates ? candidates->size() : size());
+
+    // Smart case: an uppercase letter in the query makes it case sensitive
+    const bool case_sensitive = std::any_of(query.begin(), query.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
+
+    std::string lower_query;
+    lowercase_into(query, lower_query);
+    const uint64_t query_mask = char_mask(lower_query);
+
+    const std::string_view needle = case_sensitive ? std::string_view(query) : std::string_view(lower_query);
+    auto score_candidate = [&](size_t i) {
+        // Any query character missing from the path rules it out without scoring
+        if ((m_masks[i] & query_mask) != query_mask) {
+            return;
+        }
+
+        const size_t offset = m_offsets[i];
+        const size_t length = m_offsets[i + 1] - offset;
+        int score = 0;
+        if (fuzzy_score(std::string_view(m_text).substr(offset, length), std::string_view(m_lower).substr(offset, length), needle, case_sensitive, score)) {
+            matches.push_back({static_cast<int>(i), score});
+        }
+    };
+
+    if (candidates) {
+        for (int i : *candidates)
+            score_candidate(static_cast<size_t>(i));
+    } else {
+        for (size_t i = 0; i < size(); ++i)
+            score_candidate(i);
+    }
+
+    // Taken before partial_sort reorders matches, so the set stays in index order
+    if (matched) {
+        matched->clear();
+        matched->reserve(matches.size());
+        for (const FuzzyMatch& match : matches)
+            matched->push_back(match.index);
+    }
+
+    // Higher score first, shorter path breaks ties (fzf's length tiebreak)
+    auto better = [this](const FuzzyMatch& a, const FuzzyMatch& b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        const uint32_t length_a = m_offsets[a.index + 1] - m_offsets[a.index];
+        const uint32_t length_b = m_offsets[b.index + 1] - m_offsets[b.index];
+        if (length_a != length_b)
+            return length_a < length_b;
+        return a.index < b.index;
+    };
+
+    const size_t k = std::min(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + k, matches.end(), better);
+    matches.resize(k);
+    return matches;
+}
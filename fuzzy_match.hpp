@@ -0,0 +1,46 @@
+#ifndef FUZZY_MATCH_H
+#define FUZZY_MATCH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FuzzyMatch {
+    int index{};   // position of the candidate in the FuzzyIndex
+    int score{};
+};
+
+// fzf-style scoring of query as a subsequence of text. Returns false when query is not a subsequence.
+// lower_text must be text lowercased; case_sensitive compares against text itself.
+bool fuzzy_score(std::string_view text, std::string_view lower_text, std::string_view query, bool case_sensitive, int& score);
+
+// Candidate paths prepared once (lowercased, character mask) so every keystroke only scores
+class FuzzyIndex {
+public:
+    void assign(std::vector<std::string> paths);
+
+    size_t size() const { return m_masks.size(); };
+    std::string_view path(int index) const { return std::string_view(m_text).substr(m_offsets[index], m_offsets[index + 1] - m_offsets[index]); };
+
+    // Best `limit` candidates for query, highest score first. matched, if given, receives every
+    // candidate that matched (in index order), to be narrowed by the next keystroke.
+    std::vector<FuzzyMatch> top(const std::string& query, size_t limit, std::vector<int>* matched = nullptr) const;
+
+    // Like top() but only scores candidates, then replaces them with every candidate that matched.
+    // A query that extends the previous one (the previous query is a subsequence of it) can only
+    // match a subset, so typing narrows the previous matches instead of rescanning every path.
+    // An empty query leaves nothing to narrow: candidates comes back empty.
+    std::vector<FuzzyMatch> narrow(const std::string& query, size_t limit, std::vector<int>& candidates) const;
+
+private:
+    std::vector<FuzzyMatch> rank(const std::string& query, size_t limit, const std::vector<int>* candidates, std::vector<int>* matched) const;
+
+    // All paths back to back (and a lowercased copy) so scoring walks contiguous memory
+    std::string m_text{};
+    std::string m_lower{};
+    std::vector<uint32_t> m_offsets{};
+    std::vector<uint64_t> m_masks{};
+};
+
+#endif
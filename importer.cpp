@@ -0,0 +1,218 @@
+#include "importer.hpp"
+#include "log.hpp"
+#include "path_view.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Caps the files in one group so a tree of tiny files still gets several groups to overlap
+constexpr size_t MAX_GROUP_FILES = 1024;
+
+struct HostFile {
+    std::string host_path;
+    std::string path;
+    uint64_t size{};
+};
+
+struct Group {
+    size_t first{};
+    size_t count{};
+    std::vector<ImportFile> files{};
+    int unreadable{};
+    bool ready{false};
+};
+
+std::string join(const std::string& directory, const std::string& relative) {
+    return directory == "/" ? "/" + relative : directory + "/" + relative;
+}
+
+// mkdir -p
+bool make_directories(FileSystem& fs, const std::string& path) {
+    std::string prefix;
+    PathCursor cursor(path);
+    std::string_view component;
+    while (cursor.next(component)) {
+        prefix += '/';
+        prefix += component;
+        const int inode = fs.lookup(prefix);
+        if (inode < 0 ? !fs.create_directory(prefix) : !fs.is_directory_inode(inode)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_host_file(const std::string& host_path, uint64_t size, std::string& out) {
+    std::ifstream in(host_path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    out.resize(size);
+    in.read(out.data(), static_cast<std::streamsize>(size));
+    // The file may have changed since the walk; take what is there now
+    out.resize(static_cast<size_t>(in.gcount()));
+    return !in.bad();
+}
+
+}
+
+bool import_tree(FileSystem& fs, const std::string& host_root, const std::string& destination, const ImportOptions& options, ImportResult& result) {
+    result = {};
+    const auto start = std::chrono::steady_clock::now();
+
+    std::string root = destination.empty() ? "/" : destination;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+    // One walk collects everything; the iterator lists a directory before anything inside it
+    std::vector<std::string> directories;
+    std::vector<HostFile> files;
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(host_root, std::filesystem::directory_options::skip_permission_denied, error);
+    if (error) {
+        LOG_ERROR("import: cannot read " << host_root << ": " << error.message());
+        return false;
+    }
+    for (; it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (error) {
+            LOG_ERROR("import: walking " << host_root << ": " << error.message());
+            break;
+        }
+
+        const std::filesystem::directory_entry& entry = *it;
+        const std::string path = join(root, entry.path().lexically_relative(host_root).generic_string());
+        // Links are not followed: the filesystem has no way to represent them
+        if (entry.is_symlink(error)) {
+            LOG_WARN("import: skipping link " << entry.path().string());
+            ++result.skipped;
+        } else if (entry.is_directory(error)) {
+            directories.push_back(path);
+        } else if (entry.is_regular_file(error) && static_cast<int64_t>(entry.file_size(error)) <= fs.max_file_size()) {
+            files.push_back({entry.path().string(), path, entry.file_size(error)});
+        } else {
+            LOG_WARN("import: skipping " << entry.path().string());
+            ++result.skipped;
+        }
+    }
+
+    fs.begin_batch();
+    if (!make_directories(fs, root)) {
+        LOG_ERROR("import: cannot create " << root);
+        fs.commit_batch();
+        return false;
+    }
+    for (const std::string& directory : directories) {
+        if (fs.create_directory(directory)) {
+            ++result.directories;
+        } else {
+            ++result.skipped;
+        }
+    }
+
+    std::vector<Group> groups;
+    for (size_t i = 0; i < files.size();) {
+        Group group;
+        group.first = i;
+        size_t bytes = 0;
+        while (i < files.size() && group.count < MAX_GROUP_FILES && (group.count == 0 || bytes + files[i].size <= options.group_bytes)) {
+            bytes += files[i].size;
+            ++group.count;
+            ++i;
+        }
+        groups.push_back(std::move(group));
+    }
+
+    // Readers take groups in order but stay at most `window` groups ahead of the writer
+    const size_t window = static_cast<size_t>(std::max(1, options.readers)) * 2;
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t next_group = 0;
+    size_t written = 0;
+
+    auto reader = [&]() {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return next_group >= groups.size() || next_group < written + window; });
+                if (next_group >= groups.size()) {
+                    return;
+                }
+                index = next_group++;
+            }
+
+            Group& group = groups[index];
+            std::vector<ImportFile> loaded;
+            int unreadable = 0;
+            loaded.reserve(group.count);
+            for (size_t f = group.first; f < group.first + group.count; ++f) {
+                ImportFile file{files[f].path, {}};
+                if (read_host_file(files[f].host_path, files[f].size, file.data)) {
+                    loaded.push_back(std::move(file));
+                } else {
+                    LOG_WARN("import: cannot read " << files[f].host_path);
+                    ++unreadable;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                group.files = std::move(loaded);
+                group.unreadable = unreadable;
+                group.ready = true;
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < std::max(1, options.readers); ++i) {
+        readers.emplace_back(reader);
+    }
+
+    bool ok = true;
+    for (size_t index = 0; index < groups.size(); ++index) {
+        Group& group = groups[index];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return group.ready; });
+        }
+
+        const int created = fs.create_files_contiguous(group.files);
+        if (created < 0) {
+            ok = false;
+        } else {
+            result.files += created;
+        }
+        result.skipped += group.unreadable + static_cast<int>(group.files.size()) - std::max(created, 0);
+        for (const ImportFile& file : group.files) {
+            result.bytes += file.data.size();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<ImportFile>().swap(group.files);
+            written = index + 1;
+        }
+        changed.notify_all();
+    }
+
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    ok = fs.commit_batch() && ok;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("import: " << result.files << " files, " << result.directories << " directories, " << result.bytes << " bytes in "
+             << result.seconds << " s, " << result.skipped << " skipped");
+    return ok;
+}
@@ -0,0 +1,30 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include "filesystem.hpp"
+
+#include <cstdint>
+#include <string>
+
+struct ImportOptions {
+    // Host files are read by this many threads while the filesystem writes what they have read
+    int readers{4};
+    // Files are written in groups of about this many bytes, each group as one contiguous extent
+    size_t group_bytes{4 << 20};
+};
+
+struct ImportResult {
+    int directories{};
+    int files{};
+    int skipped{};      // unreadable, too large, special files, or no room in their directory
+    uint64_t bytes{};   // read from the host
+    double seconds{};
+};
+
+// Copies the host directory tree at host_root into destination (created if missing), directories first in
+// one pass, then the files in groups that create_files_contiguous lays out back to back. Metadata is held
+// in one FileSystem batch and written at the end. Reader threads stay a bounded number of groups ahead,
+// so memory use is about readers * 2 * group_bytes whatever the size of the tree.
+bool import_tree(FileSystem& fs, const std::string& host_root, const std::string& destination, const ImportOptions& options, ImportResult& result);
+
+#endif
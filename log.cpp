@@ -0,0 +1,148 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+constexpr size_t RING_CAPACITY = 1024;
+constexpr size_t MESSAGE_BYTES = 240; // longer messages are cut in the ring, not in the sinks
+constexpr size_t MESSAGE_WORDS = MESSAGE_BYTES / sizeof(uint64_t);
+static_assert(MESSAGE_BYTES % sizeof(uint64_t) == 0, "messages are copied a word at a time");
+
+// A seqlock per slot: stamp is odd while a writer fills the slot and 2 * (sequence + 1) once it is
+// done, so readers can tell a finished entry from one being overwritten without taking a lock.
+// The payload is relaxed atomics, so a reader racing a writer gets torn data it then throws away
+// rather than undefined behaviour; the text is moved a word at a time.
+struct Slot {
+    std::atomic<uint64_t> stamp{0};
+    std::atomic<LogLevel> level{LogLevel::INFO};
+    std::atomic<int64_t> time_us{0};
+    std::atomic<size_t> length{0};
+    std::atomic<uint64_t> text[MESSAGE_WORDS]{};
+};
+
+Slot g_ring[RING_CAPACITY];
+std::atomic<uint64_t> g_next{0};
+
+std::atomic<int> g_level{static_cast<int>(LogLevel::INFO)};
+std::atomic<int> g_stderr_level{static_cast<int>(LogLevel::WARN)};
+
+// The sinks are ordinary blocking I/O; only the ring is lock-free
+std::mutex g_sink_mutex;
+std::ofstream g_file;
+std::atomic<bool> g_file_open{false};
+
+const std::chrono::steady_clock::time_point g_start = std::chrono::steady_clock::now();
+
+}
+
+const char* log_level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE: return "trace";
+    case LogLevel::DEBUG: return "debug";
+    case LogLevel::INFO: return "info";
+    case LogLevel::WARN: return "warn";
+    case LogLevel::ERROR: return "error";
+    case LogLevel::OFF: break;
+    }
+    return "off";
+}
+
+void log_set_level(LogLevel level) {
+    g_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool log_enabled(LogLevel level) {
+    return static_cast<int>(level) >= g_level.load(std::memory_order_relaxed);
+}
+
+void log_set_stderr_level(LogLevel level) {
+    g_stderr_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool log_open_file(const std::string& path) {
+    std::lock_guard<std::mutex> lock(g_sink_mutex);
+    if (g_file.is_open()) {
+        g_file.close();
+    }
+    g_file.open(path, std::ios::app);
+    g_file_open.store(g_file.is_open(), std::memory_order_relaxed);
+    return g_file.is_open();
+}
+
+void log_close_file() {
+    std::lock_guard<std::mutex> lock(g_sink_mutex);
+    g_file_open.store(false, std::memory_order_relaxed);
+    g_file.close();
+}
+
+void log_write(LogLevel level, const std::string& message) {
+    const int64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_start).count();
+
+    const uint64_t sequence = g_next.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = g_ring[sequence % RING_CAPACITY];
+    slot.stamp.store(2 * sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    const size_t length = std::min(message.size(), MESSAGE_BYTES);
+    slot.level.store(level, std::memory_order_relaxed);
+    slot.time_us.store(time_us, std::memory_order_relaxed);
+    slot.length.store(length, std::memory_order_relaxed);
+    for (size_t offset = 0; offset < length; offset += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        std::memcpy(&word, message.data() + offset, std::min(sizeof(word), length - offset));
+        slot.text[offset / sizeof(uint64_t)].store(word, std::memory_order_relaxed);
+    }
+    slot.stamp.store(2 * sequence + 2, std::memory_order_release);
+
+    const bool to_stderr = static_cast<int>(level) >= g_stderr_level.load(std::memory_order_relaxed);
+    const bool to_file = g_file_open.load(std::memory_order_relaxed);
+    if (!to_stderr && !to_file) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_sink_mutex);
+    if (to_stderr) {
+        std::cerr << log_level_name(level) << ": " << message << "\n";
+    }
+    if (to_file && g_file.is_open()) {
+        g_file << time_us << " " << log_level_name(level) << ": " << message << "\n";
+        g_file.flush();
+    }
+}
+
+std::vector<LogEntry> log_recent(size_t count) {
+    std::vector<LogEntry> entries;
+    const uint64_t end = g_next.load(std::memory_order_acquire);
+    const uint64_t first = end - std::min<uint64_t>({end, count, RING_CAPACITY});
+
+    for (uint64_t sequence = first; sequence < end; ++sequence) {
+        const Slot& slot = g_ring[sequence % RING_CAPACITY];
+        const uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+        if (stamp != 2 * sequence + 2) {
+            continue; // still being written, or already reused
+        }
+
+        LogEntry entry;
+        entry.sequence = sequence;
+        entry.level = slot.level.load(std::memory_order_relaxed);
+        entry.time_us = slot.time_us.load(std::memory_order_relaxed);
+        const size_t length = std::min(slot.length.load(std::memory_order_relaxed), MESSAGE_BYTES);
+        entry.text.resize(length);
+        for (size_t offset = 0; offset < length; offset += sizeof(uint64_t)) {
+            const uint64_t word = slot.text[offset / sizeof(uint64_t)].load(std::memory_order_relaxed);
+            std::memcpy(&entry.text[offset], &word, std::min(sizeof(word), length - offset));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.stamp.load(std::memory_order_relaxed) == stamp) {
+            entries.push_back(std::move(entry));
+        }
+    }
+    return entries;
+}
@@ -0,0 +1,91 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum class LogLevel {
+    TRACE,
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR,
+    OFF
+};
+
+// Calls below this level (0 = TRACE ... 5 = OFF) are compiled out, arguments and all.
+// Defaults to INFO in release builds and DEBUG otherwise.
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL 2
+#else
+#define LOG_LEVEL 1
+#endif
+#endif
+
+struct LogEntry {
+    uint64_t sequence{};
+    LogLevel level{LogLevel::INFO};
+    int64_t time_us{}; // since the first message
+    std::string text{};
+};
+
+const char* log_level_name(LogLevel level);
+
+// Runtime threshold on top of the compile-time one, INFO by default
+void log_set_level(LogLevel level);
+bool log_enabled(LogLevel level);
+
+// Every message goes to the in-memory ring; these pick which also go to stderr (WARN and up by
+// default, OFF while the TUI owns the terminal) and to an optional file
+void log_set_stderr_level(LogLevel level);
+bool log_open_file(const std::string& path);
+void log_close_file();
+
+void log_write(LogLevel level, const std::string& message);
+
+// Up to `count` of the latest messages still in the ring, oldest first
+std::vector<LogEntry> log_recent(size_t count);
+
+#define LOG_AT(level, ...)                                 \
+    do {                                                   \
+        if (log_enabled(level)) {                          \
+            std::ostringstream log_stream_;                \
+            log_stream_ << __VA_ARGS__;                    \
+            log_write(level, log_stream_.str());           \
+        }                                                  \
+    } while (0)
+
+#if LOG_LEVEL <= 0
+#define LOG_TRACE(...) LOG_AT(LogLevel::TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= 1
+#define LOG_DEBUG(...) LOG_AT(LogLevel::DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= 2
+#define LOG_INFO(...) LOG_AT(LogLevel::INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= 3
+#define LOG_WARN(...) LOG_AT(LogLevel::WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= 4
+#define LOG_ERROR(...) LOG_AT(LogLevel::ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#endif
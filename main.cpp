@@ -1,20 +1,122 @@
 #include "tui.hpp"
+#include "batch_shell.hpp"
 #include "disk.hpp"
 #include "filesystem.hpp"
+#include "log.hpp"
+#include "trace.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
 
 
-int main() {
-    Disk disk(1024, 512);
-    if (!disk.open("disk.img")) {
-        std::cerr << "Failed to open disk image\n";
+int main(int argc, char** argv) {
+    // --stats-json PATH: write the filesystem's operation stats there on exit
+    // --log-file PATH: append every log message there, including those hidden while the TUI runs
+    // --trace PATH: record every filesystem call of the session there, for TermExplorerReplay
+    // --batch [SCRIPT]: run the commands in SCRIPT (or stdin) instead of the TUI, see batch_shell.hpp
+    // --image PATH (or just PATH): the image to open. A formatted image is opened with the geometry its superblock
+    // records; --blocks N, --block-size N, --inodes N only apply when it has to be formatted (see TermExplorerMkfs)
+    std::string stats_path;
+    std::string trace_path;
+    std::string image_path = "disk.img";
+    bool image_given = false;
+    int blocks = 1024;
+    int block_size = 512;
+    int inodes = 128;
+    bool batch = false;
+    std::string script_path;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                script_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--image") == 0 && i + 1 < argc && !image_given) {
+            image_path = argv[++i];
+            image_given = true;
+        } else if (std::strcmp(argv[i], "--blocks") == 0 && i + 1 < argc) {
+            blocks = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) {
+            block_size = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--inodes") == 0 && i + 1 < argc) {
+            inodes = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
+            if (!log_open_file(argv[++i])) {
+                std::cerr << "Failed to open log file " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && !image_given) {
+            image_path = argv[i];
+            image_given = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [IMAGE | --image PATH] [--batch [SCRIPT]] [--blocks N] [--block-size N] [--inodes N]\n"
+                      << "       [--stats-json PATH] [--log-file PATH] [--trace PATH]\n";
+            return 1;
+        }
+    }
+
+    Superblock superblock;
+    if (read_image_superblock(image_path, superblock)) {
+        blocks = superblock.total_blocks;
+        block_size = superblock.block_size;
+        // Older images do not record it
+        if (superblock.max_inodes > 0)
+            inodes = superblock.max_inodes;
+    }
+    if (blocks <= 0 || block_size <= 0 || inodes <= 0) {
+        std::cerr << "Invalid image geometry\n";
         return 1;
     }
 
-    FileSystem fs(disk, 128);
+    Disk disk(blocks, block_size);
+    if (!disk.open(image_path)) {
+        std::cerr << "Failed to open disk image " << image_path << "\n";
+        return 1;
+    }
+
+    FileSystem fs(disk, inodes);
+
+    // Batch mode: a blank image is formatted without the sample content, and stdout is the commands' output
+    if (batch) {
+        if (!fs.mount() && !(fs.initialize() && fs.mount())) {
+            std::cerr << "Failed to format " << image_path << "\n";
+            return 1;
+        }
+
+        std::ifstream script;
+        if (!script_path.empty()) {
+            script.open(script_path);
+            if (!script) {
+                std::cerr << "Failed to open script " << script_path << "\n";
+                return 1;
+            }
+        }
+
+        TraceRecorder trace;
+        if (!trace_path.empty()) {
+            if (!trace.open(trace_path, {disk.block_size(), disk.number_of_blocks(), fs.max_inodes()})) {
+                std::cerr << "Failed to open trace file " << trace_path << "\n";
+                return 1;
+            }
+            fs.set_trace(&trace);
+        }
+
+        const int failures = run_batch(fs, script_path.empty() ? std::cin : script, std::cout, std::cerr, BatchOptions{});
+        fs.set_trace(nullptr);
+        trace.close();
+        if (!stats_path.empty()) {
+            fs.dump_stats_json(stats_path);
+        }
+        disk.close();
+        return failures == 0 ? 0 : 2;
+    }
 
     // Try to mount; if it fails, initialize then mount again
     if (!fs.mount()) {
@@ -48,8 +150,25 @@ int main() {
         }
     }
 
+    // Starts after the setup above, so the trace replays against a copy of the image as it is now
+    TraceRecorder trace;
+    if (!trace_path.empty()) {
+        if (!trace.open(trace_path, {disk.block_size(), disk.number_of_blocks(), fs.max_inodes()})) {
+            std::cerr << "Failed to open trace file " << trace_path << "\n";
+            return 1;
+        }
+        fs.set_trace(&trace);
+    }
+
     run_tui(fs);
 
+    fs.set_trace(nullptr);
+    trace.close();
+
+    if (!stats_path.empty()) {
+        fs.dump_stats_json(stats_path);
+    }
+
     disk.close();
     return 0;
 }
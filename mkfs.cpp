@@ -0,0 +1,169 @@
+// Formats a new image with the given geometry, for TermExplorer and the other tools to open. The image
+// is created sparse and only the metadata blocks are written, so the time taken depends on the inode
+// count rather than on the size of the image.
+#include "disk.hpp"
+#include "filesystem.hpp"
+#include "name_index.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace {
+
+struct MkfsOptions {
+    std::string image{};
+    int block_size{4096};
+    int blocks{0};
+    int inodes{0};     // one per 16 blocks when left at 0
+    bool force{false};
+};
+
+void print_usage() {
+    std::cerr << "usage: TermExplorerMkfs IMAGE (--blocks N | --size BYTES[K|M|G]) [--block-size N] [--inodes N] [--force]\n";
+}
+
+// 64M, 2G, ... as bytes, 0 if malformed
+int64_t parse_size(const std::string& value) {
+    char* end = nullptr;
+    const long long number = std::strtoll(value.c_str(), &end, 10);
+    if (number <= 0 || end == value.c_str()) {
+        return 0;
+    }
+
+    const std::string suffix(end);
+    int shift = 0;
+    if (suffix == "K" || suffix == "k") shift = 10;
+    else if (suffix == "M" || suffix == "m") shift = 20;
+    else if (suffix == "G" || suffix == "g") shift = 30;
+    else if (!suffix.empty()) return 0;
+    return static_cast<int64_t>(number) << shift;
+}
+
+bool parse_options(int argc, char** argv, MkfsOptions& options) {
+    int64_t size = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--force") {
+            options.force = true;
+        } else if (arg == "--size" && i + 1 < argc) {
+            size = parse_size(argv[++i]);
+            if (size <= 0) {
+                std::cerr << "mkfs: invalid size " << argv[i] << "\n";
+                return false;
+            }
+        } else if ((arg == "--blocks" || arg == "--block-size" || arg == "--inodes") && i + 1 < argc) {
+            int& target = arg == "--blocks" ? options.blocks : arg == "--block-size" ? options.block_size : options.inodes;
+            const long long value = std::strtoll(argv[++i], nullptr, 10);
+            if (value < 0 || value > INT32_MAX) {
+                std::cerr << "mkfs: " << arg << " must be between 0 and " << INT32_MAX << "\n";
+                return false;
+            }
+            target = static_cast<int>(value);
+        } else if (!arg.empty() && arg[0] != '-' && options.image.empty()) {
+            options.image = arg;
+        } else {
+            std::cerr << "mkfs: unexpected argument " << arg << "\n";
+            return false;
+        }
+    }
+    if (options.image.empty()) {
+        return false;
+    }
+
+    // Block numbers must fit an index block and a directory block must hold its entries
+    if (options.block_size < 512 || options.block_size % 4 != 0) {
+        std::cerr << "mkfs: block size must be a multiple of 4, at least 512\n";
+        return false;
+    }
+    if (size > 0) {
+        const int64_t blocks = size / options.block_size;
+        if (blocks > INT32_MAX) {
+            std::cerr << "mkfs: at most " << INT32_MAX << " blocks\n";
+            return false;
+        }
+        options.blocks = static_cast<int>(blocks);
+    }
+    if (options.blocks < 64) {
+        std::cerr << "mkfs: need --blocks or --size, at least 64 blocks\n";
+        return false;
+    }
+    if (options.inodes == 0) {
+        options.inodes = std::max(16, options.blocks / 16);
+    }
+    if (options.inodes < 1) {
+        std::cerr << "mkfs: invalid inode count\n";
+        return false;
+    }
+
+    // The inode table is moved as one array and every metadata block number is an int
+    const int64_t inode_table_bytes = static_cast<int64_t>(options.inodes) * static_cast<int64_t>(sizeof(Inode));
+    if (inode_table_bytes > INT32_MAX) {
+        std::cerr << "mkfs: " << options.inodes << " inodes need a " << inode_table_bytes << " byte inode table, at most "
+                  << INT32_MAX << " bytes\n";
+        return false;
+    }
+    const int64_t block_size = options.block_size;
+    const int64_t bits_per_block = block_size * 8;
+    const int64_t records_per_block = block_size / static_cast<int64_t>(sizeof(NameRecord));
+    const int64_t metadata_blocks = 1 + (inode_table_bytes + block_size - 1) / block_size +
+                                    (options.blocks + bits_per_block - 1) / bits_per_block +
+                                    (options.inodes + records_per_block - 1) / records_per_block;
+    if (metadata_blocks >= options.blocks) {
+        std::cerr << "mkfs: " << options.inodes << " inodes need " << metadata_blocks << " metadata blocks, the image has "
+                  << options.blocks << "\n";
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    MkfsOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    // A fresh file is what makes the format sparse; an existing image is only replaced on request
+    if (std::filesystem::exists(options.image)) {
+        if (!options.force) {
+            std::cerr << "mkfs: " << options.image << " exists, pass --force to overwrite it\n";
+            return 1;
+        }
+        std::error_code error;
+        std::filesystem::remove(options.image, error);
+        if (error) {
+            std::cerr << "mkfs: cannot remove " << options.image << ": " << error.message() << "\n";
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    Disk disk(options.blocks, options.block_size);
+    if (!disk.open(options.image)) {
+        std::cerr << "mkfs: cannot create " << options.image << "\n";
+        return 1;
+    }
+
+    FileSystem fs(disk, options.inodes);
+    if (!fs.initialize()) {
+        std::cerr << "mkfs: failed to format " << options.image << "\n";
+        disk.close();
+        return 1;
+    }
+    disk.close();
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const Superblock& superblock = fs.superblock();
+    std::cout << options.image << ": " << superblock.total_blocks << " blocks of " << superblock.block_size << " bytes ("
+              << static_cast<int64_t>(superblock.total_blocks) * superblock.block_size / (1 << 20) << " MB), "
+              << superblock.max_inodes << " inodes, data from block " << superblock.data_region_start << ", formatted in "
+              << ms << " ms\n";
+    return 0;
+}
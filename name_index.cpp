@@ -0,0 +1,190 @@
+#include "name_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+void NameIndex::reset(int max_inodes) {
+    NameRecord empty{};
+    std::memset(empty.name, 0, sizeof(empty.name));
+
+    m_records.assign(max_inodes, empty);
+    m_postings.clear();
+    m_generation++;
+}
+
+bool NameIndex::contains(int inode_index) const {
+    if (inode_index < 0 || inode_index >= static_cast<int>(m_records.size())) {
+        return false;
+    }
+    return m_records[inode_index].name[0] != '\0';
+}
+
+void NameIndex::insert(int inode_index, int parent_inode, std::string_view name) {
+    if (inode_index < 0 || inode_index >= static_cast<int>(m_records.size())) {
+        return;
+    }
+
+    if (contains(inode_index)) {
+        remove_postings(inode_index);
+    }
+
+    NameRecord& record = m_records[inode_index];
+    record.parent_inode = parent_inode;
+    std::memset(record.name, 0, sizeof(record.name));
+    std::memcpy(record.name, name.data(), std::min(name.size(), sizeof(record.name) - 1));
+
+    add_postings(inode_index);
+    m_generation++;
+}
+
+void NameIndex::remove(int inode_index) {
+    if (!contains(inode_index)) {
+        return;
+    }
+    remove_postings(inode_index);
+
+    NameRecord& record = m_records[inode_index];
+    record.parent_inode = -1;
+    std::memset(record.name, 0, sizeof(record.name));
+    m_generation++;
+}
+
+void NameIndex::rebuild_postings() {
+    m_postings.clear();
+    for (int i = 0; i < static_cast<int>(m_records.size()); ++i) {
+        // Records read from disk are not trusted to be terminated
+        m_records[i].name[sizeof(m_records[i].name) - 1] = '\0';
+        if (contains(i)) {
+            add_postings(i);
+        }
+    }
+    m_generation++;
+}
+
+std::vector<uint32_t> NameIndex::trigrams_of(const char* name, size_t length) {
+    std::vector<uint32_t> out;
+    if (length < 3) {
+        return out;
+    }
+
+    out.reserve(length - 2);
+    for (size_t i = 0; i + 2 < length; ++i) {
+        uint32_t key = static_cast<uint32_t>(static_cast<unsigned char>(name[i])) << 16
+                     | static_cast<uint32_t>(static_cast<unsigned char>(name[i + 1])) << 8
+                     | static_cast<uint32_t>(static_cast<unsigned char>(name[i + 2]));
+        out.push_back(key);
+    }
+
+    // A name like "aaaa" repeats trigrams, each inode is only posted once per trigram
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+void NameIndex::add_postings(int inode_index) {
+    const NameRecord& record = m_records[inode_index];
+    for (uint32_t key : trigrams_of(record.name, std::strlen(record.name))) {
+        std::vector<int>& list = m_postings[key];
+        auto it = std::lower_bound(list.begin(), list.end(), inode_index);
+        if (it == list.end() || *it != inode_index) {
+            list.insert(it, inode_index);
+        }
+    }
+}
+
+void NameIndex::remove_postings(int inode_index) {
+    const NameRecord& record = m_records[inode_index];
+    for (uint32_t key : trigrams_of(record.name, std::strlen(record.name))) {
+        auto found = m_postings.find(key);
+        if (found == m_postings.end()) {
+            continue;
+        }
+
+        std::vector<int>& list = found->second;
+        auto it = std::lower_bound(list.begin(), list.end(), inode_index);
+        if (it != list.end() && *it == inode_index) {
+            list.erase(it);
+        }
+        if (list.empty()) {
+            m_postings.erase(found);
+        }
+    }
+}
+
+std::string NameIndex::path_of(int inode_index) const {
+    std::string path;
+    path_of(inode_index, path);
+    return path;
+}
+
+void NameIndex::path_of(int inode_index, std::string& out) const {
+    // Two walks up to the root: the first sizes the path, the second fills it in from the end.
+    // The step limit guards against cycles in a corrupt image.
+    const int max_steps = static_cast<int>(m_records.size());
+    size_t length = 0;
+    int current = inode_index;
+    for (int steps = 0; contains(current) && steps < max_steps; ++steps) {
+        length += 1 + std::strlen(m_records[current].name);
+        current = m_records[current].parent_inode;
+    }
+
+    if (length == 0) {
+        out.assign("/");
+        return;
+    }
+
+    out.resize(length);
+    current = inode_index;
+    for (int steps = 0; contains(current) && steps < max_steps; ++steps) {
+        const size_t name_length = std::strlen(m_records[current].name);
+        length -= name_length;
+        std::memcpy(&out[length], m_records[current].name, name_length);
+        out[--length] = '/';
+        current = m_records[current].parent_inode;
+    }
+}
+
+std::vector<int> NameIndex::find_substring(const std::string& pattern) const {
+    std::vector<int> results;
+
+    // Patterns shorter than a trigram can't use the posting lists, scan the in-memory names instead
+    if (pattern.size() < 3) {
+        for (int i = 0; i < static_cast<int>(m_records.size()); ++i) {
+            if (contains(i) && std::strstr(m_records[i].name, pattern.c_str()) != nullptr) {
+                results.push_back(i);
+            }
+        }
+        return results;
+    }
+
+    std::vector<const std::vector<int>*> lists;
+    for (uint32_t key : trigrams_of(pattern.data(), pattern.size())) {
+        auto found = m_postings.find(key);
+        if (found == m_postings.end()) {
+            return results;
+        }
+        lists.push_back(&found->second);
+    }
+
+    // Intersect shortest lists first so the candidate set shrinks as fast as possible
+    std::sort(lists.begin(), lists.end(), [](const std::vector<int>* a, const std::vector<int>* b) {
+        return a->size() < b->size();
+    });
+
+    std::vector<int> candidates = *lists.front();
+    std::vector<int> scratch;
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        scratch.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(scratch));
+        candidates.swap(scratch);
+    }
+
+    // Sharing every trigram doesn't guarantee the trigrams are adjacent, verify each candidate
+    for (int inode_index : candidates) {
+        if (std::strstr(m_records[inode_index].name, pattern.c_str()) != nullptr) {
+            results.push_back(inode_index);
+        }
+    }
+    return results;
+}
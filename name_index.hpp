@@ -0,0 +1,55 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// On-disk record describing where an inode is linked: its parent directory and its name.
+// Packed so that a whole number of records fits in a block.
+struct NameRecord {
+    int parent_inode{-1};
+    char name[56];
+};
+
+// In-memory trigram index over entry names. The name records are persisted by the FileSystem,
+// the posting lists are derived from them and only ever live in memory.
+class NameIndex {
+public:
+    void reset(int max_inodes);
+
+    void insert(int inode_index, int parent_inode, std::string_view name);
+    void remove(int inode_index);
+
+    bool contains(int inode_index) const;
+    int size() const { return static_cast<int>(m_records.size()); };
+
+    // Bumped on every change, lets callers tell whether something derived from the index is stale
+    uint64_t generation() const { return m_generation; };
+
+    const NameRecord& record(int inode_index) const { return m_records[inode_index]; };
+    std::vector<NameRecord>& records() { return m_records; };
+
+    // Rebuilds every posting list from m_records (used after loading records from disk)
+    void rebuild_postings();
+
+    std::string path_of(int inode_index) const;
+    // Same, written into out so a loop over many inodes can keep reusing one buffer
+    void path_of(int inode_index, std::string& out) const;
+
+    // Inodes whose name contains pattern, in ascending inode order
+    std::vector<int> find_substring(const std::string& pattern) const;
+
+private:
+    std::vector<NameRecord> m_records{};
+    std::unordered_map<uint32_t, std::vector<int>> m_postings{};
+    uint64_t m_generation{0};
+
+    static std::vector<uint32_t> trigrams_of(const char* name, size_t length);
+    void add_postings(int inode_index);
+    void remove_postings(int inode_index);
+};
+
+#endif
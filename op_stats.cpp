@@ -0,0 +1,155 @@
+#include "op_stats.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Threads are dealt shards round robin the first time they record anything
+int shard_of_this_thread() {
+    static std::atomic<int> next{0};
+    thread_local const int shard = next.fetch_add(1, std::memory_order_relaxed) % OpStats::SHARDS;
+    return shard;
+}
+
+}
+
+const char* op_name(Op op) {
+    switch (op) {
+    case Op::RESOLVE_PATH: return "resolve_path";
+    case Op::CREATE_FILE: return "create_file";
+    case Op::WRITE_FILE: return "write_file";
+    case Op::READ_FILE: return "read_file";
+    case Op::SEARCH: return "search";
+    case Op::ALLOCATE_BLOCK: return "allocate_block";
+    case Op::DISK_READ: return "disk_read_block";
+    case Op::DISK_WRITE: return "disk_write_block";
+    case Op::COUNT: break;
+    }
+    return "unknown";
+}
+
+const OpSummary* StatsSnapshot::find(Op op) const {
+    for (const OpSummary& summary : ops) {
+        if (summary.op == op)
+            return &summary;
+    }
+    return nullptr;
+}
+
+std::string StatsSnapshot::to_json() const {
+    std::string json = "{";
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const OpSummary& s = ops[i];
+        if (i > 0)
+            json += ",";
+        json += "\n  \"" + std::string(op_name(s.op)) + "\": {"
+              + "\"count\": " + std::to_string(s.count)
+              + ", \"total_ns\": " + std::to_string(s.total_ns)
+              + ", \"p50_ns\": " + std::to_string(s.p50_ns)
+              + ", \"p90_ns\": " + std::to_string(s.p90_ns)
+              + ", \"p99_ns\": " + std::to_string(s.p99_ns)
+              + ", \"max_ns\": " + std::to_string(s.max_ns)
+              + ", \"last_ns\": " + std::to_string(s.last_ns) + "}";
+    }
+    json += ops.empty() ? "}\n" : "\n}\n";
+    return json;
+}
+
+OpStats::OpStats() : m_shards(new Shard[OP_COUNT * SHARDS]) {
+    for (auto& last : m_last_ns) {
+        last.store(-1, std::memory_order_relaxed);
+    }
+}
+
+int OpStats::bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return static_cast<int>(ns);
+    }
+
+    int exponent = 0;
+    for (uint64_t v = ns; v > 1; v >>= 1) {
+        ++exponent;
+    }
+    if (exponent > MAX_EXPONENT) {
+        return BUCKETS - 1;
+    }
+
+    // The top SUB_BUCKET_BITS bits below the leading one pick the sub-bucket
+    const int sub = static_cast<int>(ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t OpStats::bucket_limit(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+
+    const int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const int sub = bucket % SUB_BUCKETS;
+    const uint64_t width = uint64_t{1} << (exponent - SUB_BUCKET_BITS);
+    return (uint64_t{1} << exponent) + (sub + 1) * width - 1;
+}
+
+void OpStats::record(Op op, std::chrono::nanoseconds elapsed) {
+    const uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(0, elapsed.count()));
+    Shard& shard = m_shards[static_cast<int>(op) * SHARDS + shard_of_this_thread()];
+
+    shard.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.total_ns.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = shard.max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !shard.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+    m_last_ns[static_cast<int>(op)].store(static_cast<int64_t>(ns), std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds OpStats::last(Op op) const {
+    return std::chrono::nanoseconds(m_last_ns[static_cast<int>(op)].load(std::memory_order_relaxed));
+}
+
+StatsSnapshot OpStats::snapshot() const {
+    StatsSnapshot snapshot;
+    std::vector<uint64_t> buckets(BUCKETS);
+
+    for (int o = 0; o < OP_COUNT; ++o) {
+        OpSummary summary;
+        summary.op = static_cast<Op>(o);
+        std::fill(buckets.begin(), buckets.end(), 0);
+
+        // Shards are read without stopping writers, so a snapshot may be a few calls behind on some of them
+        for (int s = 0; s < SHARDS; ++s) {
+            const Shard& shard = m_shards[o * SHARDS + s];
+            summary.count += shard.count.load(std::memory_order_relaxed);
+            summary.total_ns += shard.total_ns.load(std::memory_order_relaxed);
+            summary.max_ns = std::max(summary.max_ns, shard.max_ns.load(std::memory_order_relaxed));
+            for (int b = 0; b < BUCKETS; ++b) {
+                buckets[b] += shard.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        if (summary.count == 0) {
+            continue;
+        }
+
+        uint64_t bucketed = 0;
+        for (uint64_t n : buckets) {
+            bucketed += n;
+        }
+        auto percentile = [&](uint64_t per_mille) {
+            const uint64_t rank = std::max<uint64_t>(1, (bucketed * per_mille + 999) / 1000);
+            uint64_t seen = 0;
+            for (int b = 0; b < BUCKETS; ++b) {
+                seen += buckets[b];
+                if (seen >= rank)
+                    return std::min(bucket_limit(b), summary.max_ns);
+            }
+            return summary.max_ns;
+        };
+        summary.p50_ns = percentile(500);
+        summary.p90_ns = percentile(900);
+        summary.p99_ns = percentile(990);
+        summary.last_ns = static_cast<uint64_t>(std::max<int64_t>(0, last(summary.op).count()));
+        snapshot.ops.push_back(summary);
+    }
+    return snapshot;
+}
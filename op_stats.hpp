@@ -0,0 +1,101 @@
+#ifndef OP_STATS_H
+#define OP_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Operations timed by FileSystem and Disk
+enum class Op {
+    RESOLVE_PATH,
+    CREATE_FILE,
+    WRITE_FILE,     // write_file and write_file_range
+    READ_FILE,      // read_file and read_file_range
+    SEARCH,         // every search kind, streaming or not
+    ALLOCATE_BLOCK,
+    DISK_READ,
+    DISK_WRITE,
+    COUNT
+};
+
+constexpr int OP_COUNT = static_cast<int>(Op::COUNT);
+
+const char* op_name(Op op);
+
+struct OpSummary {
+    Op op{};
+    uint64_t count{};
+    uint64_t total_ns{};
+    uint64_t p50_ns{};
+    uint64_t p90_ns{};
+    uint64_t p99_ns{};
+    uint64_t max_ns{};
+    uint64_t last_ns{};
+};
+
+// Point-in-time copy of the counters, one entry per operation that has run at least once
+struct StatsSnapshot {
+    std::vector<OpSummary> ops{};
+
+    const OpSummary* find(Op op) const;
+    std::string to_json() const;
+};
+
+// Call counts and latency histograms per operation, cheap enough to leave on in production: recording
+// is a handful of relaxed atomic adds on a shard chosen once per thread, so threads rarely share a line.
+// The histograms are log-linear (HDR style) with 8 sub-buckets per power of two, so reported
+// percentiles are within 12.5% of the true value.
+class OpStats {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // Latencies past 2^40 ns (about 18 minutes) land in the last bucket
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr int BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+    static constexpr int SHARDS = 4;
+
+    OpStats();
+
+    void record(Op op, std::chrono::nanoseconds elapsed);
+
+    // Latency of the most recent call, -1 if there was none yet
+    std::chrono::nanoseconds last(Op op) const;
+
+    StatsSnapshot snapshot() const;
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+    };
+
+    // OP_COUNT * SHARDS shards, on the heap since they are tens of kilobytes
+    std::unique_ptr<Shard[]> m_shards;
+    std::array<std::atomic<int64_t>, OP_COUNT> m_last_ns{};
+
+    static int bucket_of(uint64_t ns);
+    static uint64_t bucket_limit(int bucket);
+};
+
+// Records the time from construction to destruction as one call of op
+class OpTimer {
+public:
+    OpTimer(OpStats& stats, Op op) : m_stats(stats), m_op(op), m_start(std::chrono::steady_clock::now()) {};
+    ~OpTimer() { m_stats.record(m_op, std::chrono::steady_clock::now() - m_start); };
+
+    OpTimer(const OpTimer&) = delete;
+    OpTimer& operator=(const OpTimer&) = delete;
+
+private:
+    OpStats& m_stats;
+    Op m_op;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "path_pattern.hpp"
+
+#include <cstring>
+
+namespace {
+
+// Matches one [...] class starting at pattern[p] (just past the '['), advancing p past the ']'
+bool match_class(std::string_view pattern, size_t& p, char c) {
+    bool negate = false;
+    if (p < pattern.size() && (pattern[p] == '!' || pattern[p] == '^')) {
+        negate = true;
+        ++p;
+    }
+
+    bool matched = false;
+    bool first = true;
+    while (p < pattern.size() && (pattern[p] != ']' || first)) {
+        char low = pattern[p];
+        char high = low;
+        if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']') {
+            high = pattern[p + 2];
+            p += 2;
+        }
+        if (c >= low && c <= high) {
+            matched = true;
+        }
+        ++p;
+        first = false;
+    }
+    ++p; // skip ']'
+    return matched != negate;
+}
+
+bool is_valid_glob(std::string_view pattern) {
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == '\\') {
+            ++i;
+        } else if (pattern[i] == '[') {
+            size_t close = i + 1;
+            if (close < pattern.size() && (pattern[close] == '!' || pattern[close] == '^'))
+                ++close;
+            if (close < pattern.size() && pattern[close] == ']')
+                ++close;
+            close = pattern.find(']', close);
+            if (close == std::string_view::npos) {
+                return false;
+            }
+            i = close;
+        }
+    }
+    return true;
+}
+
+}
+
+bool GlobSegment::matches(std::string_view name) const {
+    if (kind == GlobSegmentKind::GLOBSTAR) {
+        return true;
+    }
+    if (kind == GlobSegmentKind::LITERAL) {
+        return name == text;
+    }
+
+    std::string_view pattern = text;
+    size_t p = 0;
+    size_t n = 0;
+
+    // Last '*' seen and the name position it was tried at, for backtracking
+    size_t star_p = std::string_view::npos;
+    size_t star_n = 0;
+
+    while (n < name.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+            if (pc == '*') {
+                star_p = ++p;
+                star_n = n;
+                continue;
+            }
+            if (pc == '?') {
+                ++p;
+                ++n;
+                continue;
+            }
+            if (pc == '[') {
+                size_t next = p + 1;
+                if (match_class(pattern, next, name[n])) {
+                    p = next;
+                    ++n;
+                    continue;
+                }
+            } else {
+                if (pc == '\\' && p + 1 < pattern.size()) {
+                    pc = pattern[p + 1];
+                    if (pc == name[n]) {
+                        p += 2;
+                        ++n;
+                        continue;
+                    }
+                } else if (pc == name[n]) {
+                    ++p;
+                    ++n;
+                    continue;
+                }
+            }
+        }
+
+        if (star_p == std::string_view::npos) {
+            return false;
+        }
+        // Let the last '*' swallow one more character and retry
+        p = star_p;
+        n = ++star_n;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+bool GlobPattern::compile(const std::string& pattern) {
+    m_segments.clear();
+    m_anchored = pattern.find('/') != std::string::npos;
+
+    size_t start = 0;
+    while (start <= pattern.size()) {
+        size_t end = pattern.find('/', start);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+
+        std::string_view part(pattern.data() + start, end - start);
+        start = end + 1;
+        if (part.empty()) {
+            continue;
+        }
+        if (!is_valid_glob(part)) {
+            return false;
+        }
+
+        GlobSegment segment;
+        segment.text = std::string(part);
+        if (part == "**") {
+            // Consecutive globstars behave like one and would only multiply the walk
+            if (!m_segments.empty() && m_segments.back().kind == GlobSegmentKind::GLOBSTAR) {
+                continue;
+            }
+            segment.kind = GlobSegmentKind::GLOBSTAR;
+        } else if (part.find_first_of("*?[\\") != std::string_view::npos) {
+            segment.kind = GlobSegmentKind::WILDCARD;
+        } else {
+            segment.kind = GlobSegmentKind::LITERAL;
+        }
+        m_segments.push_back(std::move(segment));
+    }
+    return !m_segments.empty();
+}
+
+std::string regex_literal_prefix(const std::string& pattern) {
+    if (pattern.size() < 2 || pattern[0] != '^' || pattern[1] != '/') {
+        return "";
+    }
+    // With an alternation the anchor only binds the first branch
+    if (pattern.find('|') != std::string::npos) {
+        return "";
+    }
+
+    std::string prefix;
+    for (size_t i = 1; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (std::strchr(".[]()*+?{}|\\^$", c) != nullptr) {
+            // A quantifier makes the character before it optional
+            if ((c == '*' || c == '?' || c == '{') && !prefix.empty()) {
+                prefix.pop_back();
+            }
+            break;
+        }
+        prefix.push_back(c);
+    }
+    return prefix;
+}
@@ -0,0 +1,40 @@
+#ifndef PATH_PATTERN_H
+#define PATH_PATTERN_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class GlobSegmentKind {
+    LITERAL,  // no wildcards, can be looked up directly
+    WILDCARD, // contains *, ? or [...]
+    GLOBSTAR  // "**", zero or more directories
+};
+
+struct GlobSegment {
+    GlobSegmentKind kind{GlobSegmentKind::LITERAL};
+    std::string text;
+
+    bool matches(std::string_view name) const;
+};
+
+// Glob compiled once per query into per-directory segments.
+// A pattern without '/' matches entry names at any depth ("*.md"),
+// a pattern with '/' is anchored at the root ("docs/**/readme*").
+class GlobPattern {
+public:
+    bool compile(const std::string& pattern);
+
+    bool anchored() const { return m_anchored; };
+    int segment_count() const { return static_cast<int>(m_segments.size()); };
+    const GlobSegment& segment(int index) const { return m_segments[index]; };
+
+private:
+    bool m_anchored{false};
+    std::vector<GlobSegment> m_segments{};
+};
+
+// Literal text every match of a "^/..." regex must start with, empty if there is none
+std::string regex_literal_prefix(const std::string& pattern);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PATH_VIEW_H
+#define PATH_VIEW_H
+
+#include <algorithm>
+#include <string_view>
+
+// Walks the components of a '/' separated path in place, without copying any of it.
+// Leading, trailing and repeated slashes yield no empty components: "/a//b/" gives "a", then "b".
+class PathCursor {
+public:
+    explicit PathCursor(std::string_view path) : m_rest(path) {};
+
+    // Stores the next component in component, false once the path is used up
+    bool next(std::string_view& component) {
+        skip_slashes();
+        if (m_rest.empty()) {
+            return false;
+        }
+        const size_t end = std::min(m_rest.find('/'), m_rest.size());
+        component = m_rest.substr(0, end);
+        m_rest.remove_prefix(end);
+        return true;
+    }
+
+    // True when no components are left
+    bool done() {
+        skip_slashes();
+        return m_rest.empty();
+    }
+
+private:
+    std::string_view m_rest;
+
+    void skip_slashes() {
+        while (!m_rest.empty() && m_rest.front() == '/') {
+            m_rest.remove_prefix(1);
+        }
+    }
+};
+
+// "/a/b/c" -> parent "/a/b", leaf "c". Leaf is empty when the path has no components.
+inline void split_leaf(std::string_view path, std::string_view& parent, std::string_view& leaf) {
+    while (!path.empty() && path.back() == '/') {
+        path.remove_suffix(1);
+    }
+    const size_t slash = path.rfind('/');
+    if (slash == std::string_view::npos) {
+        parent = {};
+        leaf = path;
+    } else {
+        parent = path.substr(0, slash);
+        leaf = path.substr(slash + 1);
+    }
+}
+
+#endif
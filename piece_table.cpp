@@ -0,0 +1,244 @@
+#include "piece_table.hpp"
+
+#include <algorithm>
+
+void PieceTable::load(std::string original) {
+    m_original = std::move(original);
+    m_added.clear();
+    m_pieces.clear();
+    m_undo.clear();
+    m_redo.clear();
+    m_size = m_original.size();
+    m_saved_size = m_size;
+    m_hint_piece = 0;
+    m_hint_offset = 0;
+
+    if (m_size > 0) {
+        m_pieces.push_back({Source::ORIGINAL, 0, m_size, 0});
+    }
+}
+
+const char* PieceTable::data_of(const Piece& piece) const {
+    return (piece.source == Source::ORIGINAL ? m_original.data() : m_added.data()) + piece.start;
+}
+
+char PieceTable::at(size_t pos) const {
+    if (pos >= m_size) {
+        return '\0';
+    }
+
+    if (m_hint_piece >= m_pieces.size() || pos < m_hint_offset) {
+        m_hint_piece = 0;
+        m_hint_offset = 0;
+    }
+    while (pos >= m_hint_offset + m_pieces[m_hint_piece].length) {
+        m_hint_offset += m_pieces[m_hint_piece].length;
+        ++m_hint_piece;
+    }
+    return data_of(m_pieces[m_hint_piece])[pos - m_hint_offset];
+}
+
+std::string PieceTable::text(size_t pos, size_t length) const {
+    std::string out;
+    length = std::min(length, m_size - std::min(pos, m_size));
+    out.reserve(length);
+
+    size_t offset = 0;
+    for (const Piece& piece : m_pieces) {
+        if (out.size() == length)
+            break;
+        if (pos < offset + piece.length) {
+            const size_t from = pos > offset ? pos - offset : 0;
+            const size_t take = std::min(piece.length - from, length - out.size());
+            out.append(data_of(piece) + from, take);
+        }
+        offset += piece.length;
+    }
+    return out;
+}
+
+size_t PieceTable::split(size_t pos) {
+    size_t offset = 0;
+    for (size_t i = 0; i < m_pieces.size(); ++i) {
+        if (offset == pos)
+            return i;
+
+        const Piece piece = m_pieces[i];
+        if (pos < offset + piece.length) {
+            const size_t head = pos - offset;
+            Piece tail = piece;
+            tail.start += head;
+            tail.length -= head;
+            if (tail.saved_offset >= 0)
+                tail.saved_offset += static_cast<int64_t>(head);
+
+            m_pieces[i].length = head;
+            m_pieces.insert(m_pieces.begin() + i + 1, tail);
+            return i + 1;
+        }
+        offset += piece.length;
+    }
+    return m_pieces.size();
+}
+
+void PieceTable::apply_insert(size_t pos, const std::vector<Piece>& pieces, size_t length) {
+    if (pieces.empty())
+        return;
+    pos = std::min(pos, m_size);
+    m_hint_piece = 0;
+    m_hint_offset = 0;
+
+    const size_t index = split(pos);
+    m_pieces.insert(m_pieces.begin() + index, pieces.begin(), pieces.end());
+    m_size += length;
+}
+
+std::vector<PieceTable::Piece> PieceTable::apply_erase(size_t pos, size_t length) {
+    pos = std::min(pos, m_size);
+    length = std::min(length, m_size - pos);
+    if (length == 0)
+        return {};
+    m_hint_piece = 0;
+    m_hint_offset = 0;
+
+    const size_t first = split(pos);
+    const size_t last = split(pos + length);
+    std::vector<Piece> removed(m_pieces.begin() + first, m_pieces.begin() + last);
+    m_pieces.erase(m_pieces.begin() + first, m_pieces.begin() + last);
+    m_size -= length;
+    return removed;
+}
+
+void PieceTable::record(Edit edit) {
+    m_redo.clear();
+
+    // Runs of typing or deleting undo as one step; a newline ends the run
+    if (!m_undo.empty() && !edit.has_newline && !m_undo.back().has_newline) {
+        Edit& last = m_undo.back();
+        if (last.inserted && edit.inserted && edit.pos == last.pos + last.length) {
+            last.pieces.insert(last.pieces.end(), edit.pieces.begin(), edit.pieces.end());
+            last.length += edit.length;
+            return;
+        }
+        if (!last.inserted && !edit.inserted && edit.pos + edit.length == last.pos) { // backspace
+            last.pieces.insert(last.pieces.begin(), edit.pieces.begin(), edit.pieces.end());
+            last.pos = edit.pos;
+            last.length += edit.length;
+            return;
+        }
+        if (!last.inserted && !edit.inserted && edit.pos == last.pos) { // delete
+            last.pieces.insert(last.pieces.end(), edit.pieces.begin(), edit.pieces.end());
+            last.length += edit.length;
+            return;
+        }
+    }
+    m_undo.push_back(std::move(edit));
+}
+
+void PieceTable::insert(size_t pos, std::string_view text) {
+    pos = std::min(pos, m_size);
+    if (text.empty())
+        return;
+
+    Piece piece{Source::ADDED, m_added.size(), text.size(), -1};
+    m_added.append(text.data(), text.size());
+    const bool has_newline = text.find('\n') != std::string_view::npos;
+
+    // Typing right after the previous insertion extends its piece instead of adding one per keystroke
+    m_hint_piece = 0;
+    m_hint_offset = 0;
+    const size_t index = split(pos);
+    Piece* previous = index > 0 ? &m_pieces[index - 1] : nullptr;
+    if (previous && previous->source == Source::ADDED && previous->saved_offset < 0 && previous->start + previous->length == piece.start) {
+        previous->length += piece.length;
+        m_size += piece.length;
+    } else {
+        apply_insert(pos, {piece}, piece.length);
+    }
+
+    record({true, pos, text.size(), has_newline, {piece}});
+}
+
+void PieceTable::erase(size_t pos, size_t length) {
+    pos = std::min(pos, m_size);
+    length = std::min(length, m_size - pos);
+    if (length == 0)
+        return;
+
+    const bool has_newline = text(pos, length).find('\n') != std::string::npos;
+    std::vector<Piece> removed = apply_erase(pos, length);
+    record({false, pos, length, has_newline, std::move(removed)});
+}
+
+bool PieceTable::undo(size_t& cursor) {
+    if (m_undo.empty())
+        return false;
+
+    Edit edit = std::move(m_undo.back());
+    m_undo.pop_back();
+    if (edit.inserted) {
+        edit.pieces = apply_erase(edit.pos, edit.length);
+        cursor = edit.pos;
+    } else {
+        apply_insert(edit.pos, edit.pieces, edit.length);
+        cursor = edit.pos + edit.length;
+    }
+    m_redo.push_back(std::move(edit));
+    return true;
+}
+
+bool PieceTable::redo(size_t& cursor) {
+    if (m_redo.empty())
+        return false;
+
+    Edit edit = std::move(m_redo.back());
+    m_redo.pop_back();
+    if (edit.inserted) {
+        apply_insert(edit.pos, edit.pieces, edit.length);
+        cursor = edit.pos + edit.length;
+    } else {
+        edit.pieces = apply_erase(edit.pos, edit.length);
+        cursor = edit.pos;
+    }
+    m_undo.push_back(std::move(edit));
+    return true;
+}
+
+std::vector<ByteRange> PieceTable::dirty_ranges() const {
+    std::vector<ByteRange> ranges;
+    size_t offset = 0;
+    for (const Piece& piece : m_pieces) {
+        const bool clean = piece.saved_offset == static_cast<int64_t>(offset);
+        if (!clean) {
+            if (!ranges.empty() && ranges.back().offset + ranges.back().length == offset)
+                ranges.back().length += piece.length;
+            else
+                ranges.push_back({offset, piece.length});
+        }
+        offset += piece.length;
+    }
+    return ranges;
+}
+
+bool PieceTable::modified() const {
+    return m_size != m_saved_size || !dirty_ranges().empty();
+}
+
+void PieceTable::mark_saved() {
+    size_t offset = 0;
+    for (Piece& piece : m_pieces) {
+        piece.saved_offset = static_cast<int64_t>(offset);
+        offset += piece.length;
+    }
+    m_saved_size = m_size;
+
+    // Pieces waiting in the undo and redo stacks were placed against the file before this save and the
+    // save may have overwritten those bytes; once put back they have to be written again
+    for (std::vector<Edit>* stack : {&m_undo, &m_redo}) {
+        for (Edit& edit : *stack) {
+            for (Piece& piece : edit.pieces) {
+                piece.saved_offset = -1;
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef PIECE_TABLE_H
+#define PIECE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// [offset, offset + length) of the document
+struct ByteRange {
+    size_t offset{};
+    size_t length{};
+};
+
+// Editor text as a piece table: the file as loaded stays untouched in one buffer, typed text is
+// appended to another, and the document is a list of pieces pointing into either. An edit splits
+// at most one piece, so its cost depends on the number of pieces, never on the size of the file.
+//
+// Each piece also remembers where its bytes sit in the file as last saved. Bytes that are still at
+// the same offset are clean; everything else is reported by dirty_ranges() and has to be written.
+class PieceTable {
+public:
+    void load(std::string original);
+
+    size_t size() const { return m_size; };
+    char at(size_t pos) const;
+    std::string text(size_t pos, size_t length) const;
+
+    void insert(size_t pos, std::string_view text);
+    void erase(size_t pos, size_t length);
+
+    // Reverts (or reapplies) the last edit and puts cursor where it happened
+    bool undo(size_t& cursor);
+    bool redo(size_t& cursor);
+
+    // Byte ranges that differ from the file as last saved, in ascending order. Bytes past saved_size()
+    // are always included; a document shorter than the file has to be truncated on top of these.
+    std::vector<ByteRange> dirty_ranges() const;
+    size_t saved_size() const { return m_saved_size; };
+    bool modified() const;
+
+    // The document is now what the file holds. Text that undo or redo brings back counts as dirty.
+    void mark_saved();
+
+private:
+    enum class Source {
+        ORIGINAL,
+        ADDED
+    };
+
+    struct Piece {
+        Source source{Source::ORIGINAL};
+        size_t start{};
+        size_t length{};
+        int64_t saved_offset{-1}; // offset of the first byte in the saved file, -1 if not in it
+    };
+
+    // Undo entries keep the pieces themselves rather than the text, so undoing a delete puts the
+    // original bytes back (still clean) instead of a copy in the added buffer
+    struct Edit {
+        bool inserted{};
+        size_t pos{};
+        size_t length{};
+        bool has_newline{};
+        std::vector<Piece> pieces{};
+    };
+
+    std::string m_original{};
+    std::string m_added{};
+    std::vector<Piece> m_pieces{};
+    size_t m_size{};
+    size_t m_saved_size{};
+
+    std::vector<Edit> m_undo{};
+    std::vector<Edit> m_redo{};
+
+    // Last piece at() landed in, so reading consecutive bytes does not rescan the list
+    mutable size_t m_hint_piece{};
+    mutable size_t m_hint_offset{};
+
+    const char* data_of(const Piece& piece) const;
+    size_t split(size_t pos);
+    void apply_insert(size_t pos, const std::vector<Piece>& pieces, size_t length);
+    std::vector<Piece> apply_erase(size_t pos, size_t length);
+    void record(Edit edit);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "substring_search.hpp"
+#include "cpu_features.hpp"
+
+#include <cstring>
+
+#if defined(CPU_AVX2_DISPATCH) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+size_t find_substring_scalar(const char* haystack, size_t start, size_t haystack_length, const char* needle, size_t needle_length) {
+    const char first = needle[0];
+    const char last  = needle[needle_length - 1];
+
+    for (size_t i = start; i + needle_length <= haystack_length; ++i) {
+        if (haystack[i] == first && haystack[i + needle_length - 1] == last &&
+            std::memcmp(haystack + i + 1, needle + 1, needle_length > 2 ? needle_length - 2 : 0) == 0) {
+            return i;
+        }
+    }
+    return SUBSTRING_NOT_FOUND;
+}
+
+// Candidate positions are where both the first and the last needle byte line up;
+// only those get a full memcmp.
+#if defined(CPU_AVX2_DISPATCH)
+CPU_TARGET_AVX2 size_t find_substring_avx2(const char* haystack, size_t haystack_length, const char* needle, size_t needle_length) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[needle_length - 1]);
+
+    size_t i = 0;
+    for (; i + needle_length - 1 + 32 <= haystack_length; i += 32) {
+        const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        const __m256i block_last  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + needle_length - 1));
+
+        const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(eq));
+
+        while (mask != 0) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (std::memcmp(haystack + i + bit + 1, needle + 1, needle_length > 2 ? needle_length - 2 : 0) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_substring_scalar(haystack, i, haystack_length, needle, needle_length);
+}
+#endif
+
+#if defined(__SSE2__)
+size_t find_substring_sse2(const char* haystack, size_t haystack_length, const char* needle, size_t needle_length) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[needle_length - 1]);
+
+    size_t i = 0;
+    for (; i + needle_length - 1 + 16 <= haystack_length; i += 16) {
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        const __m128i block_last  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + needle_length - 1));
+
+        const __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(eq));
+
+        while (mask != 0) {
+            const unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (std::memcmp(haystack + i + bit + 1, needle + 1, needle_length > 2 ? needle_length - 2 : 0) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_substring_scalar(haystack, i, haystack_length, needle, needle_length);
+}
+#endif
+
+size_t find_substring_vector(const char* haystack, size_t haystack_length, const char* needle, size_t needle_length) {
+#if defined(CPU_AVX2_DISPATCH)
+    if (cpu_has_avx2()) {
+        return find_substring_avx2(haystack, haystack_length, needle, needle_length);
+    }
+#endif
+#if defined(__SSE2__)
+    return find_substring_sse2(haystack, haystack_length, needle, needle_length);
+#else
+    return find_substring_scalar(haystack, 0, haystack_length, needle, needle_length);
+#endif
+}
+
+}
+
+size_t find_substring(const char* haystack, size_t haystack_length, const char* needle, size_t needle_length) {
+    if (needle_length == 0) {
+        return 0;
+    }
+    if (needle_length > haystack_length) {
+        return SUBSTRING_NOT_FOUND;
+    }
+    if (needle_length == 1) {
+        const void* found = std::memchr(haystack, needle[0], haystack_length);
+        return found ? static_cast<size_t>(static_cast<const char*>(found) - haystack) : SUBSTRING_NOT_FOUND;
+    }
+    return find_substring_vector(haystack, haystack_length, needle, needle_length);
+}
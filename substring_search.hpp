@@ -0,0 +1,13 @@
+#ifndef SUBSTRING_SEARCH_H
+#define SUBSTRING_SEARCH_H
+
+#include <cstddef>
+
+constexpr size_t SUBSTRING_NOT_FOUND = static_cast<size_t>(-1);
+
+// Position of the first occurrence of needle in haystack, or SUBSTRING_NOT_FOUND.
+// Uses AVX2 (when the CPU has it, checked at run time) or SSE2 to filter candidate positions
+// on the needle's first and last byte, and a scalar loop on other targets.
+size_t find_substring(const char* haystack, size_t haystack_length, const char* needle, size_t needle_length);
+
+#endif
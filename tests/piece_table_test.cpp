@@ -0,0 +1,100 @@
+// Edits, saves and undo/redo on a PieceTable, checking after every save that writing only the dirty
+// ranges (and truncating, as the editor does) leaves the file equal to the document.
+#include "piece_table.hpp"
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAIL: " << what << "\n";
+        ++g_failures;
+    }
+}
+
+// Writes the dirty ranges over file like the editor's save does, then marks the table saved
+void save(PieceTable& table, std::string& file) {
+    for (const ByteRange& range : table.dirty_ranges()) {
+        if (file.size() < range.offset + range.length)
+            file.resize(range.offset + range.length);
+        file.replace(range.offset, range.length, table.text(range.offset, range.length));
+    }
+    if (table.size() < file.size())
+        file.resize(table.size());
+    table.mark_saved();
+}
+
+void check_saved(PieceTable& table, std::string& file, const std::string& expected, const std::string& what) {
+    check(table.text(0, table.size()) == expected, what + ": document is \"" + table.text(0, table.size()) + "\"");
+    save(table, file);
+    check(file == expected, what + ": file is \"" + file + "\"");
+    check(!table.modified(), what + ": still modified after saving");
+}
+
+void test_undo_past_save() {
+    PieceTable table;
+    std::string file = "ABCD";
+    table.load(file);
+    size_t cursor = 0;
+
+    table.erase(1, 1);
+    check_saved(table, file, "ACD", "erase");
+    check(table.undo(cursor), "undo erase");
+    check_saved(table, file, "ABCD", "undo past save");
+    check(table.redo(cursor), "redo erase");
+    check_saved(table, file, "ACD", "redo past save");
+}
+
+void test_insert_undo_redo() {
+    PieceTable table;
+    std::string file = "hello world";
+    table.load(file);
+    size_t cursor = 0;
+
+    table.insert(5, ",");
+    table.insert(0, ">> ");
+    check_saved(table, file, ">> hello, world", "inserts");
+    check(table.undo(cursor), "undo first insert");
+    check_saved(table, file, "hello, world", "undo insert past save");
+    check(table.undo(cursor), "undo second insert");
+    check_saved(table, file, "hello world", "undo both inserts");
+    check(table.redo(cursor) && table.redo(cursor), "redo both inserts");
+    check_saved(table, file, ">> hello, world", "redo both inserts");
+}
+
+void test_mixed_edits() {
+    PieceTable table;
+    std::string file = "0123456789";
+    table.load(file);
+    size_t cursor = 0;
+
+    table.erase(2, 3);
+    table.insert(4, "xy\n");
+    check_saved(table, file, "0156xy\n789", "erase and insert");
+    table.erase(0, 2);
+    check_saved(table, file, "56xy\n789", "erase front");
+    while (table.undo(cursor)) {
+    }
+    check_saved(table, file, "0123456789", "undo everything");
+    while (table.redo(cursor)) {
+    }
+    check_saved(table, file, "56xy\n789", "redo everything");
+}
+
+}
+
+int main() {
+    test_undo_past_save();
+    test_insert_undo_redo();
+    test_mixed_edits();
+    if (g_failures > 0) {
+        std::cerr << g_failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "piece table: all checks passed\n";
+    return 0;
+}
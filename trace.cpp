@@ -0,0 +1,204 @@
+#include "trace.hpp"
+#include "log.hpp"
+
+namespace {
+
+constexpr char TRACE_MAGIC[8] = {'T', 'E', 'T', 'R', 'A', 'C', 'E', '1'};
+// Records are gathered in memory and written in chunks of about this size
+constexpr size_t TRACE_BUFFER_BYTES = 64 * 1024;
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Zigzag keeps small negative numbers (handle -1, a start slightly before the previous one) short
+void put_signed(std::string& out, int64_t value) {
+    put_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+bool get_varint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int c = in.get();
+        if (c == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool get_signed(std::istream& in, int64_t& value) {
+    uint64_t raw = 0;
+    if (!get_varint(in, raw)) {
+        return false;
+    }
+    value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    return true;
+}
+
+}
+
+const char* trace_op_name(TraceOp op) {
+    switch (op) {
+        case TraceOp::CREATE_FILE: return "create_file";
+        case TraceOp::CREATE_DIRECTORY: return "create_directory";
+        case TraceOp::OPEN_FILE: return "open_file";
+        case TraceOp::CLOSE_FILE: return "close_file";
+        case TraceOp::WRITE_FILE: return "write_file";
+        case TraceOp::WRITE_FILE_RANGE: return "write_file_range";
+        case TraceOp::TRUNCATE_FILE: return "truncate_file";
+        case TraceOp::READ_FILE: return "read_file";
+        case TraceOp::READ_FILE_RANGE: return "read_file_range";
+        case TraceOp::LIST_DIRECTORY: return "list_directory";
+        case TraceOp::SEARCH: return "search";
+        case TraceOp::SEARCH_GLOB: return "search_glob";
+        case TraceOp::SEARCH_REGEX: return "search_regex";
+        case TraceOp::SEARCH_CONTENT: return "search_content";
+        case TraceOp::IMPORT_FILE: return "import_file";
+        case TraceOp::COUNT: break;
+    }
+    return "unknown";
+}
+
+TraceRecorder::~TraceRecorder() {
+    close();
+}
+
+bool TraceRecorder::open(const std::string& host_path, const TraceGeometry& geometry) {
+    close();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file.open(host_path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        LOG_ERROR("TraceRecorder: cannot open " << host_path);
+        return false;
+    }
+
+    m_buffer.assign(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    put_varint(m_buffer, geometry.block_size);
+    put_varint(m_buffer, geometry.blocks);
+    put_varint(m_buffer, geometry.max_inodes);
+    flush_buffer();
+
+    m_start = std::chrono::steady_clock::now();
+    m_last_start_ns = 0;
+    m_records = 0;
+    return true;
+}
+
+void TraceRecorder::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) {
+        return;
+    }
+    flush_buffer();
+    m_file.close();
+    LOG_INFO("TraceRecorder: wrote " << m_records << " records");
+}
+
+uint64_t TraceRecorder::now_ns() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void TraceRecorder::record(const TraceRecord& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    // Calls are written as they finish, so on a busy multi-threaded run a start can precede the last one
+    m_buffer.push_back(static_cast<char>(record.op));
+    put_signed(m_buffer, static_cast<int64_t>(record.start_ns - m_last_start_ns));
+    put_varint(m_buffer, record.duration_ns);
+    put_signed(m_buffer, record.handle);
+    put_signed(m_buffer, record.offset);
+    put_signed(m_buffer, record.length);
+    put_varint(m_buffer, record.path.size());
+    m_buffer.append(record.path);
+    m_last_start_ns = record.start_ns;
+    ++m_records;
+
+    if (m_buffer.size() >= TRACE_BUFFER_BYTES) {
+        flush_buffer();
+    }
+}
+
+void TraceRecorder::flush_buffer() {
+    m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_file.flush();
+    if (!m_file) {
+        LOG_ERROR("TraceRecorder: write failed, closing the trace");
+        m_file.close();
+    }
+    m_buffer.clear();
+}
+
+bool TraceReader::open(const std::string& host_path) {
+    m_file.open(host_path, std::ios::binary);
+    if (!m_file) {
+        LOG_ERROR("TraceReader: cannot open " << host_path);
+        return false;
+    }
+
+    char magic[sizeof(TRACE_MAGIC)];
+    uint64_t block_size = 0;
+    uint64_t blocks = 0;
+    uint64_t max_inodes = 0;
+    if (!m_file.read(magic, sizeof(magic)) || std::char_traits<char>::compare(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+        !get_varint(m_file, block_size) || !get_varint(m_file, blocks) || !get_varint(m_file, max_inodes)) {
+        LOG_ERROR("TraceReader: " << host_path << " is not a trace");
+        return false;
+    }
+
+    m_geometry = {static_cast<int>(block_size), static_cast<int>(blocks), static_cast<int>(max_inodes)};
+    m_last_start_ns = 0;
+    m_failed = false;
+    return true;
+}
+
+bool TraceReader::next(TraceRecord& out) {
+    const int op = m_file.get();
+    if (op == std::char_traits<char>::eof()) {
+        return false;
+    }
+
+    int64_t start_delta = 0;
+    int64_t handle = 0;
+    uint64_t path_length = 0;
+    if (op >= TRACE_OP_COUNT || !get_signed(m_file, start_delta) || !get_varint(m_file, out.duration_ns) ||
+        !get_signed(m_file, handle) || !get_signed(m_file, out.offset) || !get_signed(m_file, out.length) ||
+        !get_varint(m_file, path_length) || path_length > (1u << 20)) {
+        m_failed = true;
+        return false;
+    }
+
+    out.path.resize(path_length);
+    if (!m_file.read(out.path.data(), static_cast<std::streamsize>(path_length))) {
+        m_failed = true;
+        return false;
+    }
+
+    out.op = static_cast<TraceOp>(op);
+    out.handle = static_cast<int>(handle);
+    m_last_start_ns += start_delta;
+    out.start_ns = m_last_start_ns;
+    return true;
+}
+
+TraceScope::~TraceScope() {
+    if (!m_trace) {
+        return;
+    }
+
+    const uint64_t end_ns = m_trace->now_ns();
+    TraceRecord record{m_op, m_start_ns, end_ns - m_start_ns, m_handle, m_offset, m_length, std::string(m_path)};
+    m_trace->record(record);
+}
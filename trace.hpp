@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// FileSystem calls that end up in a trace. Values are stored in trace files, only ever append.
+enum class TraceOp : uint8_t {
+    CREATE_FILE,
+    CREATE_DIRECTORY,
+    OPEN_FILE,
+    CLOSE_FILE,
+    WRITE_FILE,
+    WRITE_FILE_RANGE,
+    TRUNCATE_FILE,
+    READ_FILE,
+    READ_FILE_RANGE,
+    LIST_DIRECTORY,
+    SEARCH,
+    SEARCH_GLOB,
+    SEARCH_REGEX,
+    SEARCH_CONTENT,
+    IMPORT_FILE,        // create_files_contiguous, one per file: create, then write length bytes
+    COUNT
+};
+
+constexpr int TRACE_OP_COUNT = static_cast<int>(TraceOp::COUNT);
+
+const char* trace_op_name(TraceOp op);
+
+// Geometry of the image the trace was recorded on, so a replay can format a matching one
+struct TraceGeometry {
+    int block_size{};
+    int blocks{};
+    int max_inodes{};
+};
+
+// One call. Written data is not kept, only its size; a replay writes filler bytes instead.
+struct TraceRecord {
+    TraceOp op{};
+    uint64_t start_ns{};    // since recording began
+    uint64_t duration_ns{};
+    int handle{-1};         // file index passed in, or the one open_file returned
+    int64_t offset{};
+    int64_t length{};       // bytes written, range length or truncated size
+    std::string path{};     // path, or the pattern/needle of a search
+};
+
+// Appends records to a trace file. The format is a short header followed by one varint-encoded
+// record per call, a dozen bytes or so plus the path. Safe to call from any thread.
+class TraceRecorder {
+public:
+    ~TraceRecorder();
+
+    bool open(const std::string& host_path, const TraceGeometry& geometry);
+    void close();
+    bool is_open() const { return m_file.is_open(); };
+
+    // Nanoseconds since open()
+    uint64_t now_ns() const;
+
+    void record(const TraceRecord& record);
+    uint64_t records() const { return m_records; };
+
+private:
+    std::ofstream m_file{};
+    std::mutex m_mutex{};
+    std::chrono::steady_clock::time_point m_start{};
+    std::string m_buffer{};
+    uint64_t m_last_start_ns{};
+    uint64_t m_records{};
+
+    void flush_buffer();
+};
+
+// Reads a trace back, record by record
+class TraceReader {
+public:
+    bool open(const std::string& host_path);
+    const TraceGeometry& geometry() const { return m_geometry; };
+
+    // False at the end of the trace or when a record is cut off; failed() tells the two apart
+    bool next(TraceRecord& out);
+    bool failed() const { return m_failed; };
+
+private:
+    std::ifstream m_file{};
+    TraceGeometry m_geometry{};
+    uint64_t m_last_start_ns{};
+    bool m_failed{false};
+};
+
+// Records one FileSystem call when it goes out of scope. With no recorder this is a null check.
+// path must outlive the scope, which it does as the argument of the call being traced.
+class TraceScope {
+public:
+    TraceScope(TraceRecorder* trace, TraceOp op, std::string_view path, int handle = -1, int64_t offset = 0, int64_t length = 0)
+        : m_trace(trace), m_op(op), m_path(path), m_handle(handle), m_offset(offset), m_length(length),
+          m_start_ns(trace ? trace->now_ns() : 0) {};
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    // For calls whose handle is their result (open_file)
+    void set_handle(int handle) { m_handle = handle; };
+
+private:
+    TraceRecorder* m_trace;
+    TraceOp m_op;
+    std::string_view m_path;
+    int m_handle;
+    int64_t m_offset;
+    int64_t m_length;
+    uint64_t m_start_ns;
+};
+
+#endif
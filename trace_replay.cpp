@@ -0,0 +1,235 @@
+// Replays a trace recorded with TermExplorer --trace against a fresh image or a copy of a snapshot,
+// as fast as possible or with the recorded spacing, and compares latencies with the recording.
+#include "disk.hpp"
+#include "filesystem.hpp"
+#include "log.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct ReplayOptions {
+    std::string trace{};
+    std::string snapshot{};
+    std::string image{(std::filesystem::temp_directory_path() / "termexplorer_replay.img").string()};
+    bool original_timing{false};
+    bool keep_image{false};
+};
+
+struct OpLatencies {
+    std::vector<double> recorded_us{};
+    std::vector<double> replayed_us{};
+    uint64_t failed{};
+};
+
+void print_usage() {
+    std::cerr << "usage: TermExplorerReplay TRACE [--snapshot IMAGE] [--image PATH] [--original-timing] [--keep-image]\n"
+              << "  --snapshot IMAGE   replay against a copy of IMAGE instead of a freshly formatted one\n"
+              << "  --image PATH       where the working image goes (removed afterwards unless --keep-image)\n"
+              << "  --original-timing  start each call at its recorded offset instead of back to back\n";
+}
+
+bool parse_options(int argc, char** argv, ReplayOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--original-timing") {
+            options.original_timing = true;
+        } else if (arg == "--keep-image") {
+            options.keep_image = true;
+        } else if ((arg == "--snapshot" || arg == "--image") && i + 1 < argc) {
+            (arg == "--snapshot" ? options.snapshot : options.image) = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-' && options.trace.empty()) {
+            options.trace = arg;
+        } else {
+            std::cerr << "trace_replay: unexpected argument " << arg << "\n";
+            return false;
+        }
+    }
+    return !options.trace.empty();
+}
+
+double percentile(std::vector<double>& values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+// Runs one record; handles maps the recorded file indexes to the ones this replay got from open_file
+bool replay(FileSystem& fs, const TraceRecord& record, std::unordered_map<int, int>& handles, std::string& data, std::string& out) {
+    auto handle = [&]() {
+        auto found = handles.find(record.handle);
+        return found == handles.end() ? -1 : found->second;
+    };
+    auto filler = [&](int64_t length) -> const std::string& {
+        data.assign(static_cast<size_t>(std::max<int64_t>(0, length)), 'x');
+        return data;
+    };
+
+    SearchControl control;
+    switch (record.op) {
+        case TraceOp::CREATE_FILE:
+            return fs.create_file(record.path);
+        case TraceOp::CREATE_DIRECTORY:
+            return fs.create_directory(record.path);
+        case TraceOp::OPEN_FILE: {
+            const int fd = fs.open_file(record.path);
+            if (fd >= 0 && record.handle >= 0)
+                handles[record.handle] = fd;
+            return fd >= 0;
+        }
+        case TraceOp::CLOSE_FILE: {
+            const bool ok = fs.close_file(handle());
+            handles.erase(record.handle);
+            return ok;
+        }
+        case TraceOp::WRITE_FILE:
+            return handle() >= 0 && fs.write_file(handle(), filler(record.length));
+        case TraceOp::WRITE_FILE_RANGE:
+            return handle() >= 0 && fs.write_file_range(handle(), static_cast<int>(record.offset), filler(record.length));
+        case TraceOp::TRUNCATE_FILE:
+            return fs.truncate_file(handle(), static_cast<int>(record.length));
+        case TraceOp::READ_FILE:
+            return handle() >= 0 && fs.read_file(handle(), out);
+        case TraceOp::READ_FILE_RANGE:
+            return handle() >= 0 && fs.read_file_range(handle(), static_cast<int>(record.offset), static_cast<int>(record.length), out);
+        case TraceOp::LIST_DIRECTORY: {
+            std::vector<DirectoryEntry> entries;
+            return fs.list_directory_entries(record.path, entries);
+        }
+        case TraceOp::SEARCH:
+            return fs.search(record.path, [](const std::string&) {}, control) == SearchStatus::COMPLETE;
+        case TraceOp::SEARCH_GLOB:
+            return fs.search_glob(record.path, [](const std::string&) {}, control) == SearchStatus::COMPLETE;
+        case TraceOp::SEARCH_REGEX:
+            return fs.search_regex(record.path, [](const std::string&) {}, control) == SearchStatus::COMPLETE;
+        case TraceOp::SEARCH_CONTENT:
+            return fs.search_content(record.path, [](const ContentMatch&) {}, control) == SearchStatus::COMPLETE;
+        case TraceOp::IMPORT_FILE: {
+            if (!fs.create_file(record.path)) {
+                return false;
+            }
+            const int fd = fs.open_file(record.path);
+            const bool ok = fd >= 0 && fs.write_file(fd, filler(record.length));
+            fs.close_file(fd);
+            return ok;
+        }
+        case TraceOp::COUNT:
+            break;
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    TraceReader reader;
+    if (!reader.open(options.trace)) {
+        std::cerr << "trace_replay: cannot read " << options.trace << "\n";
+        return 1;
+    }
+    const TraceGeometry& geometry = reader.geometry();
+
+    // The snapshot itself is never written to, so the same one can be replayed again
+    std::remove(options.image.c_str());
+    if (!options.snapshot.empty()) {
+        std::error_code error;
+        std::filesystem::copy_file(options.snapshot, options.image, std::filesystem::copy_options::overwrite_existing, error);
+        if (error) {
+            std::cerr << "trace_replay: cannot copy " << options.snapshot << ": " << error.message() << "\n";
+            return 1;
+        }
+    }
+
+    Disk disk(geometry.blocks, geometry.block_size);
+    if (!disk.open(options.image)) {
+        std::cerr << "trace_replay: failed to open " << options.image << "\n";
+        return 1;
+    }
+    FileSystem fs(disk, geometry.max_inodes);
+    if (options.snapshot.empty() ? !(fs.initialize() && fs.mount()) : !fs.mount()) {
+        std::cerr << "trace_replay: failed to " << (options.snapshot.empty() ? "format " : "mount ") << options.image << "\n";
+        return 1;
+    }
+
+    // Calls that failed while recording usually fail again; count them instead of logging each one
+    log_set_stderr_level(LogLevel::OFF);
+
+    std::array<OpLatencies, TRACE_OP_COUNT> latencies{};
+    std::unordered_map<int, int> handles;
+    std::string data;
+    std::string out;
+    uint64_t replayed = 0;
+    uint64_t failed = 0;
+    const uint64_t blocks_read_before = disk.blocks_read();
+    const uint64_t blocks_written_before = disk.blocks_written();
+
+    TraceRecord record;
+    const auto start = std::chrono::steady_clock::now();
+    while (reader.next(record)) {
+        if (options.original_timing) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.start_ns));
+        }
+
+        const auto call_start = std::chrono::steady_clock::now();
+        const bool ok = replay(fs, record, handles, data, out);
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - call_start).count();
+
+        OpLatencies& op = latencies[static_cast<int>(record.op)];
+        op.recorded_us.push_back(record.duration_ns / 1000.0);
+        op.replayed_us.push_back(us);
+        if (!ok) {
+            ++op.failed;
+            ++failed;
+        }
+        ++replayed;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    log_set_stderr_level(LogLevel::WARN);
+
+    if (reader.failed()) {
+        std::cerr << "trace_replay: trace is truncated or corrupt after " << replayed << " records\n";
+    }
+
+    std::cout << "replayed " << replayed << " calls (" << failed << " failed) in " << std::fixed << std::setprecision(3) << seconds << " s, "
+              << std::setprecision(0) << (seconds > 0 ? replayed / seconds : 0) << " calls/s"
+              << (options.original_timing ? " at recorded timing" : "") << "\n";
+    std::cout << "blocks read " << disk.blocks_read() - blocks_read_before << ", written " << disk.blocks_written() - blocks_written_before << "\n";
+    std::cout << std::left << std::setw(18) << "op" << std::right << std::setw(10) << "calls" << std::setw(8) << "failed"
+              << std::setw(14) << "rec p50 us" << std::setw(14) << "rec p99 us" << std::setw(14) << "p50 us" << std::setw(14) << "p99 us" << "\n";
+    for (int i = 0; i < TRACE_OP_COUNT; ++i) {
+        OpLatencies& op = latencies[i];
+        if (op.replayed_us.empty()) {
+            continue;
+        }
+        std::cout << std::left << std::setw(18) << trace_op_name(static_cast<TraceOp>(i)) << std::right
+                  << std::setw(10) << op.replayed_us.size() << std::setw(8) << op.failed << std::setprecision(2)
+                  << std::setw(14) << percentile(op.recorded_us, 50) << std::setw(14) << percentile(op.recorded_us, 99)
+                  << std::setw(14) << percentile(op.replayed_us, 50) << std::setw(14) << percentile(op.replayed_us, 99) << "\n";
+    }
+
+    disk.close();
+    if (!options.keep_image) {
+        std::remove(options.image.c_str());
+    }
+    return reader.failed() ? 1 : 0;
+}
@@ -1,32 +1,46 @@
 #include "disk.hpp"
+#include "log.hpp"
 #include "tui.hpp"
 
 
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/terminal.hpp>
 
 #include <memory>
 #include <algorithm>
-
-FileNode* find_node_by_path(FileNode& node, const std::string& path) {
-    if (node.path == path)
-        return &node;
-
-    for (auto& child : node.children) {
-        if (auto* found = find_node_by_path(*child, path)) {
-            return found;
-        }
-    }
-    return nullptr;
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// Searches give up after this long and keep what they found
+constexpr auto SEARCH_TIME_BUDGET = std::chrono::seconds(5);
+// Results are handed to the UI at most once per frame, except the first hit which goes out immediately
+constexpr auto SEARCH_FLUSH_INTERVAL = std::chrono::milliseconds(16);
+// Filesystem searches start once typing pauses this long; each keystroke inside it restarts the wait
+constexpr auto SEARCH_DEBOUNCE = std::chrono::milliseconds(120);
+constexpr auto SEARCH_DEBOUNCE_POLL = std::chrono::milliseconds(2);
+// Fuzzy mode shows only the best ranked paths
+constexpr size_t FUZZY_RESULT_LIMIT = 200;
+// Rows of the tree screen not available to tree entries: tree border (2) + status bar (3)
+constexpr int TREE_CHROME_ROWS = 5;
+// Same for the viewer: window border (2) + status bar (3)
+constexpr int VIEWER_CHROME_ROWS = 5;
+// And the editor: title box (3) + text border (2) + status bar (3)
+constexpr int EDITOR_CHROME_ROWS = 8;
+
+static int screen_height(const std::shared_ptr<AppState>& state) {
+    return state->screen_rows > 0 ? state->screen_rows : ftxui::Terminal::Size().dimy;
 }
 
 bool create_file_at_selection(std::shared_ptr<AppState> state) {
     if (state->new_file_name.empty())
         return false;
 
-    std::vector<FileNode*> visible;
-    build_visible_file_tree(state->fs, state->root, visible);
+    refresh_visible_tree(state);
+    const auto& visible = state->visible;
     if (visible.empty())
         return false;
 
@@ -34,31 +48,16 @@ bool create_file_at_selection(std::shared_ptr<AppState> state) {
         state->selected_index = static_cast<int>(visible.size() - 1);
     }
 
-    FileNode* selected = visible[state->selected_index];
-
-    // Determine the directory to create the file in
-    FileNode* dir_node = nullptr;
-    std::string dir_path;
+    auto& tree = state->tree;
+    NodeId selected = visible[state->selected_index].node;
 
-    if (selected->is_directory) {
-        dir_node = selected;
-        dir_path = selected->path;
-    } 
-    else {
-        // Parent directory of selected file
-        std::string path = selected->path;
-        auto pos = path.find_last_of('/');
-        if (pos == std::string::npos || pos == 0) {
-            dir_path = "/";
-        } else {
-            dir_path = path.substr(0, pos);
-        }
-        dir_node = find_node_by_path(state->root, dir_path);
-    }
-
-    if (!dir_node)
+    // Determine the directory to create the file in: the selection or its parent
+    NodeId dir_node = tree.node(selected).is_directory ? selected : tree.node(selected).parent;
+    if (dir_node == NO_NODE)
         return false;
 
+    std::string dir_path = tree.path_of(dir_node);
+
     // Build full file path
     std::string full_path;
     if (dir_path == "/")
@@ -66,11 +65,17 @@ bool create_file_at_selection(std::shared_ptr<AppState> state) {
     else
         full_path = dir_path + "/" + state->new_file_name;
 
-    if (!state->fs.create_file(full_path))
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(state->fs_mutex);
+        if (!state->fs.create_file(full_path))
+            return false;
+    }
 
     // Invalidate children so this directory gets reloaded next time
-    dir_node->children.clear();
+    tree.clear_children(dir_node);
+    tree.node(dir_node).children_loaded = false;
+    tree.node(dir_node).loading = false;
+    state->visible_dirty = true;
     return true;
 }
 
@@ -78,8 +83,8 @@ bool create_directory_at_selection(std::shared_ptr<AppState> state) {
     if (state->new_file_name.empty())
         return false;
 
-    std::vector<FileNode*> visible;
-    build_visible_file_tree(state->fs, state->root, visible);
+    refresh_visible_tree(state);
+    const auto& visible = state->visible;
     if (visible.empty())
         return false;
 
@@ -87,29 +92,16 @@ bool create_directory_at_selection(std::shared_ptr<AppState> state) {
         state->selected_index = static_cast<int>(visible.size() - 1);
     }
 
-    FileNode* selected = visible[state->selected_index];
+    auto& tree = state->tree;
+    NodeId selected = visible[state->selected_index].node;
 
     // Determine the directory in which to create the new directory
-    FileNode* dir_node = nullptr;
-    std::string dir_path;
-
-    if (selected->is_directory) {
-        dir_node = selected;
-        dir_path = selected->path;
-    } else {
-        std::string path = selected->path;
-        auto pos = path.find_last_of('/');
-        if (pos == std::string::npos || pos == 0) {
-            dir_path = "/";
-        } else {
-            dir_path = path.substr(0, pos);
-        }
-        dir_node = find_node_by_path(state->root, dir_path);
-    }
-
-    if (!dir_node)
+    NodeId dir_node = tree.node(selected).is_directory ? selected : tree.node(selected).parent;
+    if (dir_node == NO_NODE)
         return false;
 
+    std::string dir_path = tree.path_of(dir_node);
+
     // Build full directory path
     std::string full_path;
     if (dir_path == "/")
@@ -117,15 +109,22 @@ bool create_directory_at_selection(std::shared_ptr<AppState> state) {
     else
         full_path = dir_path + "/" + state->new_file_name;
 
-    if (!state->fs.create_directory(full_path))
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(state->fs_mutex);
+        if (!state->fs.create_directory(full_path))
+            return false;
+    }
 
     // Invalidate children so this directory gets reloaded next time
-    dir_node->children.clear();
+    tree.clear_children(dir_node);
+    tree.node(dir_node).children_loaded = false;
+    tree.node(dir_node).loading = false;
+    state->visible_dirty = true;
     return true;
 }
 
 bool start_edit_file(std::shared_ptr<AppState> state, const std::string& path) {
+    std::lock_guard<std::mutex> lock(state->fs_mutex);
     int fd = state->fs.open_file(path);
     if (fd < 0) {
         return false;
@@ -139,60 +138,263 @@ bool start_edit_file(std::shared_ptr<AppState> state, const std::string& path) {
     state->fs.close_file(fd);
 
     state->edit_path    = path;
-    state->edit_content = std::move(content);
+    state->edit_buffer.load(std::move(content));
+    state->edit_cursor  = 0;
+    state->edit_top     = 0;
+    state->edit_goal_column = 0;
+    state->edit_message.clear();
     state->editing_file = true;
 
     return true;
 }
 
+bool start_view_file(std::shared_ptr<AppState> state, const std::string& path, int offset) {
+    auto viewer = std::make_unique<FileViewer>(state->fs, state->fs_mutex);
+    if (!viewer->open(path)) {
+        return false;
+    }
+    if (offset >= 0) {
+        viewer->jump_to_offset(offset);
+    }
+
+    state->viewer = std::move(viewer);
+    state->viewer_prompt = ViewerPrompt::NONE;
+    state->viewer_message.clear();
+    return true;
+}
+
 bool save_edited_file(std::shared_ptr<AppState> state) {
     if (!state->editing_file || state->edit_path.empty())
         return false;
 
+    PieceTable& text = state->edit_buffer;
+    if (!text.modified())
+        return true;
+
+    std::lock_guard<std::mutex> lock(state->fs_mutex);
     int fd = state->fs.open_file(state->edit_path);
     if (fd < 0)
         return false;
 
-    bool ok = state->fs.write_file(fd, state->edit_content);
+    // Only the blocks under changed bytes are rewritten. Ranges are widened to whole blocks so the
+    // filesystem never has to read a block back to merge a partial write.
+    const size_t block_size = static_cast<size_t>(state->fs.superblock().block_size);
+    bool ok = true;
+    size_t written_to = 0;
+    for (const ByteRange& range : text.dirty_ranges()) {
+        size_t begin = std::max(range.offset / block_size * block_size, written_to);
+        size_t end = std::min(text.size(), (range.offset + range.length + block_size - 1) / block_size * block_size);
+        if (begin >= end)
+            continue;
+        ok = ok && state->fs.write_file_range(fd, static_cast<int>(begin), text.text(begin, end - begin));
+        written_to = end;
+    }
+    if (ok && text.size() < text.saved_size())
+        ok = state->fs.truncate_file(fd, static_cast<int>(text.size()));
     state->fs.close_file(fd);
+
+    if (ok)
+        text.mark_saved();
     return ok;
 }
 
-void build_visible_file_tree(FileSystem& fs, FileNode& node, std::vector<FileNode*>& out) {
-    out.push_back(&node);
+static void fill_children(FileTree& tree, NodeId id, const DirectoryListing& listing) {
+    tree.clear_children(id);
+    for (const auto& entry : listing.entries) {
+        tree.add_child(id, entry.name, entry.inode_index, entry.is_directory);
+    }
+    tree.node(id).children_loaded = true;
+    tree.node(id).loading = false;
+}
+
+void request_children(std::shared_ptr<AppState> state, NodeId id, bool urgent) {
+    auto& tree = state->tree;
 
-    if (!node.is_directory || !node.is_expanded) {
+    // Without a loader thread (headless use) the directory is listed in place
+    if (!state->loader) {
+        DirectoryListing listing;
+        {
+            std::lock_guard<std::mutex> lock(state->fs_mutex);
+            load_directory_listing(state->fs, tree.path_of(id), listing);
+        }
+        fill_children(tree, id, listing);
+        return;
+    }
+
+    FileNode& node = tree.node(id);
+    if (node.loading && !urgent)
+        return;
+
+    node.loading = true;
+    node.load_ticket++;
+    if (urgent)
+        state->loader->request(tree.path_of(id), node.load_ticket);
+    else
+        state->loader->prefetch(tree.path_of(id), node.load_ticket);
+}
+
+// Listing order, or largest first when sorting by size and the totals are known
+static std::vector<NodeId> ordered_children(const std::shared_ptr<AppState>& state, NodeId id) {
+    const FileTree& tree = state->tree;
+    std::vector<NodeId> children;
+    for (NodeId child = tree.node(id).first_child; child != NO_NODE; child = tree.node(child).next_sibling)
+        children.push_back(child);
+
+    if (state->sort_by_size && state->usage_ready) {
+        const FileSystem& fs = state->fs;
+        std::stable_sort(children.begin(), children.end(), [&](NodeId a, NodeId b) {
+            return fs.usage(tree.node(a).inode_index).bytes > fs.usage(tree.node(b).inode_index).bytes;
+        });
+    }
+    return children;
+}
+
+void build_visible_file_tree(std::shared_ptr<AppState> state, NodeId id, int depth, std::vector<VisibleRow>& out) {
+    auto& tree = state->tree;
+    out.push_back({id, depth});
+
+    if (!tree.node(id).is_directory || !tree.node(id).is_expanded) {
         return;
     }
 
     // Only load children once, the first time
-    if (node.children.empty()) {
-        std::vector<DirectoryEntry> entries;
-        if (fs.list_directory_entries(node.path, entries)) {
-            for (auto& e : entries) {
-                auto child = std::make_unique<FileNode>();
-
-                child->name = e.name;
-                if (node.path == "/")
-                    child->path = "/" + child->name;
-                else
-                    child->path = node.path + "/" + child->name;
+    if (!tree.node(id).children_loaded) {
+        request_children(state, id, true);
+    }
 
-                int child_inode = e.inode_index;
-                child->is_directory = fs.is_directory_inode(child_inode);
-                child->is_expanded  = false;
+    // Still in flight: a placeholder row holds the place until the listing is posted back
+    if (!tree.node(id).children_loaded) {
+        out.push_back({id, depth + 1, true});
+        return;
+    }
 
-                node.children.push_back(std::move(child));
-            }
+    for (NodeId child : ordered_children(state, id)) {
+        build_visible_file_tree(state, child, depth + 1, out);
+    }
+}
+
+void apply_directory_listing(std::shared_ptr<AppState> state, DirectoryListing listing) {
+    auto& tree = state->tree;
+    NodeId id = tree.find_by_path(listing.path);
+    if (id == NO_NODE || !tree.node(id).loading || tree.node(id).load_ticket != listing.ticket)
+        return; // node went away or was re-requested since
+
+    fill_children(tree, id, listing);
+
+    if (state->visible_dirty || !tree.node(id).is_expanded)
+        return;
+
+    // Swap the placeholder row for the real children
+    auto& visible = state->visible;
+    for (int row = 0; row < static_cast<int>(visible.size()); ++row) {
+        if (visible[row].node != id || !visible[row].placeholder)
+            continue;
+
+        std::vector<VisibleRow> rows;
+        for (NodeId child : ordered_children(state, id))
+            build_visible_file_tree(state, child, visible[row].depth, rows);
+
+        visible.erase(visible.begin() + row);
+        visible.insert(visible.begin() + row, rows.begin(), rows.end());
+
+        // Keep the cursor on the same entry when rows appeared above it
+        if (state->selected_index > row)
+            state->selected_index += static_cast<int>(rows.size()) - 1;
+        break;
+    }
+}
+
+void refresh_visible_tree(std::shared_ptr<AppState> state) {
+    // A write that changed some total may have changed the order
+    if (state->sort_by_size && state->usage_ready && state->fs.usage_generation() != state->usage_generation_seen)
+        state->visible_dirty = true;
+
+    if (!state->visible_dirty)
+        return;
+
+    // The cursor stays on the same entry across the rebuild
+    NodeId selected = NO_NODE;
+    if (state->selected_index >= 0 && state->selected_index < static_cast<int>(state->visible.size()))
+        selected = state->visible[state->selected_index].node;
+
+    state->visible.clear();
+    build_visible_file_tree(state, state->tree.root(), 0, state->visible);
+    state->visible_dirty = false;
+    state->usage_generation_seen = state->fs.usage_generation();
+
+    for (int row = 0; selected != NO_NODE && row < static_cast<int>(state->visible.size()); ++row) {
+        if (state->visible[row].node == selected && !state->visible[row].placeholder) {
+            state->selected_index = row;
+            break;
+        }
+    }
+}
+
+void start_usage_scan(std::shared_ptr<AppState> state) {
+    // The worker only holds a weak reference, AppState owns (and joins) the thread
+    std::weak_ptr<AppState> weak_state = state;
+    auto post_to_ui = state->post_to_ui;
+    FileSystem& fs = state->fs;
+    std::mutex& fs_mutex = state->fs_mutex;
+
+    state->usage_thread = std::thread([weak_state, post_to_ui, &fs, &fs_mutex]() {
+        {
+            std::lock_guard<std::mutex> lock(fs_mutex);
+            fs.build_usage_index();
         }
+        post_to_ui([weak_state]() {
+            if (auto state = weak_state.lock()) {
+                state->usage_ready = true;
+                state->visible_dirty = state->visible_dirty || state->sort_by_size;
+            }
+        });
+    });
+}
+
+void toggle_node_at(std::shared_ptr<AppState> state, int row) {
+    auto& visible = state->visible;
+    NodeId id = visible[row].node;
+    FileNode& node = state->tree.node(id);
+    const int depth = visible[row].depth;
+    if (!node.is_directory || visible[row].placeholder)
+        return;
+
+    if (node.is_expanded) {
+        // Drop the rows of every descendant: the run of deeper rows right after this one
+        int end = row + 1;
+        while (end < static_cast<int>(visible.size()) && visible[end].depth > depth)
+            ++end;
+        visible.erase(visible.begin() + row + 1, visible.begin() + end);
+        node.is_expanded = false;
+        return;
     }
 
-    for (auto& child : node.children) {
-        build_visible_file_tree(fs, *child, out);
+    // Flatten just this subtree and splice it in after the node's own row
+    node.is_expanded = true;
+    std::vector<VisibleRow> subtree;
+    build_visible_file_tree(state, id, depth, subtree);
+    visible.insert(visible.begin() + row + 1, subtree.begin() + 1, subtree.end());
+}
+
+// 1023 B, 1.5K, 12.0M, ...
+static std::string format_bytes(int64_t bytes) {
+    if (bytes < 1024)
+        return std::to_string(bytes) + " B";
+
+    const char* units = "KMGT";
+    double value = bytes / 1024.0;
+    int unit = 0;
+    while (value >= 1024.0 && units[unit + 1] != '\0') {
+        value /= 1024.0;
+        ++unit;
     }
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.1f%c", value, units[unit]);
+    return buffer;
 }
 
-ftxui::Element render_tree(std::shared_ptr<AppState> state) {
+static ftxui::Element render_screen(std::shared_ptr<AppState> state) {
     // EDIT MODE: full-screen editor + status bar
     if (state->editing_file) {
         return ftxui::vbox({
@@ -201,6 +403,13 @@ ftxui::Element render_tree(std::shared_ptr<AppState> state) {
         });
     }
 
+    if (state->viewer) {
+        return ftxui::vbox({
+            render_viewer(state) | ftxui::flex,
+            render_status_bar(state),
+        });
+    }
+
     if (state->searching) {
         return ftxui::vbox({
             render_search_panel(state) | ftxui::flex,
@@ -209,30 +418,55 @@ ftxui::Element render_tree(std::shared_ptr<AppState> state) {
     }
 
     // NORMAL + CREATE + SEARCH
-    std::vector<FileNode*> visible;
-    build_visible_file_tree(state->fs, state->root, visible);
+    refresh_visible_tree(state);
+    const auto& visible = state->visible;
+
+    // Tree border and status bar take TREE_CHROME_ROWS, only the rows that fit are rendered
+    state->viewport_rows = std::max(1, screen_height(state) - TREE_CHROME_ROWS);
+    const int rows = state->viewport_rows;
+    state->selected_index = std::max(0, std::min(state->selected_index, (int)visible.size() - 1));
+    if (state->selected_index < state->scroll_offset)
+        state->scroll_offset = state->selected_index;
+    if (state->selected_index >= state->scroll_offset + rows)
+        state->scroll_offset = state->selected_index - rows + 1;
+    state->scroll_offset = std::max(0, std::min(state->scroll_offset, (int)visible.size() - rows));
+
+    const int first = state->scroll_offset;
+    const int last = std::min((int)visible.size(), first + rows);
 
     ftxui::Elements lines;
-    for (int i = 0; i < (int)visible.size(); ++i) {
-        FileNode* node = visible[i];
-
-        int depth = 0;
-        if (node->path.size() > 1) {
-            depth = (int)std::count(node->path.begin(), node->path.end(), '/') - 1;
-        }
+    for (int i = first; i < last; ++i) {
+        const FileNode& node = state->tree.node(visible[i].node);
+        const int depth = std::max(0, visible[i].depth - 1);
 
         std::string label;
         label.append(depth * 2, ' ');
 
-        if (node->is_directory) {
-            label += node->is_expanded ? " " : " ";
+        if (visible[i].placeholder) {
+            ftxui::Element e = ftxui::text(label + "  loading…") | ftxui::dim;
+            if (i == state->selected_index) {
+                e = e | ftxui::inverted;
+            }
+            lines.push_back(e);
+            continue;
+        }
+
+        if (node.is_directory) {
+            label += node.is_expanded ? " " : " ";
         } else {
             label += " ";
         }
 
-        label += node->name;
+        label += state->tree.name(visible[i].node);
 
         ftxui::Element e = ftxui::text(label);
+        if (state->usage_ready && node.inode_index >= 0) {
+            const DirectoryUsage usage = state->fs.usage(node.inode_index);
+            std::string totals = format_bytes(usage.bytes);
+            if (node.is_directory)
+                totals += "  " + std::to_string(usage.files) + (usage.files == 1 ? " file " : " files");
+            e = ftxui::hbox({e, ftxui::filler(), ftxui::text(totals + " ") | ftxui::dim});
+        }
         if (i == state->selected_index) {
             e = e | ftxui::inverted;
         }
@@ -256,7 +490,282 @@ ftxui::Element render_tree(std::shared_ptr<AppState> state) {
     });
 }
 
-bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_ptr<AppState> state) {
+ftxui::Element render_tree(std::shared_ptr<AppState> state) {
+    const auto start = std::chrono::steady_clock::now();
+    ftxui::Element screen = render_screen(state);
+
+    // Block I/O since the previous frame: the event that led here, this render and any background work
+    FrameMetrics& metrics = state->metrics;
+    const Disk& disk = state->fs.disk();
+    const uint64_t reads = disk.blocks_read();
+    const uint64_t writes = disk.blocks_written();
+    metrics.blocks_read = reads - metrics.disk_reads_seen;
+    metrics.blocks_written = writes - metrics.disk_writes_seen;
+    metrics.disk_reads_seen = reads;
+    metrics.disk_writes_seen = writes;
+
+    if (metrics.visible) {
+        screen = ftxui::dbox({screen, render_perf_overlay(state)});
+    }
+
+    // The overlay therefore shows the previous frame's render time
+    metrics.render_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return screen;
+}
+
+static bool handle_viewer_event(ftxui::Event e, std::shared_ptr<AppState> state) {
+    FileViewer& viewer = *state->viewer;
+
+    if (state->viewer_prompt != ViewerPrompt::NONE) {
+        if (e == ftxui::Event::Escape) {
+            state->viewer_prompt = ViewerPrompt::NONE;
+            return true;
+        }
+
+        if (e == ftxui::Event::Return) {
+            const std::string input = state->viewer_input;
+            state->viewer_message.clear();
+            if (state->viewer_prompt == ViewerPrompt::OFFSET) {
+                // Decimal, or hex with a 0x prefix
+                char* end = nullptr;
+                const long offset = std::strtol(input.c_str(), &end, 0);
+                if (input.empty() || *end != '\0' || offset < 0)
+                    state->viewer_message = "Not an offset: " + input;
+                else
+                    viewer.jump_to_offset(static_cast<int>(std::min<long>(offset, viewer.size())));
+            } else {
+                state->viewer_find = input;
+                if (viewer.find_next(input) < 0)
+                    state->viewer_message = "Not found: " + input;
+            }
+            state->viewer_prompt = ViewerPrompt::NONE;
+            return true;
+        }
+
+        return state->viewer_box->OnEvent(e);
+    }
+
+    const int rows = std::max(1, screen_height(state) - VIEWER_CHROME_ROWS);
+
+    if (e == ftxui::Event::Escape || e == ftxui::Event::Character('q')) {
+        state->viewer.reset();
+        return true;
+    }
+
+    if (e == ftxui::Event::ArrowDown || e == ftxui::Event::Character('j')) {
+        viewer.scroll(1);
+        return true;
+    }
+
+    if (e == ftxui::Event::ArrowUp || e == ftxui::Event::Character('k')) {
+        viewer.scroll(-1);
+        return true;
+    }
+
+    if (e == ftxui::Event::PageDown || e == ftxui::Event::Character(' ')) {
+        viewer.scroll(rows);
+        return true;
+    }
+
+    if (e == ftxui::Event::PageUp) {
+        viewer.scroll(-rows);
+        return true;
+    }
+
+    if (e == ftxui::Event::Home || e == ftxui::Event::Character('g')) {
+        viewer.scroll_to_start();
+        return true;
+    }
+
+    if (e == ftxui::Event::End || e == ftxui::Event::Character('G')) {
+        viewer.scroll_to_end(rows);
+        return true;
+    }
+
+    if (e == ftxui::Event::Character(':') || e == ftxui::Event::Character('/')) {
+        state->viewer_prompt = e == ftxui::Event::Character(':') ? ViewerPrompt::OFFSET : ViewerPrompt::FIND;
+        state->viewer_input.clear();
+        return true;
+    }
+
+    if (e == ftxui::Event::Character('n')) {
+        if (!state->viewer_find.empty() && viewer.find_next(state->viewer_find) < 0)
+            state->viewer_message = "Not found: " + state->viewer_find;
+        return true;
+    }
+
+    // Editing still loads the whole file, so it is opt-in from the viewer
+    if (e == ftxui::Event::Character('e')) {
+        const std::string path = viewer.path();
+        state->viewer.reset();
+        start_edit_file(state, path);
+        return true;
+    }
+
+    return false;
+}
+
+// Tabs and control bytes would throw the terminal's layout off
+static std::string printable(std::string_view raw) {
+    std::string line;
+    line.reserve(raw.size());
+    for (char c : raw) {
+        if (c == '\t')
+            line.append("    ");
+        else if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f)
+            line.push_back('.');
+        else
+            line.push_back(c);
+    }
+    return line;
+}
+
+static size_t edit_line_start(const PieceTable& text, size_t pos) {
+    while (pos > 0 && text.at(pos - 1) != '\n')
+        --pos;
+    return pos;
+}
+
+static size_t edit_line_end(const PieceTable& text, size_t pos) {
+    while (pos < text.size() && text.at(pos) != '\n')
+        ++pos;
+    return pos;
+}
+
+// Start of the line after the one holding pos, or text.size() on the last line
+static size_t edit_next_line(const PieceTable& text, size_t pos) {
+    const size_t end = edit_line_end(text, pos);
+    return end < text.size() ? end + 1 : end;
+}
+
+// UTF-8 continuation bytes are skipped so the cursor never lands inside a character
+static bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+static size_t edit_previous_char(const PieceTable& text, size_t pos) {
+    if (pos == 0)
+        return 0;
+    --pos;
+    while (pos > 0 && is_continuation(text.at(pos)))
+        --pos;
+    return pos;
+}
+
+static size_t edit_next_char(const PieceTable& text, size_t pos) {
+    if (pos >= text.size())
+        return text.size();
+    ++pos;
+    while (pos < text.size() && is_continuation(text.at(pos)))
+        ++pos;
+    return pos;
+}
+
+// Moves the cursor `lines` lines down (or up), keeping the column it was asked to stay in
+static void edit_move_lines(std::shared_ptr<AppState> state, int lines) {
+    const PieceTable& text = state->edit_buffer;
+    size_t start = edit_line_start(text, state->edit_cursor);
+    for (; lines > 0; --lines) {
+        const size_t end = edit_line_end(text, start);
+        if (end >= text.size())
+            break;
+        start = end + 1;
+    }
+    for (; lines < 0 && start > 0; ++lines)
+        start = edit_line_start(text, start - 1);
+    state->edit_cursor = std::min(start + state->edit_goal_column, edit_line_end(text, start));
+}
+
+// Scrolls just enough to keep the cursor's line on screen, walking at most one screen of lines
+static void edit_follow_cursor(std::shared_ptr<AppState> state, int rows) {
+    const PieceTable& text = state->edit_buffer;
+    const size_t cursor_line = edit_line_start(text, state->edit_cursor);
+    if (cursor_line < state->edit_top) {
+        state->edit_top = cursor_line;
+        return;
+    }
+
+    size_t line = state->edit_top;
+    for (int row = 0; row < rows; ++row) {
+        if (line == cursor_line)
+            return;
+        const size_t next = edit_next_line(text, line);
+        if (next == line || next > cursor_line)
+            break;
+        line = next;
+    }
+
+    // Cursor is below the screen: put its line on the last row
+    state->edit_top = cursor_line;
+    for (int row = 1; row < rows && state->edit_top > 0; ++row)
+        state->edit_top = edit_line_start(text, state->edit_top - 1);
+}
+
+static bool handle_editor_event(ftxui::Event e, std::shared_ptr<AppState> state) {
+    PieceTable& text = state->edit_buffer;
+    size_t& cursor = state->edit_cursor;
+    const int rows = std::max(1, screen_height(state) - EDITOR_CHROME_ROWS);
+    bool keep_column = false;
+
+    if (e == ftxui::Event::CtrlS) {
+        state->edit_message = save_edited_file(state) ? "Saved" : "Save failed";
+        return true;
+    }
+    state->edit_message.clear();
+
+    if (e == ftxui::Event::CtrlZ) {
+        if (!text.undo(cursor))
+            state->edit_message = "Nothing to undo";
+    } else if (e == ftxui::Event::CtrlY) {
+        if (!text.redo(cursor))
+            state->edit_message = "Nothing to redo";
+    } else if (e == ftxui::Event::Return) {
+        text.insert(cursor, "\n");
+        cursor += 1;
+    } else if (e == ftxui::Event::Tab) {
+        text.insert(cursor, "\t");
+        cursor += 1;
+    } else if (e == ftxui::Event::Backspace) {
+        const size_t previous = edit_previous_char(text, cursor);
+        text.erase(previous, cursor - previous);
+        cursor = previous;
+    } else if (e == ftxui::Event::Delete) {
+        text.erase(cursor, edit_next_char(text, cursor) - cursor);
+    } else if (e == ftxui::Event::ArrowLeft) {
+        cursor = edit_previous_char(text, cursor);
+    } else if (e == ftxui::Event::ArrowRight) {
+        cursor = edit_next_char(text, cursor);
+    } else if (e == ftxui::Event::ArrowUp) {
+        edit_move_lines(state, -1);
+        keep_column = true;
+    } else if (e == ftxui::Event::ArrowDown) {
+        edit_move_lines(state, 1);
+        keep_column = true;
+    } else if (e == ftxui::Event::PageUp) {
+        edit_move_lines(state, -rows);
+        keep_column = true;
+    } else if (e == ftxui::Event::PageDown) {
+        edit_move_lines(state, rows);
+        keep_column = true;
+    } else if (e == ftxui::Event::Home) {
+        cursor = edit_line_start(text, cursor);
+    } else if (e == ftxui::Event::End) {
+        cursor = edit_line_end(text, cursor);
+    } else if (e.is_character()) {
+        const std::string typed = e.character();
+        text.insert(cursor, typed);
+        cursor += typed.size();
+    } else {
+        return false;
+    }
+
+    if (!keep_column)
+        state->edit_goal_column = cursor - edit_line_start(text, cursor);
+    edit_follow_cursor(state, rows);
+    return true;
+}
+
+static bool dispatch_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_ptr<AppState> state) {
 
     if (state->editing_file) {
         if (e == ftxui::Event::Escape) {
@@ -266,9 +775,11 @@ bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_
             return true;
         }
 
-        if (state->edit_box->OnEvent(e))
-            return true;
-        return false;
+        return handle_editor_event(e, state);
+    }
+
+    if (state->viewer) {
+        return handle_viewer_event(e, state);
     }
 
     if (state->creating_file || state->creating_directory) {
@@ -299,63 +810,89 @@ bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_
     if (state->searching) {
         // Cancel search
         if (e == ftxui::Event::Escape) {
+            cancel_search(state);
             state->searching = false;
             state->search_query.clear();
             state->search_results.clear();
             state->search_selected_index = 0;
+            state->search_base_query.clear();
+            state->fuzzy_candidates.reset();
+            return true;
+        }
+
+        // Cycle through the search modes, rerunning the query in the new one
+        if (e == ftxui::Event::Tab) {
+            cancel_search(state);
+            switch (state->search_mode) {
+                case SearchMode::NAME:    state->search_mode = SearchMode::FUZZY; break;
+                case SearchMode::FUZZY:   state->search_mode = SearchMode::GLOB; break;
+                case SearchMode::GLOB:    state->search_mode = SearchMode::REGEX; break;
+                case SearchMode::REGEX:   state->search_mode = SearchMode::CONTENT; break;
+                case SearchMode::CONTENT: state->search_mode = SearchMode::NAME; break;
+            }
+            state->search_results.clear();
+            state->search_error.clear();
+            state->search_selected_index = 0;
+            state->search_base_query.clear();
+            state->fuzzy_candidates.reset();
+            if (!state->search_query.empty())
+                perform_search(state);
             return true;
         }
 
-        // If we already have results, arrow/j/k navigates the list
+        // Letters belong to the query now that it runs as you type, so only the arrows move
         if (!state->search_results.empty()) {
             int n = (int)state->search_results.size();
 
-            if (e == ftxui::Event::ArrowDown || e == ftxui::Event::Character('j')) {
+            if (e == ftxui::Event::ArrowDown) {
                 if (state->search_selected_index + 1 < n)
                     state->search_selected_index++;
                 return true;
             }
 
-            if (e == ftxui::Event::ArrowUp || e == ftxui::Event::Character('k')) {
+            if (e == ftxui::Event::ArrowUp) {
                 if (state->search_selected_index > 0)
                     state->search_selected_index--;
                 return true;
             }
 
             if (e == ftxui::Event::Return) {
-                std::string path = state->search_results[state->search_selected_index];
+                cancel_search(state);
+                std::string path = state->search_results[state->search_selected_index].path;
+                const int offset = state->search_results[state->search_selected_index].offset;
                 state->searching = false;
                 state->search_query.clear();
                 state->search_results.clear();
                 state->search_selected_index = 0;
+                state->search_base_query.clear();
+                state->fuzzy_candidates.reset();
 
-                // Try to open as file
-                start_edit_file(state, path);
+                // Try to open as file, at the match for content results
+                start_view_file(state, path, offset);
                 return true;
             }
-
-            // Let the search_box still handle typing (in case user edits query)
-            if (state->search_box->OnEvent(e))
-                return true;
-            return false;
         }
 
-        // No results yet: typing query + Enter to run search
+        // No results yet: Enter runs the query without waiting out the debounce
         if (e == ftxui::Event::Return) {
-            perform_search(state);
+            if (!state->search_query.empty())
+                perform_search(state);
             return true;
         }
 
-        if (state->search_box->OnEvent(e))
+        std::string previous_query = state->search_query;
+        if (state->search_box->OnEvent(e)) {
+            if (state->search_query != previous_query)
+                update_search(state);
             return true;
+        }
 
         return false;
     }
 
-    std::vector<FileNode*> visible;
-    build_visible_file_tree(state->fs, state->root, visible);
+    refresh_visible_tree(state);
 
-    int n = static_cast<int>(visible.size());
+    int n = static_cast<int>(state->visible.size());
 
     if (n == 0) {
         return false;
@@ -378,6 +915,12 @@ bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_
         return true;
     }
 
+    if (e == ftxui::Event::Character('s')) {
+        state->sort_by_size = !state->sort_by_size;
+        state->visible_dirty = true;
+        return true;
+    }
+
     if (e == ftxui::Event::Character('/')) {
         state->searching = true;
         state->search_query.clear();
@@ -386,10 +929,18 @@ bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_
         return true;
     }
 
+    // Moving onto a directory starts fetching its children so expanding it is instant
+    auto prefetch_selection = [&]() {
+        const VisibleRow& row = state->visible[state->selected_index];
+        if (!row.placeholder && state->tree.node(row.node).is_directory && !state->tree.node(row.node).children_loaded && state->loader)
+            request_children(state, row.node, false);
+    };
+
     if (e == ftxui::Event::ArrowDown || e == ftxui::Event::Character('j')) {
         if (state->selected_index + 1 < n) {
             state->selected_index++;
         }
+        prefetch_selection();
         return true;
     }
 
@@ -397,17 +948,46 @@ bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_
         if (state->selected_index > 0) {
             state->selected_index--;
         }
+        prefetch_selection();
         return true;
     }
 
-    FileNode* node = visible[state->selected_index];
+    if (e == ftxui::Event::PageDown) {
+        state->selected_index = std::min(n - 1, state->selected_index + state->viewport_rows);
+        prefetch_selection();
+        return true;
+    }
+
+    if (e == ftxui::Event::PageUp) {
+        state->selected_index = std::max(0, state->selected_index - state->viewport_rows);
+        prefetch_selection();
+        return true;
+    }
+
+    if (e == ftxui::Event::Home) {
+        state->selected_index = 0;
+        prefetch_selection();
+        return true;
+    }
+
+    if (e == ftxui::Event::End) {
+        state->selected_index = n - 1;
+        prefetch_selection();
+        return true;
+    }
+
+    if (state->visible[state->selected_index].placeholder) {
+        return e == ftxui::Event::Return;
+    }
+
+    NodeId node = state->visible[state->selected_index].node;
 
     if (e == ftxui::Event::Return) {
-        if (node->is_directory) {
-            node->is_expanded = !node->is_expanded;
+        if (state->tree.node(node).is_directory) {
+            toggle_node_at(state, state->selected_index);
         }
         else {
-            start_edit_file(state, node->path);
+            start_view_file(state, state->tree.path_of(node));
         }
         return true;
     }
@@ -420,6 +1000,24 @@ bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_
     return false;
 }
 
+bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_ptr<AppState> state) {
+    // F2 works in every mode, so the overlay can be brought up over whatever is slow
+    if (e == ftxui::Event::F2) {
+        state->metrics.visible = !state->metrics.visible;
+        return true;
+    }
+
+    // Redraw requests from background threads are not input, timing them would hide the last real event
+    if (e == ftxui::Event::Custom) {
+        return dispatch_event(e, screen, state);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool handled = dispatch_event(e, screen, state);
+    state->metrics.event_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return handled;
+}
+
 ftxui::Element render_input_popup(std::shared_ptr<AppState> state) {
     std::string title = state->creating_directory ? " Enter directory name " : " Enter file name ";
     return ftxui::window(
@@ -433,16 +1031,286 @@ ftxui::Element render_input_popup(std::shared_ptr<AppState> state) {
 }
 
 ftxui::Element render_edit_popup(std::shared_ptr<AppState> state) {
+    const PieceTable& text = state->edit_buffer;
+    const int rows = std::max(1, screen_height(state) - EDITOR_CHROME_ROWS);
+
+    // Lines are pulled from the piece table starting at edit_top, nothing past the screen is read
+    ftxui::Elements lines;
+    size_t line = state->edit_top;
+    for (int row = 0; row < rows; ++row) {
+        const size_t end = edit_line_end(text, line);
+        const size_t cursor = state->edit_cursor;
+        if (cursor >= line && cursor <= end) {
+            const size_t after = std::min(edit_next_char(text, cursor), end);
+            const std::string under = cursor < end ? printable(text.text(cursor, after - cursor)) : " ";
+            lines.push_back(ftxui::hbox({
+                ftxui::text(printable(text.text(line, cursor - line))),
+                ftxui::text(under) | ftxui::inverted,
+                ftxui::text(printable(text.text(after, end - after))),
+            }));
+        } else {
+            lines.push_back(ftxui::text(printable(text.text(line, end - line))));
+        }
+
+        if (end >= text.size())
+            break;
+        line = end + 1;
+    }
+
+    std::string title = " Editing: " + state->edit_path;
+    if (text.modified())
+        title += " [modified]";
+    if (!state->edit_message.empty())
+        title += "  " + state->edit_message;
 
     return ftxui::vbox({
-        ftxui::text(" Editing: " + state->edit_path) | ftxui::bold | ftxui::center | ftxui::border,
-        state->edit_box->Render() | ftxui::flex | ftxui::inverted | ftxui::border,
+        ftxui::text(title) | ftxui::bold | ftxui::center | ftxui::border,
+        ftxui::vbox(std::move(lines)) | ftxui::flex | ftxui::border,
     });
 }
 
-void perform_search(std::shared_ptr<AppState> state) {
-    state->search_results = state->fs.search(state->search_query);
+ftxui::Element render_viewer(std::shared_ptr<AppState> state) {
+    FileViewer& viewer = *state->viewer;
+
+    // Only the lines on screen are read; the viewer's cache follows the viewport size
+    int rows = std::max(1, screen_height(state) - VIEWER_CHROME_ROWS);
+    if (state->viewer_prompt != ViewerPrompt::NONE || !state->viewer_message.empty())
+        rows = std::max(1, rows - 1);
+    viewer.set_viewport(rows);
+
+    ftxui::Elements lines;
+    for (const std::string& raw : viewer.visible_lines(rows)) {
+        lines.push_back(ftxui::text(printable(raw)));
+    }
+
+    if (state->viewer_prompt != ViewerPrompt::NONE) {
+        const char* label = state->viewer_prompt == ViewerPrompt::OFFSET ? " Offset: " : " Find: ";
+        lines.push_back(ftxui::filler());
+        lines.push_back(ftxui::hbox({ftxui::text(label) | ftxui::dim, state->viewer_box->Render() | ftxui::flex}));
+    } else if (!state->viewer_message.empty()) {
+        lines.push_back(ftxui::filler());
+        lines.push_back(ftxui::text(" " + state->viewer_message + " ") | ftxui::dim);
+    }
+
+    const int percent = viewer.size() > 0 ? static_cast<int>(100LL * viewer.top() / viewer.size()) : 100;
+    std::string title = " " + viewer.path() + "  " + std::to_string(viewer.top()) + "/" + std::to_string(viewer.size()) +
+                        " (" + std::to_string(percent) + "%) ";
+    return ftxui::window(ftxui::text(title) | ftxui::bold, vbox(std::move(lines)) | ftxui::flex) | ftxui::flex;
+}
+
+void cancel_search(std::shared_ptr<AppState> state) {
+    if (state->search_control)
+        state->search_control->cancel();
+    if (state->search_thread.joinable())
+        state->search_thread.join();
+
+    state->search_control.reset();
+    state->search_running = false;
+    // Batches the cancelled search already posted are now stale
+    state->search_generation++;
+}
+
+// True when old can be read out of query in order, skipping characters (it is a subsequence)
+static bool is_subsequence(const std::string& old, const std::string& query) {
+    size_t q = 0;
+    for (char c : old) {
+        q = query.find(c, q);
+        if (q == std::string::npos)
+            return false;
+        ++q;
+    }
+    return true;
+}
+
+// Name mode: a query containing the previous one can only match a subset of its results,
+// so they are filtered in place instead of asking the filesystem again
+static bool narrow_search_results(std::shared_ptr<AppState> state) {
+    if (state->search_mode != SearchMode::NAME || state->search_running || state->search_base_query.empty())
+        return false;
+    if (state->search_query.find(state->search_base_query) == std::string::npos)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(state->fs_mutex);
+        if (state->fs.name_index().generation() != state->search_base_generation)
+            return false;
+    }
+
+    const std::string& query = state->search_query;
+    auto& results = state->search_results;
+    results.erase(std::remove_if(results.begin(), results.end(), [&](const SearchResult& result) {
+        const size_t name_start = result.path.find_last_of('/') + 1;
+        return result.path.find(query, name_start) == std::string::npos;
+    }), results.end());
+
+    state->search_base_query = query;
     state->search_selected_index = 0;
+    state->search_error.clear();
+    return true;
+}
+
+void update_search(std::shared_ptr<AppState> state) {
+    if (state->search_query.empty()) {
+        cancel_search(state);
+        state->search_results.clear();
+        state->search_error.clear();
+        state->search_selected_index = 0;
+        state->search_stopped = false;
+        state->search_base_query.clear();
+        state->fuzzy_candidates.reset();
+        return;
+    }
+
+    if (narrow_search_results(state))
+        return;
+
+    // Fuzzy ranking is in memory; the other modes walk the filesystem and wait for typing to pause
+    perform_search(state, state->search_mode == SearchMode::FUZZY ? std::chrono::milliseconds(0) : SEARCH_DEBOUNCE);
+}
+
+void perform_search(std::shared_ptr<AppState> state, std::chrono::milliseconds debounce) {
+    cancel_search(state);
+
+    // The old results stay on screen until the first batch of the new search replaces them
+    state->search_results_stale = true;
+    state->search_error.clear();
+    state->search_stopped = false;
+    state->search_running = true;
+
+    auto control = std::make_shared<SearchControl>();
+    state->search_control = control;
+
+    const uint64_t generation = ++state->search_generation;
+    const SearchMode mode = state->search_mode;
+    const std::string query = state->search_query;
+
+    uint64_t name_generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(state->fs_mutex);
+        name_generation = state->fs.name_index().generation();
+        if (mode == SearchMode::FUZZY && (!state->fuzzy_index || state->fuzzy_generation != name_generation)) {
+            auto index = std::make_shared<FuzzyIndex>();
+            index->assign(state->fs.all_paths());
+            state->fuzzy_index = std::move(index);
+            state->fuzzy_generation = name_generation;
+            state->fuzzy_candidates.reset();
+        }
+    }
+    std::shared_ptr<const FuzzyIndex> fuzzy_index = state->fuzzy_index;
+
+    // Fuzzy mode rescores only the previous matches when the query extends the previous one
+    std::shared_ptr<const std::vector<int>> candidates;
+    if (mode == SearchMode::FUZZY && state->fuzzy_candidates && is_subsequence(state->search_base_query, query))
+        candidates = state->fuzzy_candidates;
+    state->search_base_query.clear();
+    state->fuzzy_candidates.reset();
+
+    // The worker only holds a weak reference, AppState owns (and joins) the thread
+    std::weak_ptr<AppState> weak_state = state;
+    auto post_to_ui = state->post_to_ui;
+    FileSystem& fs = state->fs;
+    std::mutex& fs_mutex = state->fs_mutex;
+
+    state->search_thread = std::thread([weak_state, post_to_ui, &fs, &fs_mutex, control, generation, mode, query, debounce,
+                                        name_generation, fuzzy_index, candidates]() {
+        // A keystroke inside the debounce window cancels this search before it touches the filesystem
+        const auto start = std::chrono::steady_clock::now() + debounce;
+        while (std::chrono::steady_clock::now() < start) {
+            if (control->stopped())
+                return;
+            std::this_thread::sleep_for(SEARCH_DEBOUNCE_POLL);
+        }
+        control->set_budget(SEARCH_TIME_BUDGET);
+
+        std::vector<SearchResult> batch;
+        std::shared_ptr<const std::vector<int>> matched;
+        bool first = true;
+        auto last_flush = std::chrono::steady_clock::now();
+
+        auto deliver = [&](bool done, SearchStatus status) {
+            post_to_ui([weak_state, generation, done, status, query, name_generation, matched, batch = std::move(batch)]() mutable {
+                auto state = weak_state.lock();
+                if (!state || state->search_generation != generation)
+                    return;
+
+                if (state->search_results_stale) {
+                    state->search_results.clear();
+                    state->search_selected_index = 0;
+                    state->search_results_stale = false;
+                }
+                for (auto& result : batch)
+                    state->search_results.push_back(std::move(result));
+
+                if (done) {
+                    state->search_running = false;
+                    state->search_stopped = status == SearchStatus::STOPPED;
+                    if (status == SearchStatus::INVALID_PATTERN)
+                        state->search_error = "Invalid pattern";
+
+                    // Only a complete result set can be narrowed by the next keystroke
+                    if (status == SearchStatus::COMPLETE) {
+                        state->search_base_query = query;
+                        state->search_base_generation = name_generation;
+                        state->fuzzy_candidates = std::move(matched);
+                    }
+                }
+            });
+
+            batch.clear();
+            last_flush = std::chrono::steady_clock::now();
+        };
+
+        auto add = [&](SearchResult result) {
+            batch.push_back(std::move(result));
+            if (first || std::chrono::steady_clock::now() - last_flush >= SEARCH_FLUSH_INTERVAL) {
+                first = false;
+                deliver(false, SearchStatus::COMPLETE);
+            }
+        };
+
+        auto add_path = [&](const std::string& path) {
+            add({path, ""});
+        };
+
+        // The filesystem searches take fs_mutex a file, a directory or a stretch of the name index at a time,
+        // so the UI and the directory loader still get in while a long search runs
+        control->set_lock(&fs_mutex);
+        SearchStatus status = SearchStatus::COMPLETE;
+        switch (mode) {
+            case SearchMode::NAME:
+                status = fs.search(query, add_path, *control);
+                break;
+            case SearchMode::FUZZY: {
+                // Ranking needs every score, so the top results go out as one batch
+                auto all_matched = std::make_shared<std::vector<int>>();
+                std::vector<FuzzyMatch> best;
+                if (candidates) {
+                    *all_matched = *candidates;
+                    best = fuzzy_index->narrow(query, FUZZY_RESULT_LIMIT, *all_matched);
+                } else {
+                    best = fuzzy_index->top(query, FUZZY_RESULT_LIMIT, all_matched.get());
+                }
+                for (const FuzzyMatch& match : best) {
+                    batch.push_back({std::string(fuzzy_index->path(match.index)), "  (" + std::to_string(match.score) + ")"});
+                }
+                matched = std::move(all_matched);
+                break;
+            }
+            case SearchMode::GLOB:
+                status = fs.search_glob(query, add_path, *control);
+                break;
+            case SearchMode::REGEX:
+                status = fs.search_regex(query, add_path, *control);
+                break;
+            case SearchMode::CONTENT:
+                status = fs.search_content(query, [&](const ContentMatch& match) {
+                    add({match.path, ":" + std::to_string(match.line) + ":" + std::to_string(match.column) +
+                                     "  (offset " + std::to_string(match.offset) + ")", match.offset});
+                }, *control);
+                break;
+        }
+        deliver(true, status);
+    });
 }
 
 ftxui::Element render_search_panel(std::shared_ptr<AppState> state) {
@@ -462,11 +1330,19 @@ ftxui::Element render_search_panel(std::shared_ptr<AppState> state) {
     {
         ftxui::Elements lines;
 
-        if (state->search_results.empty()) {
+        if (!state->search_error.empty()) {
+            lines.push_back(ftxui::text(" " + state->search_error + " ") | ftxui::dim);
+        } else if (state->search_results.empty() && state->search_running) {
+            lines.push_back(ftxui::text(" Searching... ") | ftxui::dim);
+        } else if (state->search_results.empty()) {
             lines.push_back(ftxui::text(" (No results yet) ") | ftxui::dim);
         } else {
             for (int i = 0; i < (int)state->search_results.size(); ++i) {
-                auto row = ftxui::text(state->search_results[i]);
+                const SearchResult& result = state->search_results[i];
+                auto row = ftxui::hbox({
+                    ftxui::text(result.path),
+                    ftxui::text(result.detail) | ftxui::dim,
+                });
                 if (i == state->search_selected_index)
                     row = row | ftxui::inverted;
                 lines.push_back(row);
@@ -480,8 +1356,21 @@ ftxui::Element render_search_panel(std::shared_ptr<AppState> state) {
         );
     }
 
+    std::string title;
+    switch (state->search_mode) {
+        case SearchMode::NAME:    title = " Search (names) "; break;
+        case SearchMode::FUZZY:   title = " Search (fuzzy) "; break;
+        case SearchMode::GLOB:    title = " Search (glob) "; break;
+        case SearchMode::REGEX:   title = " Search (regex) "; break;
+        case SearchMode::CONTENT: title = " Search (contents) "; break;
+    }
+    if (state->search_running) {
+        title += "[searching] ";
+    } else if (state->search_stopped) {
+        title += "[stopped at time limit] ";
+    }
     return window(
-               ftxui::text(" Search ") | ftxui::bold,
+               ftxui::text(title) | ftxui::bold,
                vbox(std::move(body)) | ftxui::flex
            ) | ftxui::flex;
 }
@@ -490,18 +1379,23 @@ ftxui::Element render_status_bar(std::shared_ptr<AppState> state) {
     std::string msg;
 
     if (state->editing_file) {
-        msg = "[Esc] Save & close";
+        msg = "[Ctrl-S] Save  |  [Ctrl-Z/Ctrl-Y] Undo/Redo  |  [Esc] Save & close";
+    } else if (state->viewer) {
+        if (state->viewer_prompt != ViewerPrompt::NONE)
+            msg = "[Enter] Go  |  [Esc] Cancel";
+        else
+            msg = "[j/k or ↑/↓] Scroll  |  [PgUp/PgDn] Page  |  [g/G] Start/End  |  [:] Offset  |  [/] Find  |  [n] Next  |  [e] Edit  |  [q] Close";
     } else if (state->creating_file || state->creating_directory) {
         msg = "[Enter] Confirm  |  [Esc] Cancel";
     } else if (state->searching) {
         if (state->search_results.empty()) {
-            msg = "Search: type pattern  |  [Enter] Search  |  [Esc] Cancel";
+            msg = "Search: type pattern  |  [Tab] Mode  |  [Esc] Cancel";
         } else {
-            msg = "Search results: [Enter] Open  |  [j/k or ↑/↓] Move  |  [Esc] Close";
+            msg = "Search results: [Enter] Open  |  [↑/↓] Move  |  [Tab] Mode  |  [Esc] Close";
         }
     } else {
         msg =
-            "[j/k or ↑/↓] Move  |  [Enter] Open/Toggle  |  [n] New file  |  [d] New dir  |  [/] Search  |  [q] Quit";
+            "[j/k or ↑/↓] Move  |  [PgUp/PgDn] Page  |  [Enter] Open/Toggle  |  [n] New file  |  [d] New dir  |  [/] Search  |  [s] Sort by size  |  [F2] Stats  |  [q] Quit";
     }
 
     return ftxui::hbox({
@@ -512,20 +1406,83 @@ ftxui::Element render_status_bar(std::shared_ptr<AppState> state) {
 
 
 
-void run_tui(FileSystem& fs) {
-    FileNode root{};
-    root.name = "/";
-    root.path = "/";
-    root.is_directory = true;
-    root.is_expanded = true;
-    
-    auto state = std::make_shared<AppState>(AppState{fs, std::move(root), 0});
+static std::string format_latency(std::chrono::microseconds t) {
+    if (t.count() < 0)
+        return "-";
+    if (t.count() < 1000)
+        return std::to_string(t.count()) + " us";
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.2f ms", t.count() / 1000.0);
+    return buffer;
+}
+
+ftxui::Element render_perf_overlay(std::shared_ptr<AppState> state) {
+    const FrameMetrics& metrics = state->metrics;
+
+    // Hit rate of the viewer's block cache, the only block cache there is
+    std::string hit_rate = "-";
+    if (state->viewer) {
+        const uint64_t lookups = state->viewer->cache_hits() + state->viewer->cache_misses();
+        if (lookups > 0)
+            hit_rate = std::to_string(state->viewer->cache_hits() * 100 / lookups) + "%";
+    }
+
+    auto row = [](const std::string& label, const std::string& value) {
+        return ftxui::hbox({
+            ftxui::text(label) | ftxui::size(ftxui::WIDTH, ftxui::EQUAL, 12),
+            ftxui::text(value) | ftxui::size(ftxui::WIDTH, ftxui::GREATER_THAN, 10),
+        });
+    };
+
+    ftxui::Element panel = ftxui::window(ftxui::text(" Performance "), ftxui::vbox({
+        row("event", format_latency(metrics.event_time)),
+        row("render", format_latency(metrics.render_time)),
+        row("reads", std::to_string(metrics.blocks_read) + " blocks"),
+        row("writes", std::to_string(metrics.blocks_written) + " blocks"),
+        row("cache hit", hit_rate),
+        row("search", format_latency(state->fs.last_search_latency())),
+        row("read_file", format_latency(state->fs.last_read_latency())),
+    })) | ftxui::clear_under;
+
+    // Top right corner, over whatever screen is showing
+    return ftxui::vbox({
+        ftxui::hbox({ftxui::filler(), panel}),
+        ftxui::filler(),
+    });
+}
+
+std::shared_ptr<AppState> make_app_state(FileSystem& fs) {
+    auto state = std::make_shared<AppState>(fs);
+    state->tree.node(state->tree.root()).is_expanded = true;
 
     state->input_box = ftxui::Input(&state->new_file_name, "");
-    state->edit_box  = ftxui::Input(&state->edit_content, "");
     state->search_box = ftxui::Input(&state->search_query, "");  
+    state->viewer_box = ftxui::Input(&state->viewer_input, "");
+    return state;
+}
+
+void run_tui(FileSystem& fs) {
+    auto state = make_app_state(fs);
 
     auto screen = ftxui::ScreenInteractive::Fullscreen();
+    // Ctrl-Z is undo in the editor rather than suspend
+    screen.ForceHandleCtrlZ(false);
+    state->post_to_ui = [&screen](std::function<void()> task) {
+        screen.Post(std::move(task));
+        screen.PostEvent(ftxui::Event::Custom);
+    };
+
+    // Listings come back on the loader thread and are applied on the UI thread
+    std::weak_ptr<AppState> weak_state = state;
+    state->loader = std::make_unique<DirectoryLoader>(fs, state->fs_mutex, [weak_state, &screen](DirectoryListing listing) {
+        screen.Post([weak_state, listing = std::move(listing)]() mutable {
+            if (auto state = weak_state.lock())
+                apply_directory_listing(state, std::move(listing));
+        });
+        screen.PostEvent(ftxui::Event::Custom);
+    });
+    start_usage_scan(state);
 
     ftxui::Component renderer = ftxui::Renderer([state] {
         return render_tree(state);
@@ -535,6 +1492,13 @@ void run_tui(FileSystem& fs) {
             return handle_event(e, screen, state);
     });
 
+    // Anything printed to stderr would land in the middle of the screen; messages stay in the log ring
+    log_set_stderr_level(LogLevel::OFF);
     screen.Loop(app);
+    log_set_stderr_level(LogLevel::WARN);
+    cancel_search(state);
+    state->loader.reset();
+    if (state->usage_thread.joinable())
+        state->usage_thread.join();
 }
 
@@ -1,46 +1,158 @@
 #ifndef TUI_H
 #define TUI_H
 
+#include "directory_loader.hpp"
+#include "file_tree.hpp"
+#include "file_viewer.hpp"
 #include "filesystem.hpp"
+#include "fuzzy_match.hpp"
+#include "piece_table.hpp"
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/component/event.hpp>
 #include <ftxui/component/screen_interactive.hpp>
 
-struct FileNode {
-    std::string name;
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+enum class SearchMode {
+    NAME,
+    FUZZY,
+    GLOB,
+    REGEX,
+    CONTENT
+};
+
+struct SearchResult {
     std::string path;
-    bool is_directory{};
-    bool is_expanded{};
-    std::vector<std::unique_ptr<FileNode>> children{};
+    std::string detail;
+    int offset{-1}; // content matches: where the viewer opens
+};
+
+enum class ViewerPrompt {
+    NONE,
+    OFFSET,
+    FIND
+};
+
+// One row of the flattened tree view
+struct VisibleRow {
+    NodeId node{NO_NODE};
+    int depth{};
+    bool placeholder{false}; // "loading..." row standing in for node's children
+};
+
+// Readings for the performance overlay (F2). Times are those of the most recent event and render;
+// block I/O is what reached the Disk between the last two renders, from any thread.
+struct FrameMetrics {
+    bool visible{false};
+    std::chrono::microseconds event_time{0};
+    std::chrono::microseconds render_time{0};
+    uint64_t blocks_read{0};
+    uint64_t blocks_written{0};
+    uint64_t disk_reads_seen{0};
+    uint64_t disk_writes_seen{0};
 };
 
 struct AppState {
+    explicit AppState(FileSystem& fs) : fs(fs) {};
+
     FileSystem& fs;
-    FileNode root;
+    // Held around every FileSystem call made while background threads may be running
+    std::mutex fs_mutex;
+    std::unique_ptr<DirectoryLoader> loader;
+
+    FileTree tree;
     int selected_index{};
 
+    // Flattened expanded tree, patched in place on expand/collapse and
+    // rebuilt from scratch only when visible_dirty is set
+    std::vector<VisibleRow> visible;
+    bool visible_dirty{true};
+    int scroll_offset{0};
+    int viewport_rows{1};
+
     bool creating_file {false};
     bool creating_directory {false};
     std::string new_file_name;
     ftxui::Component input_box;
 
     bool editing_file{false};
-    std::string edit_content;
+    // Edits go into a piece table so saving only writes the blocks they touched
+    PieceTable edit_buffer;
     std::string edit_path;
-    ftxui::Component edit_box;
+    size_t edit_cursor{0};      // byte offset
+    size_t edit_top{0};         // start of the first line on screen
+    size_t edit_goal_column{0}; // column up/down try to keep
+    std::string edit_message;
+
+    // Read-only paged view, how files are opened; 'e' switches to the editor
+    std::unique_ptr<FileViewer> viewer;
+    ViewerPrompt viewer_prompt{ViewerPrompt::NONE};
+    std::string viewer_input;
+    std::string viewer_find; // repeated by 'n'
+    std::string viewer_message;
+    ftxui::Component viewer_box;
 
     bool searching{false};
+    SearchMode search_mode{SearchMode::NAME};
     std::string search_query;
-    std::vector<std::string> search_results;
+    std::vector<SearchResult> search_results;
+    std::string search_error;
     int search_selected_index{0};
     ftxui::Component search_box;
+
+    // The running search lives on search_thread and posts results back to the UI thread.
+    // Posts from an older generation are dropped.
+    std::thread search_thread;
+    std::shared_ptr<SearchControl> search_control;
+    uint64_t search_generation{0};
+    bool search_running{false};
+    bool search_stopped{false};
+    bool search_results_stale{false}; // shown until the running search's first batch replaces them
+
+    // Query the current results are complete for, and the name index generation they were taken at.
+    // A query extending it narrows those results instead of searching again.
+    std::string search_base_query;
+    uint64_t search_base_generation{0};
+
+    // Fuzzy candidates, rebuilt only when the name index generation moves
+    std::shared_ptr<const FuzzyIndex> fuzzy_index;
+    uint64_t fuzzy_generation{0};
+    // Every fuzzy candidate that matched search_base_query, not just the ranked few on screen
+    std::shared_ptr<const std::vector<int>> fuzzy_candidates;
+
+    // Runs a task on the UI thread and redraws; run_tui posts to its ScreenInteractive,
+    // a headless driver supplies its own queue
+    std::function<void(std::function<void()>)> post_to_ui;
+    // Screen height in rows, 0 to ask the terminal
+    int screen_rows{0};
+
+    FrameMetrics metrics;
+
+    // du totals are built once on usage_thread, FileSystem keeps them current after that
+    std::thread usage_thread;
+    bool usage_ready{false};
+    bool sort_by_size{false};
+    uint64_t usage_generation_seen{0}; // totals the current sorted order was built from
 };
 
 
 
-FileNode* find_node_by_path(FileNode& node, const std::string& path);
+void build_visible_file_tree(std::shared_ptr<AppState> state, NodeId node, int depth, std::vector<VisibleRow>& out);
+
+void request_children(std::shared_ptr<AppState> state, NodeId node, bool urgent);
+
+void apply_directory_listing(std::shared_ptr<AppState> state, DirectoryListing listing);
 
-void build_visible_file_tree(FileSystem& fs, FileNode& node, std::vector<FileNode*>& out);
+void refresh_visible_tree(std::shared_ptr<AppState> state);
+
+// Builds the directory size totals in the background and redraws when they are ready
+void start_usage_scan(std::shared_ptr<AppState> state);
+
+void toggle_node_at(std::shared_ptr<AppState> state, int row);
 
 bool create_file_at_selection(std::shared_ptr<AppState> state);
 
@@ -48,6 +160,9 @@ bool save_edited_file(std::shared_ptr<AppState> state);
 
 bool start_edit_file(std::shared_ptr<AppState> state, const std::string& path);
 
+// Opens path in the viewer, with the line holding offset on top when offset >= 0
+bool start_view_file(std::shared_ptr<AppState> state, const std::string& path, int offset = -1);
+
 ftxui::Element render_tree(std::shared_ptr<AppState> state);
 
 bool handle_event(ftxui::Event e, ftxui::ScreenInteractive& screen, std::shared_ptr<AppState> state);
@@ -56,14 +171,27 @@ ftxui::Element render_input_popup(std::shared_ptr<AppState> state);
 
 ftxui::Element render_edit_popup(std::shared_ptr<AppState> state);
 
+ftxui::Element render_viewer(std::shared_ptr<AppState> state);
+
 bool create_directory_at_selection(std::shared_ptr<AppState> state);
 
-void perform_search(std::shared_ptr<AppState> state);
+// Starts the query on a worker thread after debounce has passed without another keystroke
+void perform_search(std::shared_ptr<AppState> state, std::chrono::milliseconds debounce = std::chrono::milliseconds(0));
+
+// Reacts to an edit of the query: narrows the current results when it can, otherwise starts a debounced search
+void update_search(std::shared_ptr<AppState> state);
+
+void cancel_search(std::shared_ptr<AppState> state);
 
 ftxui::Element render_search_panel(std::shared_ptr<AppState> state);
 
 ftxui::Element render_status_bar(std::shared_ptr<AppState> state);
 
+ftxui::Element render_perf_overlay(std::shared_ptr<AppState> state);
+
+// AppState with its input components set up and the root expanded
+std::shared_ptr<AppState> make_app_state(FileSystem& fs);
+
 void run_tui(FileSystem& fs);
 
 #endif
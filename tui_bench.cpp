@@ -0,0 +1,394 @@
+// Headless TUI benchmark: builds a synthetic filesystem, replays scripted key sequences through
+// handle_event/render_tree into an off-screen ftxui::Screen and reports frame times and allocations.
+#include "disk.hpp"
+#include "filesystem.hpp"
+#include "tui.hpp"
+
+#include <ftxui/component/screen_interactive.hpp>
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every allocation in the process goes through here, including the aligned ones BlockPool makes; the
+// array and nothrow forms fall through to these by default. Only the thread running a frame counts,
+// so the loader, search and usage workers running in the background are not charged to it.
+static std::atomic<uint64_t> g_allocations{0};
+static thread_local bool t_count_allocations = false;
+
+static void count_allocation() {
+    if (t_count_allocations)
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    count_allocation();
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    count_allocation();
+    // aligned_alloc wants a multiple of the alignment
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+    if (void* p = std::aligned_alloc(align, rounded))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// Directory blocks hold this many entries, which bounds fanout + files per directory
+constexpr int ENTRIES_PER_DIRECTORY = 8;
+// One index block of 512-byte block numbers
+constexpr int MAX_FILE_BYTES = 512 / 4 * 512;
+constexpr auto SEARCH_SETTLE_TIMEOUT = std::chrono::seconds(10);
+
+struct BenchOptions {
+    int depth{3};
+    int fanout{4};
+    int files{4};
+    int file_bytes{4096};
+    int width{120};
+    int height{40};
+    std::string query{"file_1"};
+    std::string image{"tui_bench.img"};
+};
+
+struct FrameStats {
+    std::string name;
+    std::vector<double> micros{};
+    std::vector<uint64_t> allocations{};
+};
+
+// Stand-in for the ScreenInteractive task queue: workers post here, the driver drains it between frames
+struct UiQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+
+    void post(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+
+    void drain() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+struct Driver {
+    std::shared_ptr<AppState> state;
+    ftxui::ScreenInteractive& interactive;
+    ftxui::Screen& screen;
+    UiQueue& queue;
+
+    // One frame: the event, any results posted back meanwhile, then a full render
+    void frame(const ftxui::Event& e, FrameStats& stats) {
+        t_count_allocations = true;
+        const uint64_t allocations_before = g_allocations.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+
+        handle_event(e, interactive, state);
+        queue.drain();
+        ftxui::Element document = render_tree(state);
+        ftxui::Render(screen, document);
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        stats.micros.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        const uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - allocations_before;
+        t_count_allocations = false;
+        stats.allocations.push_back(allocations);
+    }
+
+    // Waits (untimed) for a running search to deliver its last batch, returns how long that took
+    double settle_search() {
+        const auto start = std::chrono::steady_clock::now();
+        while (true) {
+            queue.drain();
+            if (!state->search_running)
+                break;
+            if (std::chrono::steady_clock::now() - start > SEARCH_SETTLE_TIMEOUT) {
+                std::cerr << "tui_bench: search did not finish\n";
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool selected_is(bool directory, bool expanded) {
+        refresh_visible_tree(state);
+        const VisibleRow& row = state->visible[state->selected_index];
+        const FileNode& node = state->tree.node(row.node);
+        return !row.placeholder && node.is_directory == directory && node.is_expanded == expanded;
+    }
+
+    bool at_last_row() {
+        refresh_visible_tree(state);
+        return state->selected_index + 1 >= static_cast<int>(state->visible.size());
+    }
+};
+
+void print_usage() {
+    std::cerr << "usage: TermExplorerTuiBench [--depth N] [--fanout N] [--files N] [--file-bytes N]\n"
+              << "                            [--width N] [--height N] [--query TEXT] [--image PATH]\n";
+}
+
+bool parse_options(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "tui_bench: missing value for " << arg << "\n";
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        if (arg == "--query") {
+            options.query = value;
+        } else if (arg == "--image") {
+            options.image = value;
+        } else {
+            int* target = nullptr;
+            if (arg == "--depth") target = &options.depth;
+            else if (arg == "--fanout") target = &options.fanout;
+            else if (arg == "--files") target = &options.files;
+            else if (arg == "--file-bytes") target = &options.file_bytes;
+            else if (arg == "--width") target = &options.width;
+            else if (arg == "--height") target = &options.height;
+
+            if (!target) {
+                std::cerr << "tui_bench: unknown option " << arg << "\n";
+                return false;
+            }
+            *target = std::atoi(value.c_str());
+        }
+    }
+
+    if (options.fanout + options.files > ENTRIES_PER_DIRECTORY) {
+        std::cerr << "tui_bench: fanout + files must not exceed " << ENTRIES_PER_DIRECTORY << " (one directory block)\n";
+        return false;
+    }
+    if (options.depth < 0 || options.fanout < 0 || options.files < 0 || options.file_bytes < 0 || options.file_bytes > MAX_FILE_BYTES ||
+        options.width < 20 || options.height < 10 || options.query.empty()) {
+        std::cerr << "tui_bench: invalid option value\n";
+        return false;
+    }
+    return true;
+}
+
+void count_tree(const BenchOptions& options, int& directories, int& files) {
+    directories = 0;
+    int level = 1;
+    for (int d = 0; d <= options.depth; ++d) {
+        directories += level;
+        level *= options.fanout;
+    }
+    files = directories * options.files;
+}
+
+std::string file_content(const std::string& path, int bytes) {
+    std::string content;
+    for (int line = 1; static_cast<int>(content.size()) < bytes; ++line) {
+        content += "line " + std::to_string(line) + " of " + path + "\n";
+    }
+    content.resize(bytes);
+    return content;
+}
+
+bool populate(FileSystem& fs, const BenchOptions& options, const std::string& dir, int depth) {
+    for (int f = 0; f < options.files; ++f) {
+        const std::string path = (dir == "/" ? "" : dir) + "/file_" + std::to_string(f) + ".txt";
+        if (!fs.create_file(path))
+            return false;
+        if (options.file_bytes > 0) {
+            int fd = fs.open_file(path);
+            if (fd < 0 || !fs.write_file(fd, file_content(path, options.file_bytes)))
+                return false;
+            fs.close_file(fd);
+        }
+    }
+
+    if (depth == options.depth)
+        return true;
+
+    for (int d = 0; d < options.fanout; ++d) {
+        const std::string path = (dir == "/" ? "" : dir) + "/dir_" + std::to_string(d);
+        if (!fs.create_directory(path) || !populate(fs, options, path, depth + 1))
+            return false;
+    }
+    return true;
+}
+
+void report(const FrameStats& stats) {
+    if (stats.micros.empty()) {
+        std::cout << std::left << std::setw(16) << stats.name << "no frames\n";
+        return;
+    }
+
+    std::vector<double> micros = stats.micros;
+    std::vector<uint64_t> allocations = stats.allocations;
+    std::sort(micros.begin(), micros.end());
+    std::sort(allocations.begin(), allocations.end());
+    auto at = [](const auto& sorted, int percentile) { return sorted[std::min(sorted.size() - 1, sorted.size() * percentile / 100)]; };
+
+    std::cout << std::left << std::setw(16) << stats.name << std::right
+              << std::setw(8) << micros.size()
+              << std::fixed << std::setprecision(1)
+              << std::setw(12) << at(micros, 50)
+              << std::setw(12) << at(micros, 99)
+              << std::setw(12) << micros.back()
+              << std::setw(14) << at(allocations, 50)
+              << std::setw(14) << at(allocations, 99) << "\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage();
+        return 1;
+    }
+
+    int directories = 0;
+    int files = 0;
+    count_tree(options, directories, files);
+    const int inodes = directories + files + 1;
+
+    // Metadata estimate (inode table, bitmap, name index) plus one block per directory and per index block, plus data
+    const int data_blocks = (options.file_bytes + 511) / 512;
+    const int blocks = 64 + inodes / 4 + directories + files * (1 + data_blocks);
+
+    std::remove(options.image.c_str());
+    Disk disk(blocks, 512);
+    if (!disk.open(options.image)) {
+        std::cerr << "tui_bench: failed to open " << options.image << "\n";
+        return 1;
+    }
+
+    FileSystem fs(disk, inodes);
+    if (!fs.initialize() || !fs.mount() || !populate(fs, options, "/", 0)) {
+        std::cerr << "tui_bench: failed to build the synthetic tree\n";
+        return 1;
+    }
+    std::cout << "tree: " << directories << " directories, " << files << " files of " << options.file_bytes
+              << " bytes, screen " << options.width << "x" << options.height << "\n";
+
+    UiQueue queue;
+    auto state = make_app_state(fs);
+    state->screen_rows = options.height;
+    state->post_to_ui = [&queue](std::function<void()> task) { queue.post(std::move(task)); };
+
+    auto interactive = ftxui::ScreenInteractive::FixedSize(options.width, options.height);
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(options.width), ftxui::Dimension::Fixed(options.height));
+    Driver driver{state, interactive, screen, queue};
+
+    // Expand every directory, top to bottom
+    FrameStats expand{"expand all"};
+    while (true) {
+        if (driver.selected_is(true, false))
+            driver.frame(ftxui::Event::Return, expand);
+        if (driver.at_last_row())
+            break;
+        driver.frame(ftxui::Event::ArrowDown, expand);
+    }
+
+    // Page through the fully expanded tree and back, then line by line
+    FrameStats scroll{"scroll"};
+    driver.frame(ftxui::Event::Home, scroll);
+    while (!driver.at_last_row())
+        driver.frame(ftxui::Event::PageDown, scroll);
+    while (state->selected_index > 0)
+        driver.frame(ftxui::Event::PageUp, scroll);
+    for (int i = 0; i < options.height * 2; ++i)
+        driver.frame(ftxui::Event::ArrowDown, scroll);
+
+    // Type the query one character at a time, letting each search finish before the next key
+    FrameStats search{"search"};
+    std::vector<double> settle_ms;
+    driver.frame(ftxui::Event::Character('/'), search);
+    for (char c : options.query) {
+        driver.frame(ftxui::Event::Character(c), search);
+        settle_ms.push_back(driver.settle_search());
+        driver.frame(ftxui::Event::Custom, search);
+    }
+    driver.frame(ftxui::Event::Tab, search); // fuzzy
+    settle_ms.push_back(driver.settle_search());
+    driver.frame(ftxui::Event::Custom, search);
+    driver.frame(ftxui::Event::Escape, search);
+
+    // Open the first file in the viewer, page through it, then edit a few characters and save
+    FrameStats open{"open file"};
+    driver.frame(ftxui::Event::Home, open);
+    while (!driver.selected_is(false, false) && !driver.at_last_row())
+        driver.frame(ftxui::Event::ArrowDown, open);
+    driver.frame(ftxui::Event::Return, open);
+    for (int i = 0; i < 10; ++i)
+        driver.frame(ftxui::Event::PageDown, open);
+    driver.frame(ftxui::Event::Character('G'), open);
+    driver.frame(ftxui::Event::Character('g'), open);
+    driver.frame(ftxui::Event::Character('e'), open);
+    for (char c : std::string("benchmark edit"))
+        driver.frame(ftxui::Event::Character(c), open);
+    driver.frame(ftxui::Event::Escape, open);
+
+    std::cout << std::left << std::setw(16) << "scenario" << std::right << std::setw(8) << "frames"
+              << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us"
+              << std::setw(14) << "allocs p50" << std::setw(14) << "allocs p99" << "\n";
+    report(expand);
+    report(scroll);
+    report(search);
+    report(open);
+
+    if (!settle_ms.empty()) {
+        std::sort(settle_ms.begin(), settle_ms.end());
+        std::cout << "search settle (incl. debounce): median " << std::fixed << std::setprecision(1)
+                  << settle_ms[settle_ms.size() / 2] << " ms, max " << settle_ms.back() << " ms\n";
+    }
+
+    cancel_search(state);
+    disk.close();
+    std::remove(options.image.c_str());
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include "usage_index.hpp"
+
+void UsageIndex::reset(int max_inodes) {
+    m_totals.assign(max_inodes, DirectoryUsage{});
+    m_ready = false;
+    m_generation++;
+}
+
+void UsageIndex::add(int inode_index, const NameIndex& names, int64_t bytes, int files) {
+    // The root has no name record, so the walk ends after adding to it; the step limit guards
+    // against cycles in a corrupt image
+    int current = inode_index;
+    int steps = 0;
+    while (current >= 0 && current < static_cast<int>(m_totals.size()) && steps <= static_cast<int>(m_totals.size())) {
+        m_totals[current].bytes += bytes;
+        m_totals[current].files += files;
+        if (!names.contains(current))
+            break;
+        current = names.record(current).parent_inode;
+        ++steps;
+    }
+    m_generation++;
+}
+
+DirectoryUsage UsageIndex::usage(int inode_index) const {
+    if (inode_index < 0 || inode_index >= static_cast<int>(m_totals.size())) {
+        return {};
+    }
+    return m_totals[inode_index];
+}
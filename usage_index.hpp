@@ -0,0 +1,40 @@
+#ifndef USAGE_INDEX_H
+#define USAGE_INDEX_H
+
+#include "name_index.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Bytes and regular files under an inode: for a directory everything below it, for a file itself
+struct DirectoryUsage {
+    int64_t bytes{};
+    int files{};
+};
+
+// In-memory du totals per inode. A change to one file is applied to its directory and every
+// ancestor along the name index parent links, so totals stay current without rescanning.
+// Until the first full build has run nothing is known and changes are not tracked.
+class UsageIndex {
+public:
+    void reset(int max_inodes);
+
+    // Adds to inode_index and every directory above it
+    void add(int inode_index, const NameIndex& names, int64_t bytes, int files);
+
+    // Called once the full build has added every file
+    void mark_ready() { m_ready = true; };
+    bool ready() const { return m_ready; };
+
+    DirectoryUsage usage(int inode_index) const;
+
+    // Bumped on every change, lets callers tell whether something ordered by size is stale
+    uint64_t generation() const { return m_generation; };
+
+private:
+    std::vector<DirectoryUsage> m_totals{};
+    bool m_ready{false};
+    uint64_t m_generation{0};
+};
+
+#endif